@@ -0,0 +1,154 @@
+#include "corpus.hpp"
+
+#include "../src/cache.hpp"
+#include "../src/tokeniser.hpp"
+#include "../src/uef.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+/*
+	Counts heap allocations made while tokenising each line, by replacing the global allocator,
+	and checks that there are none once tokenisation is underway. Reports results as JSON.
+
+	Usage: allocations [--seed n] [--size bytes]
+
+	Allocations are counted between consecutive lines arriving at a Sink; those before the first
+	line, which include setup, aren't counted. Tokenisation is checked both directly and through
+	a warm ConversionCache. Allocations made by conversion all the way to a UEF file are also
+	reported, though not checked, as output buffers grow as needed.
+*/
+
+namespace {
+
+std::atomic<size_t> allocations = 0;
+
+}
+
+void *operator new(const size_t size) {
+	++allocations;
+	if(void *const result = malloc(size ? size : 1)) {
+		return result;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *const pointer) noexcept {
+	free(pointer);
+}
+
+void operator delete(void *const pointer, size_t) noexcept {
+	free(pointer);
+}
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	size_t size = 1024 * 1024;
+};
+
+/// Records the allocations made between each line and the next, within each program.
+struct CountingSink: public Tokeniser::Sink {
+	void append(const uint8_t *const begin, const uint8_t *const end) override {
+		const size_t now = allocations;
+		if(!starting) {
+			steady_state += now - previous;
+			worst = std::max(worst, now - previous);
+		}
+		previous = now;
+
+		// The program terminator is the only two-byte output; the next line will begin a new program.
+		starting = end - begin == 2;
+		lines += !starting;
+	}
+
+	bool starting = true;
+	size_t lines = 0;
+	size_t previous = 0;
+	size_t steady_state = 0;
+	size_t worst = 0;
+};
+
+void print_count(const char *const name, const CountingSink &sink, const bool last = false) {
+	printf("\t\t\t\"%s\": {\"lines\": %zu, \"allocations\": %zu, \"worst_line\": %zu}%s\n",
+		name, sink.lines, sink.steady_state, sink.worst, last ? "" : ",");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: allocations [--seed n] [--size bytes]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")		options.seed = std::stoull(value);
+		else if(option == "--size")	options.size = std::stoull(value);
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	const auto cache_file = std::string("/tmp/bas2uef-bench-") + std::to_string(getpid()) + ".cache";
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"size\": %zu,\n", options.size);
+	printf("\t\"corpora\": [\n");
+
+	bool passed = true;
+	bool first = true;
+	for(const auto kind: Corpus::AllKinds) {
+		CountingSink direct, cached;
+		size_t uef_allocations = 0, lines = 0;
+
+		for(const auto &program: Corpus::generate(kind, options.seed, options.size)) {
+			Tokeniser::import(program, direct);
+
+			// Populate a cache, then tokenise again entirely from it.
+			{
+				ConversionCache cache(cache_file);
+				tokenise_to_uef("/dev/null", program, false, &cache);
+				cache.save();
+			}
+			{
+				ConversionCache cache(cache_file);
+				Tokeniser::import(program, cached, &cache);
+			}
+
+			const size_t start = allocations;
+			tokenise_to_uef("/dev/null", program);
+			uef_allocations += allocations - start;
+			lines += size_t(std::count(program.begin(), program.end(), '\n'));
+		}
+		passed &= !direct.steady_state && !cached.steady_state;
+
+		printf("%s\t\t{\n", first ? "" : ",\n");
+		first = false;
+		printf("\t\t\t\"kind\": \"%s\",\n", Corpus::name(kind));
+		print_count("direct", direct);
+		print_count("cached", cached);
+		printf("\t\t\t\"uef\": {\"lines\": %zu, \"allocations\": %zu, \"per_line\": %.4f}\n",
+			lines, uef_allocations, double(uef_allocations) / double(lines));
+		printf("\t\t}");
+	}
+
+	printf("\n\t],\n");
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	unlink(cache_file.c_str());
+	return passed ? 0 : -1;
+}
@@ -0,0 +1,226 @@
+#include "corpus.hpp"
+
+#include "../src/audio.hpp"
+#include "../src/tokeniser.hpp"
+#include "../src/uef.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+	Times rendering of an hour or so of tape, many files long, to WAV and CSW, and checks both
+	recordings by decoding them again: the WAV by finding zero crossings, the CSW by reading its
+	pulses, each then classified by length and decoded as start, data and stop bits. Every byte
+	of the tape's data blocks and carrier tone chunks must be recovered, and each recording must
+	be as long as the tape's load time. Reports results as JSON.
+
+	Usage: audio [--seed n] [--minutes n] [--repetitions n]
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	double minutes = 60.0;
+	int repetitions = 3;
+};
+
+constexpr uint32_t SampleRate = 44100;
+constexpr size_t CSWHeaderLength = 52;
+constexpr size_t WAVHeaderLength = 44;
+
+/// Builds a tape of programs of @c kind from @c seed lasting at least @c seconds at 1200 baud.
+std::vector<uint8_t> build_tape(const Corpus::Kind kind, const uint64_t seed, const double seconds) {
+	UEFWriter writer("");
+	UEFBlockStream stream(writer);
+
+	// Each tokenised byte takes ten bits at 1200 baud; leave the carrier tone as margin.
+	size_t bytes = 0, files = 0;
+	for(uint64_t batch = seed; double(bytes) * 10.0 / 1200.0 < seconds; ++batch) {
+		for(const auto &program: Corpus::generate(kind, batch, 64 * 1024, 200)) {
+			if(files++) {
+				stream.begin_file(CassetteFile{"FILE" + std::to_string(files)});
+			}
+			const auto tokenised = Tokeniser::import(program);
+			stream.append(tokenised.data(), tokenised.data() + tokenised.size());
+			bytes += tokenised.size();
+		}
+	}
+	stream.finish();
+	writer.close();
+	return writer.take();
+}
+
+/// @returns The bytes that the tape carries: those of each data block and the dummy byte of each $0111 chunk.
+std::vector<uint8_t> expected_bytes(const UEFReader &tape) {
+	std::vector<uint8_t> bytes;
+	for(const auto &chunk: tape.chunks()) {
+		if(chunk.id == 0x0111) bytes.push_back(0xaa);
+		if(chunk.id == 0x0100) bytes.insert(bytes.end(), chunk.contents.begin(), chunk.contents.end());
+	}
+	return bytes;
+}
+
+/// Decodes 1200-baud bytes from pulses measured in samples. Outside of a byte, short pulses are
+/// carrier and very long ones are silence; a byte begins with the two long pulses of a start bit.
+std::vector<uint8_t> decode(const std::vector<uint32_t> &pulses) {
+	constexpr double samples_per_cycle = double(SampleRate) / 1200.0;
+	const auto is_long = [&](const size_t index) {
+		return index < pulses.size() && pulses[index] > samples_per_cycle * 3.0 / 8.0 && pulses[index] < samples_per_cycle;
+	};
+
+	std::vector<uint8_t> bytes;
+	size_t index = 0;
+	while(index < pulses.size()) {
+		if(!is_long(index)) {
+			++index;
+			continue;
+		}
+
+		index += 2;
+		uint8_t value = 0;
+		for(int bit = 0; bit < 8; bit++) {
+			if(is_long(index)) {
+				index += 2;
+			} else {
+				value |= 1 << bit;
+				index += 4;
+			}
+		}
+
+		// A stop bit.
+		index += 4;
+		bytes.push_back(value);
+	}
+	return bytes;
+}
+
+std::vector<uint8_t> read_file(const std::string &file_name) {
+	std::vector<uint8_t> contents(std::filesystem::file_size(file_name));
+	FILE *const file = fopen(file_name.c_str(), "rb");
+	if(!file || fread(contents.data(), 1, contents.size(), file) != contents.size()) {
+		throw std::runtime_error("Unable to read " + file_name);
+	}
+	fclose(file);
+	return contents;
+}
+
+/// @returns The lengths of the runs of samples on each side of the midpoint.
+std::vector<uint32_t> wav_pulses(const std::vector<uint8_t> &wav) {
+	std::vector<uint32_t> pulses;
+	uint32_t length = 0;
+	bool high = false;
+	for(size_t c = WAVHeaderLength; c < wav.size(); c++) {
+		const bool sample_high = wav[c] > 0x80;
+		if(length && sample_high != high) {
+			pulses.push_back(length);
+			length = 0;
+		}
+		high = sample_high;
+		++length;
+	}
+	pulses.push_back(length);
+	return pulses;
+}
+
+std::vector<uint32_t> csw_pulses(const std::vector<uint8_t> &csw) {
+	std::vector<uint32_t> pulses;
+	for(size_t c = CSWHeaderLength; c < csw.size(); ++c) {
+		if(csw[c]) {
+			pulses.push_back(csw[c]);
+			continue;
+		}
+		pulses.push_back(uint32_t(csw[c + 1] | (csw[c + 2] << 8) | (csw[c + 3] << 16) | (csw[c + 4] << 24)));
+		c += 4;
+	}
+	return pulses;
+}
+
+uint64_t total(const std::vector<uint32_t> &pulses) {
+	uint64_t sum = 0;
+	for(const auto pulse: pulses) sum += pulse;
+	return sum;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: audio [--seed n] [--minutes n] [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--minutes")		options.minutes = std::stod(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	const UEFReader tape(build_tape(Corpus::Kind::Keywords, options.seed, options.minutes * 60.0));
+	const auto tape_seconds = tape.load_time().seconds_at_1200_baud;
+
+	const auto directory = std::filesystem::temp_directory_path();
+	const auto wav = (directory / ("bas2uef-audio-" + std::to_string(getpid()) + ".wav")).string();
+	const auto csw = (directory / ("bas2uef-audio-" + std::to_string(getpid()) + ".csw")).string();
+
+	// Keep the best repetition of each format.
+	using Clock = std::chrono::steady_clock;
+	double wav_seconds = 1e9, csw_seconds = 1e9;
+	Audio::Result wav_result, csw_result;
+	for(int c = 0; c < options.repetitions; c++) {
+		auto start = Clock::now();
+		wav_result = Audio::render(tape, wav, Audio::Options{Audio::Format::WAV, SampleRate});
+		wav_seconds = std::min(wav_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+
+		start = Clock::now();
+		csw_result = Audio::render(tape, csw, Audio::Options{Audio::Format::CSW, SampleRate});
+		csw_seconds = std::min(csw_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+	}
+
+	const auto expected = expected_bytes(tape);
+	const auto wav_recording = wav_pulses(read_file(wav));
+	const auto csw_recording = csw_pulses(read_file(csw));
+	std::filesystem::remove(wav);
+	std::filesystem::remove(csw);
+
+	const auto wav_matched = decode(wav_recording) == expected;
+	const auto csw_matched = decode(csw_recording) == expected;
+
+	// Allow for rounding in the load time, which is summed chunk by chunk.
+	const auto expected_samples = tape_seconds * SampleRate;
+	const bool timed =
+		std::abs(double(wav_result.samples) - expected_samples) <= 1.0 &&
+		total(wav_recording) == wav_result.samples &&
+		total(csw_recording) == csw_result.samples;
+	const bool passed = wav_matched && csw_matched && timed;
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"tape_seconds\": %.3f,\n", tape_seconds);
+	printf("\t\"tape_bytes\": %zu,\n", expected.size());
+	printf("\t\"wav_bytes\": %llu,\n", (unsigned long long)wav_result.bytes);
+	printf("\t\"csw_bytes\": %llu,\n", (unsigned long long)csw_result.bytes);
+	printf("\t\"wav_seconds\": %.6f,\n", wav_seconds);
+	printf("\t\"csw_seconds\": %.6f,\n", csw_seconds);
+	printf("\t\"wav_seconds_per_hour_of_tape\": %.6f,\n", wav_seconds * 3600.0 / tape_seconds);
+	printf("\t\"csw_seconds_per_hour_of_tape\": %.6f,\n", csw_seconds * 3600.0 / tape_seconds);
+	printf("\t\"wav_decoded\": %s,\n", wav_matched ? "true" : "false");
+	printf("\t\"csw_decoded\": %s,\n", csw_matched ? "true" : "false");
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	return passed ? 0 : -1;
+}
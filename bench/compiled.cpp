@@ -0,0 +1,102 @@
+#include "../src/compiled.hpp"
+#include "../src/tokeniser.hpp"
+#include "../src/uef.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Checks that programs tokenised and packaged at compile time match those produced at runtime,
+	and times the runtime work that compiling them in avoids. Reports results as JSON.
+
+	Usage: compiled [--repetitions n]
+
+	The programs are of the sort that an emulator test harness might embed: mostly short, and using
+	line-number references, strings, star commands, assembly and conditional keywords; one spans
+	several blocks.
+*/
+
+namespace {
+
+struct Options {
+	int repetitions = 1000;
+};
+
+struct Compiled {
+	std::string_view source;
+	std::vector<uint8_t> program, image;
+};
+
+template <Tokeniser::Literal source>
+Compiled compiled() {
+	static constexpr auto program = Tokeniser::compile<source>();
+	static constexpr auto image = compile_uef<source>();
+	return Compiled{
+		source.view(),
+		std::vector<uint8_t>(program.begin(), program.end()),
+		std::vector<uint8_t>(image.begin(), image.end()),
+	};
+}
+
+const Compiled programs[] = {
+	compiled<"10 PRINT \"HELLO\"\n20 GOTO 10\n">(),
+	compiled<"10 MODE 7\n20 FOR I%=1 TO 10:PRINT TAB(I%);\"*\":NEXT\n30 *FX 200,3\n40 END\n">(),
+	compiled<"10 ON ERROR GOTO 100\n20 X=PI*2:T=TIME\n30 IF X>1 THEN 50 ELSE 60\n50 PRINT X\n60 END\n100 REPORT\n">(),
+	compiled<"10 DIM code% 100\n20 P%=code%\n30 [OPT 2\n40 LDA #65:JSR &FFEE:RTS\n50 ]\n60 CALL code%\n">(),
+	compiled<"10 A$=\"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"\n20 B$=\"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"\n30 C$=\"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"\n40 PRINT A$;B$;C$\n">(),
+	compiled<"10 PROCgreet(\"world\")\n20 END\n30 DEF PROCgreet(who$)\n40 PRINT \"Hello, \";who$\n50 ENDPROC\n">(),
+};
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: compiled [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	size_t matched = 0, bytes = 0;
+	for(const auto &program: programs) {
+		matched +=
+			Tokeniser::import(program.source) == program.program &&
+			tokenise_to_uef(program.source) == program.image;
+		bytes += program.image.size();
+	}
+
+	// Time building every image at runtime, as a harness would at startup.
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+	size_t checksum = 0;
+	for(int c = 0; c < options.repetitions; c++) {
+		for(const auto &program: programs) {
+			checksum += tokenise_to_uef(program.source).size();
+		}
+	}
+	const auto seconds = std::chrono::duration<double>(Clock::now() - start).count() / options.repetitions;
+	const bool passed = matched == std::size(programs) && checksum == bytes * size_t(options.repetitions);
+
+	printf("{\n");
+	printf("\t\"programs\": %zu,\n", std::size(programs));
+	printf("\t\"image_bytes\": %zu,\n", bytes);
+	printf("\t\"runtime_seconds\": %.9f,\n", seconds);
+	printf("\t\"matched\": %zu,\n", matched);
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	return passed ? 0 : -1;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Generates reproducible synthetic BBC BASIC programs for benchmarking.
+
+	All randomness comes from a seeded splitmix64 so that a given seed produces the same
+	corpus on every platform and standard library.
+*/
+
+namespace Corpus {
+
+class Random {
+public:
+	explicit Random(const uint64_t seed) : state_(seed) {}
+
+	uint64_t next() {
+		uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
+
+	/// @returns A value in [0, @c limit).
+	int below(const int limit) {
+		return int(next() % uint64_t(limit));
+	}
+
+	/// @returns A value in [@c low, @c high].
+	int between(const int low, const int high) {
+		return low + below(high - low + 1);
+	}
+
+	template <typename ArrayT>
+	const auto &pick(const ArrayT &array) {
+		return array[size_t(below(int(std::size(array))))];
+	}
+
+private:
+	uint64_t state_;
+};
+
+enum class Kind {
+	/// Statements built mostly from keywords and short expressions.
+	Keywords,
+	/// PRINTs and assignments of long string literals.
+	Strings,
+	/// REM and DATA lines.
+	Remarks,
+	/// Lines that tokenise to just under the 255-byte limit.
+	LongLines,
+	/// GOTO, GOSUB, THEN, ELSE and RESTORE targets, all of which become line-number tokens.
+	LineNumbers,
+};
+
+constexpr Kind AllKinds[] = {Kind::Keywords, Kind::Strings, Kind::Remarks, Kind::LongLines, Kind::LineNumbers};
+
+constexpr const char *name(const Kind kind) {
+	switch(kind) {
+		case Kind::Keywords:	return "keywords";
+		case Kind::Strings:		return "strings";
+		case Kind::Remarks:		return "remarks";
+		case Kind::LongLines:	return "long-lines";
+		case Kind::LineNumbers:	return "line-numbers";
+	}
+	return "";
+}
+
+namespace Private {
+
+constexpr const char *variables[] = {"A", "B%", "X", "Y", "count%", "score", "name$", "K%", "dx", "dy"};
+constexpr const char *functions[] = {"SIN", "COS", "ABS", "INT", "SQR", "RND", "LEN", "ASC", "SGN", "EXP"};
+constexpr const char *operators[] = {"+", "-", "*", "/", " AND ", " OR ", " DIV ", " MOD "};
+constexpr const char *words[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "HELLO", "WORLD", "Score:", "Press SPACE"};
+
+inline std::string expression(Random &random) {
+	std::string result = random.pick(variables);
+	for(int c = random.below(3); c >= 0; c--) {
+		result += random.pick(operators);
+		if(random.below(2)) {
+			result += std::string(random.pick(functions)) + "(" + random.pick(variables) + ")";
+		} else {
+			result += std::to_string(random.below(1000));
+		}
+	}
+	return result;
+}
+
+inline std::string text(Random &random, const size_t length) {
+	std::string result;
+	while(result.size() < length) {
+		result += random.pick(words);
+		result += ' ';
+	}
+	result.resize(length);
+	return result;
+}
+
+inline std::string keywords(Random &random) {
+	std::string line;
+	for(int c = random.between(1, 4); c > 0; c--) {
+		if(!line.empty()) line += ':';
+		switch(random.below(8)) {
+			case 0:	line += "PRINT TAB(" + expression(random) + "," + expression(random) + ");" + expression(random);	break;
+			case 1:	line += "IF " + expression(random) + ">" + expression(random) + " THEN PROCmove ELSE ENDPROC";	break;
+			case 2:	line += "FOR I%=1 TO " + expression(random) + " STEP 2:NEXT";	break;
+			case 3:	line += "REPEAT:K%=INKEY(0):UNTIL K%=32 OR TIME>" + std::to_string(random.below(500));	break;
+			case 4:	line += "GCOL 0," + std::to_string(random.below(8)) + ":MOVE " + expression(random) + ",0:DRAW 1279,1023";	break;
+			case 5:	line += "SOUND 1,-15," + std::to_string(random.below(255)) + ",5:ENVELOPE 1,1,0,0,0,0,0,0,126,-1,0,-1,126,0";	break;
+			case 6:	line += "LOCAL " + std::string(random.pick(variables)) + ":" + random.pick(variables) + "=" + expression(random);	break;
+			case 7:	line += "VDU 23,1,0;0;0;0;:MODE " + std::to_string(random.below(8));	break;
+		}
+	}
+	return line;
+}
+
+inline std::string strings(Random &random) {
+	const auto literal = [&] { return "\"" + text(random, size_t(random.between(10, 70))) + "\""; };
+	if(random.below(2)) {
+		return "PRINT " + literal() + ";" + random.pick(variables) + ";" + literal();
+	}
+	return "name$=" + literal() + "+" + literal();
+}
+
+inline std::string remarks(Random &random) {
+	if(random.below(2)) {
+		return "REM " + text(random, size_t(random.between(20, 120)));
+	}
+	std::string line = "DATA ";
+	for(int c = random.between(5, 30); c > 0; c--) {
+		line += std::to_string(random.below(256)) + ",";
+	}
+	return line + text(random, 8);
+}
+
+inline std::string long_line(Random &random) {
+	// Every character here tokenises to a single byte; a line's four bytes of overhead
+	// then bring the total to just under the limit.
+	std::string line = std::string(random.pick(variables)) + "=0";
+	while(line.size() < 240) {
+		line += std::string(":") + random.pick(variables) + "=" + random.pick(variables) + "+1";
+	}
+	line.resize(240);
+	while(line.back() == ':' || line.back() == '=' || line.back() == '+') line.pop_back();
+	return line;
+}
+
+inline std::string line_numbers(Random &random, const int last_line) {
+	const auto target = [&] { return std::to_string(10 * random.between(1, last_line / 10)); };
+	switch(random.below(5)) {
+		default:
+		case 0:	return "GOTO " + target();
+		case 1:	return "GOSUB " + target() + ":GOSUB " + target();
+		case 2:	return "IF " + expression(random) + " THEN " + target() + " ELSE " + target();
+		case 3:	return "ON X GOTO " + target() + "," + target() + "," + target();
+		case 4:	return "RESTORE " + target();
+	}
+}
+
+}
+
+/// Generates programs of type @c kind from @c seed until their total size is at least @c size bytes.
+/// Each program has at most @c lines_per_program lines, numbered in steps of ten.
+inline std::vector<std::string> generate(const Kind kind, const uint64_t seed, const size_t size, const int lines_per_program = 2000) {
+	Random random(seed ^ (uint64_t(kind) << 32));
+	std::vector<std::string> programs;
+
+	size_t total = 0;
+	while(total < size) {
+		std::string program;
+		const int last_line = lines_per_program * 10;
+		for(int line = 10; line <= last_line && total + program.size() < size; line += 10) {
+			program += std::to_string(line) + " ";
+			switch(kind) {
+				case Kind::Keywords:	program += Private::keywords(random);					break;
+				case Kind::Strings:		program += Private::strings(random);					break;
+				case Kind::Remarks:		program += Private::remarks(random);					break;
+				case Kind::LongLines:	program += Private::long_line(random);					break;
+				case Kind::LineNumbers:	program += Private::line_numbers(random, last_line);	break;
+			}
+			program += '\n';
+		}
+		total += program.size();
+		programs.push_back(std::move(program));
+	}
+	return programs;
+}
+
+}
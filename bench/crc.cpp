@@ -0,0 +1,128 @@
+#include "../src/CRC.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+/*
+	Validates each CRC engine against a bit-by-bit reference and the original table-driven
+	implementation, for polynomial 0x1021 and random initial values, and then reports the
+	throughput of each.
+
+	Usage: crc
+*/
+
+namespace {
+
+constexpr uint16_t Polynomial = 0x1021;
+
+/// The bit-at-a-time definition of the CRC, against which all engines are checked.
+uint16_t reference(const uint8_t *data, size_t length, uint16_t crc) {
+	while(length--) {
+		crc ^= uint16_t(*data++ << 8);
+		for(int bit = 0; bit < 8; bit++) {
+			crc = uint16_t((crc << 1) ^ ((crc & 0x8000) ? Polynomial : 0));
+		}
+	}
+	return crc;
+}
+
+using EngineT = uint16_t (*)(const uint8_t *, size_t, uint16_t);
+struct Variant {
+	const char *name;
+	EngineT engine;
+	size_t minimum_length;
+};
+
+const std::vector<Variant> &variants() {
+	static const std::vector<Variant> result = [] {
+		std::vector<Variant> variants = {
+			{"bytewise", CRC::Engine::bytewise<Polynomial>, 0},
+			{"slicing-8", CRC::Engine::slicing<Polynomial, 8>, 0},
+			{"slicing-16", CRC::Engine::slicing<Polynomial, 16>, 0},
+		};
+#ifdef CRC_HAS_CLMUL
+		if(CRC::Engine::has_clmul()) {
+			variants.push_back({"clmul", CRC::Engine::clmul<Polynomial>, 64});
+		}
+#endif
+		variants.push_back({"crc16", [](const uint8_t *data, size_t length, uint16_t crc) {
+			return uint16_t(CRC::crc16(data, data + length, CRC::ByteSwapped16(crc)));
+		}, 0});
+		return variants;
+	} ();
+	return result;
+}
+
+bool validate(std::mt19937 &generator) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_int_distribution<int> initial(0, 65535);
+
+	for(size_t length = 0; length < 1200; length++) {
+		std::vector<uint8_t> data(length);
+		for(auto &value: data) value = uint8_t(byte(generator));
+		const auto crc = uint16_t(initial(generator));
+		const auto expected = reference(data.data(), data.size(), crc);
+
+		// A non-contiguous container takes crc16 down its original table-driven path.
+		const std::deque<uint8_t> original(data.begin(), data.end());
+		const auto original_crc = uint16_t(CRC::crc16(original.begin(), original.end(), CRC::ByteSwapped16(crc)));
+		if(original_crc != expected) {
+			printf("original: CRC of %zu bytes from %04x was %04x; expected %04x\n", length, crc, original_crc, expected);
+			return false;
+		}
+
+		for(const auto &variant: variants()) {
+			if(length < variant.minimum_length) continue;
+			const auto actual = variant.engine(data.data(), data.size(), crc);
+			if(actual != expected) {
+				printf("%s: CRC of %zu bytes from %04x was %04x; expected %04x\n", variant.name, length, crc, actual, expected);
+				return false;
+			}
+		}
+
+		// Check that combining the CRCs of every split matches.
+		for(size_t split = 0; split <= length; split += 37) {
+			const auto first = CRC::crc16(data.begin(), data.begin() + ptrdiff_t(split), CRC::ByteSwapped16(crc));
+			const auto second = CRC::crc16(data.begin() + ptrdiff_t(split), data.end());
+			const auto combined = CRC::crc16_combine(first, second, length - split);
+			if(uint16_t(combined) != expected) {
+				printf("crc16_combine: CRC of %zu bytes split at %zu was %04x; expected %04x\n", length, split, uint16_t(combined), expected);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+}
+
+int main() {
+	std::mt19937 generator(1);
+	if(!validate(generator)) {
+		return -1;
+	}
+	printf("All engines match the reference implementation\n");
+
+	for(const size_t length: {size_t(256), size_t(64 * 1024 * 1024)}) {
+		std::vector<uint8_t> data(length);
+		for(auto &value: data) value = uint8_t(generator());
+		const size_t repetitions = std::max(size_t(1), size_t(256 * 1024 * 1024) / length);
+
+		printf("%zu-byte buffers:\n", length);
+		for(const auto &variant: variants()) {
+			uint16_t crc = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for(size_t c = 0; c < repetitions; c++) {
+				crc = variant.engine(data.data(), data.size(), crc);
+			}
+			const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("    %-10s %7.3f GB/s (%04x)\n", variant.name, double(length * repetitions) / (seconds * 1e9), crc);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+#include "corpus.hpp"
+
+#include "../src/tokeniser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+	Times tokenisation of each corpus kind by each dialect's specialisation of the importer, relative
+	to BASIC II, so that the extra keywords of BASIC IV and V can be seen not to cost the common
+	path anything. Also checks that every dialect round-trips the corpus through detokenisation,
+	and that a selection of BASIC IV and V lines tokenise to the bytes that those versions of BASIC
+	would produce. Reports results as JSON.
+
+	Usage: dialects [--seed n] [--size bytes] [--repetitions n]
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	size_t size = 4 * 1024 * 1024;
+	int repetitions = 5;
+};
+
+constexpr Tokeniser::Dialect Dialects[] = {
+	Tokeniser::Dialect::BASIC2,
+	Tokeniser::Dialect::BASIC4,
+	Tokeniser::Dialect::BASIC5,
+};
+
+constexpr const char *name(const Tokeniser::Dialect dialect) {
+	switch(dialect) {
+		default:
+		case Tokeniser::Dialect::BASIC2:	return "basic2";
+		case Tokeniser::Dialect::BASIC4:	return "basic4";
+		case Tokeniser::Dialect::BASIC5:	return "basic5";
+	}
+}
+
+struct Expectation {
+	Tokeniser::Dialect dialect;
+	const char *line;
+
+	/// The tokenised line, without its header or the space that follows the line number.
+	std::vector<uint8_t> body;
+};
+
+const Expectation expectations[] = {
+	{Tokeniser::Dialect::BASIC2, "10 ELSE", {0x8b}},
+	{Tokeniser::Dialect::BASIC2, "10 EDIT", {'E', 'D', 'I', 'T'}},
+	{Tokeniser::Dialect::BASIC4, "10 EDIT", {0xce}},
+	{Tokeniser::Dialect::BASIC4, "10 WHILE", {'W', 'H', 'I', 'L', 'E'}},
+	{Tokeniser::Dialect::BASIC5, "10 CASE X OF", {0xc8, 0x8e, ' ', 'X', ' ', 0xca}},
+	{Tokeniser::Dialect::BASIC5, "10 WHEN 1:PRINT", {0xc9, ' ', '1', ':', 0xf1}},
+	{Tokeniser::Dialect::BASIC5, "10 OTHERWISE", {0x7f}},
+	{Tokeniser::Dialect::BASIC5, "10 ENDCASE", {0xcb}},
+	{Tokeniser::Dialect::BASIC5, "10 ELSE", {0xcc}},
+	{Tokeniser::Dialect::BASIC5, "10 IF X THEN 20 ELSE 30", {0xe7, ' ', 'X', ' ', 0x8c, ' ', 0x8d, 0x54, 0x54, 0x40, ' ', 0x8b, ' ', 0x8d, 0x54, 0x5e, 0x40}},
+	{Tokeniser::Dialect::BASIC5, "10 WHILE X:ENDWHILE", {0xc8, 0x95, ' ', 'X', ':', 0xce}},
+	{Tokeniser::Dialect::BASIC5, "10 X=SUM(A())", {'X', '=', 0xc6, 0x8e, '(', 'A', '(', ')', ')'}},
+	{Tokeniser::Dialect::BASIC5, "10 SYS 0", {0xc8, 0x99, ' ', '0'}},
+	{Tokeniser::Dialect::BASIC5, "10 ENDIF", {0xcd}},
+	{Tokeniser::Dialect::BASIC5, "10 EDIT", {0xc7, 0x92}},
+};
+
+/// @returns @c true if @c expectation tokenises as expected and detokenises back to its original text.
+bool check(const Expectation &expectation) {
+	const auto program = Tokeniser::import(std::string(expectation.line) + "\n", expectation.dialect);
+	if(program.size() < 7 || program[3] != program.size() - 2 || program[4] != ' ') {
+		return false;
+	}
+
+	const std::vector<uint8_t> body(program.begin() + 5, program.end() - 2);
+	const auto text = Tokeniser::detokenise(program.data(), program.data() + program.size(), expectation.dialect);
+	return body == expectation.body && text == std::string(expectation.line) + "\n";
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: dialects [--seed n] [--size bytes] [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--size")			options.size = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	size_t expectations_met = 0;
+	for(const auto &expectation: expectations) {
+		expectations_met += check(expectation);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	bool round_trips = true;
+	double worst_ratio = 0.0;
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"kinds\": [\n");
+	for(size_t k = 0; k < std::size(Corpus::AllKinds); k++) {
+		const auto kind = Corpus::AllKinds[k];
+		const auto programs = Corpus::generate(kind, options.seed, options.size);
+		size_t bytes = 0;
+		for(const auto &program: programs) bytes += program.size();
+
+		printf("\t\t{\n");
+		printf("\t\t\t\"kind\": \"%s\",\n", Corpus::name(kind));
+		printf("\t\t\t\"bytes\": %zu,\n", bytes);
+
+		// Keep the best repetition of each dialect, alternating dialects so that none is favoured
+		// by the state of the machine.
+		double seconds[std::size(Dialects)];
+		std::fill(std::begin(seconds), std::end(seconds), 1e9);
+		for(int r = 0; r < options.repetitions; r++) {
+			for(size_t d = 0; d < std::size(Dialects); d++) {
+				const auto start = Clock::now();
+				for(const auto &program: programs) {
+					Tokeniser::import(program, Dialects[d]);
+				}
+				seconds[d] = std::min(seconds[d], std::chrono::duration<double>(Clock::now() - start).count());
+			}
+		}
+
+		for(size_t d = 0; d < std::size(Dialects); d++) {
+			bool round_trip = true;
+			for(const auto &program: programs) {
+				const auto tokenised = Tokeniser::import(program, Dialects[d]);
+				const auto text = Tokeniser::detokenise(tokenised.data(), tokenised.data() + tokenised.size(), Dialects[d]);
+				round_trip &= Tokeniser::import(text, Dialects[d]) == tokenised;
+			}
+			round_trips &= round_trip;
+
+			const double ratio = seconds[d] / seconds[0];
+			worst_ratio = std::max(worst_ratio, ratio);
+			printf("\t\t\t\"%s\": {\n", name(Dialects[d]));
+			printf("\t\t\t\t\"seconds\": %.6f,\n", seconds[d]);
+			printf("\t\t\t\t\"mb_per_second\": %.2f,\n", double(bytes) / seconds[d] / (1024.0 * 1024.0));
+			printf("\t\t\t\t\"relative_to_basic2\": %.3f,\n", ratio);
+			printf("\t\t\t\t\"round_trips\": %s\n", round_trip ? "true" : "false");
+			printf("\t\t\t}%s\n", d + 1 < std::size(Dialects) ? "," : "");
+		}
+		printf("\t\t}%s\n", k + 1 < std::size(Corpus::AllKinds) ? "," : "");
+	}
+	printf("\t],\n");
+
+	const bool passed = round_trips && expectations_met == std::size(expectations);
+	printf("\t\"expectations\": %zu,\n", std::size(expectations));
+	printf("\t\"expectations_met\": %zu,\n", expectations_met);
+	printf("\t\"worst_relative_to_basic2\": %.3f,\n", worst_ratio);
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	return passed ? 0 : -1;
+}
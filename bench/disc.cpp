@@ -0,0 +1,177 @@
+#include "corpus.hpp"
+
+#include "../src/dfs.hpp"
+#include "../src/tokeniser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+	Times building single- and double-sided DFS disc images from tokenised programs, enough of
+	them to fill the first side's catalogue, and checks each image by reading it back: every
+	catalogue entry must give the expected name, addresses and length, entries must be in order of
+	decreasing start sector without overlapping, and every file's sectors must hold exactly its
+	program. Reports results as JSON.
+
+	Usage: disc [--seed n] [--repetitions n]
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	int repetitions = 100;
+};
+
+struct Entry {
+	std::string name;
+	uint32_t load_address, execution_address, length, start;
+};
+
+/// Reads the catalogue of side @c side of @c image, which has @c sides sides.
+std::vector<Entry> catalogue(const std::vector<uint8_t> &image, const size_t sides, const size_t side) {
+	const auto sector = [&](const size_t sector) {
+		return &image[((sector / 10) * sides + side) * 2560 + (sector % 10) * 256];
+	};
+
+	std::vector<Entry> entries;
+	const auto names = sector(0), details = sector(1);
+	for(size_t c = 8; c <= details[5]; c += 8) {
+		auto &entry = entries.emplace_back();
+		entry.name = std::string(1, char(names[c + 7] & 0x7f)) + "." + std::string(reinterpret_cast<const char *>(&names[c]), 7);
+		entry.name.erase(entry.name.find_last_not_of(' ') + 1);
+
+		const auto high = details[c + 6];
+		entry.load_address = uint32_t(details[c] | (details[c + 1] << 8) | ((high & 0x0c) << 14));
+		entry.execution_address = uint32_t(details[c + 2] | (details[c + 3] << 8) | ((high & 0xc0) << 10));
+		entry.length = uint32_t(details[c + 4] | (details[c + 5] << 8) | ((high & 0x30) << 12));
+		entry.start = uint32_t(details[c + 7] | ((high & 0x03) << 8));
+	}
+	return entries;
+}
+
+/// @returns The contents of the file described by @c entry.
+std::vector<uint8_t> contents(const std::vector<uint8_t> &image, const size_t sides, const size_t side, const Entry &entry) {
+	std::vector<uint8_t> result;
+	for(size_t offset = 0; offset < entry.length; offset += 256) {
+		const auto sector = entry.start + offset / 256;
+		const auto begin = image.begin() + ptrdiff_t(((sector / 10) * sides + side) * 2560 + (sector % 10) * 256);
+		result.insert(result.end(), begin, begin + ptrdiff_t(std::min<size_t>(256, entry.length - offset)));
+	}
+	return result;
+}
+
+/// Checks that @c disc holds exactly @c programs, in order, named PROG0, PROG1, etc.
+bool check(const DFS::Disc &disc, const std::vector<std::vector<uint8_t>> &programs) {
+	size_t index = 0;
+	for(size_t side = 0; side < disc.sides(); side++) {
+		auto entries = catalogue(disc.image(), disc.sides(), side);
+
+		// Catalogues run from the highest start sector down, without overlap; read them upwards.
+		uint32_t next_free = 2;
+		std::reverse(entries.begin(), entries.end());
+		for(const auto &entry: entries) {
+			if(index == programs.size()) return false;
+			if(
+				entry.start < next_free ||
+				entry.name != "$.PROG" + std::to_string(index) ||
+				entry.load_address != 0x1900 ||
+				entry.execution_address != 0x8023 ||
+				contents(disc.image(), disc.sides(), side, entry) != programs[index]
+			) {
+				return false;
+			}
+			next_free = entry.start + (entry.length + 255) / 256;
+			++index;
+		}
+	}
+	return index == programs.size();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: disc [--seed n] [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	// Forty programs of a few kilobytes each: more than one catalogue holds, but few enough to fit on two sides.
+	std::vector<std::vector<uint8_t>> programs;
+	for(const auto &program: Corpus::generate(Corpus::Kind::Keywords, options.seed, 256 * 1024, 40)) {
+		programs.push_back(Tokeniser::import(program));
+	}
+	programs.resize(std::min<size_t>(programs.size(), 40));
+
+	size_t bytes = 0;
+	for(const auto &program: programs) bytes += program.size();
+
+	using Clock = std::chrono::steady_clock;
+	const auto build = [&](const DFS::Format format, const size_t count) {
+		DFS::Disc disc(format, 80, "BENCHMARK");
+		for(size_t c = 0; c < count; c++) {
+			disc.add(DFS::File{"PROG" + std::to_string(c)}, programs[c]);
+		}
+		return disc;
+	};
+
+	// A single side takes as many programs as its catalogue holds; two sides take them all.
+	const auto single_count = std::min(programs.size(), DFS::Disc::CatalogueSize);
+	double ssd_seconds = 1e9, dsd_seconds = 1e9;
+	for(int c = 0; c < options.repetitions; c++) {
+		auto start = Clock::now();
+		build(DFS::Format::SSD, single_count);
+		ssd_seconds = std::min(ssd_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+
+		start = Clock::now();
+		build(DFS::Format::DSD, programs.size());
+		dsd_seconds = std::min(dsd_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+	}
+
+	const auto ssd = build(DFS::Format::SSD, single_count);
+	const auto dsd = build(DFS::Format::DSD, programs.size());
+	const bool ssd_checked = check(ssd, std::vector<std::vector<uint8_t>>(programs.begin(), programs.begin() + ptrdiff_t(single_count)));
+	const bool dsd_checked = check(dsd, programs);
+
+	// A program beyond the single side's catalogue must be refused.
+	bool overflow_refused = false;
+	try {
+		auto full = build(DFS::Format::SSD, single_count);
+		full.add(DFS::File{"EXTRA"}, programs.front());
+	} catch(const std::runtime_error &) {
+		overflow_refused = true;
+	}
+
+	const bool passed = ssd_checked && dsd_checked && overflow_refused && programs.size() > DFS::Disc::CatalogueSize;
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"programs\": %zu,\n", programs.size());
+	printf("\t\"program_bytes\": %zu,\n", bytes);
+	printf("\t\"ssd_files\": %zu,\n", single_count);
+	printf("\t\"ssd_seconds\": %.9f,\n", ssd_seconds);
+	printf("\t\"dsd_files\": %zu,\n", programs.size());
+	printf("\t\"dsd_seconds\": %.9f,\n", dsd_seconds);
+	printf("\t\"dsd_second_side_free_sectors\": %zu,\n", dsd.free_sectors(1));
+	printf("\t\"ssd_checked\": %s,\n", ssd_checked ? "true" : "false");
+	printf("\t\"dsd_checked\": %s,\n", dsd_checked ? "true" : "false");
+	printf("\t\"overflow_refused\": %s,\n", overflow_refused ? "true" : "false");
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	return passed ? 0 : -1;
+}
@@ -0,0 +1,176 @@
+#include "corpus.hpp"
+
+#include "../src/CRC.hpp"
+#include "../src/counters.hpp"
+#include "../src/tokeniser.hpp"
+#include "../src/uef.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+	Times the separate phases of conversion over synthetic corpora, reporting results as JSON
+	so that runs can be compared across commits.
+
+	Usage: harness [--seed n] [--size bytes] [--repetitions n] [--output file] [--counters]
+
+	Each kind of corpus in Corpus::Kind is generated with the given seed up to the given size;
+	each phase is timed over all programs in the corpus, keeping the best of the repetitions.
+
+	With --counters, hardware events during the best repetition of each phase are reported too,
+	per byte, if the kernel allows them; otherwise the reason is reported and timing continues.
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	size_t size = 1024 * 1024;
+	int repetitions = 5;
+	std::string output = "/dev/null";
+	bool counters = false;
+};
+
+/// The counters in use, if any.
+std::optional<Counters::Group> counters;
+
+struct Measurement {
+	double seconds = 0.0;
+
+	/// Events during the fastest repetition, if counters are in use.
+	Counters::Sample events;
+};
+
+/// @returns The best time in seconds of @c repetitions calls to @c function.
+template <typename FunctionT>
+Measurement best_of(const int repetitions, const FunctionT &function) {
+	Measurement best;
+	best.seconds = 1e9;
+	for(int c = 0; c < repetitions; c++) {
+		const auto reading = counters ? counters->read() : Counters::Group::Reading();
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(seconds < best.seconds) {
+			best.seconds = seconds;
+			if(counters) best.events = counters->since(reading);
+		}
+	}
+	return best;
+}
+
+void print_phase(const char *const name, const Measurement &measurement, const size_t bytes, const bool last = false) {
+	const auto seconds = measurement.seconds;
+	printf("\t\t\t\"%s\": {\"seconds\": %.9f, \"ns_per_byte\": %.4f, \"mb_per_second\": %.3f",
+		name, seconds, seconds * 1e9 / double(bytes), double(bytes) / (seconds * 1024.0 * 1024.0));
+	for(size_t event = 0; counters && event < Counters::EventCount; event++) {
+		if(measurement.events.counted[event]) {
+			printf(", \"%s_per_byte\": %.4f", Counters::name(Counters::Event(event)), measurement.events.counts[event] / double(bytes));
+		}
+	}
+	printf("}%s\n", last ? "" : ",");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(std::string("--counters") == argv[c]) {
+			options.counters = true;
+			continue;
+		}
+
+		if(c == argc - 1) {
+			std::cerr << "usage: harness [--seed n] [--size bytes] [--repetitions n] [--output file] [--counters]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--size")			options.size = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else if(option == "--output")		options.output = value;
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	if(options.counters) {
+		counters.emplace();
+	}
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"size\": %zu,\n", options.size);
+	printf("\t\"repetitions\": %d,\n", options.repetitions);
+	if(counters) {
+		printf("\t\"counters\": %s,\n", counters->available() ? "true" : "false");
+		if(!counters->available()) {
+			printf("\t\"counters_unavailable\": \"%s\",\n", counters->unavailable_reason().c_str());
+		}
+	}
+	printf("\t\"corpora\": [\n");
+
+	bool first = true;
+	for(const auto kind: Corpus::AllKinds) {
+		const auto programs = Corpus::generate(kind, options.seed, options.size);
+
+		size_t source_bytes = 0, lines = 0;
+		for(const auto &program: programs) {
+			source_bytes += program.size();
+			lines += size_t(std::count(program.begin(), program.end(), '\n'));
+		}
+
+		std::vector<std::vector<uint8_t>> tokenised(programs.size());
+		const auto tokenise = best_of(options.repetitions, [&] {
+			for(size_t c = 0; c < programs.size(); c++) {
+				tokenised[c] = Tokeniser::import(programs[c]);
+			}
+		});
+
+		// Checksum as the tape format does: in blocks of 256 bytes.
+		size_t tokenised_bytes = 0;
+		for(const auto &program: tokenised) tokenised_bytes += program.size();
+		uint16_t checksum = 0;
+		const auto crc = best_of(options.repetitions, [&] {
+			checksum = 0;
+			for(const auto &program: tokenised) {
+				for(size_t offset = 0; offset < program.size(); offset += 256) {
+					const auto end = std::min(program.size(), offset + 256);
+					checksum ^= uint16_t(CRC::crc16(program.begin() + ptrdiff_t(offset), program.begin() + ptrdiff_t(end)));
+				}
+			}
+		});
+
+		const auto uef = best_of(options.repetitions, [&] {
+			for(const auto &program: tokenised) {
+				write_uef(options.output, program);
+			}
+		});
+
+		printf("%s\t\t{\n", first ? "" : ",\n");
+		first = false;
+		printf("\t\t\t\"kind\": \"%s\",\n", Corpus::name(kind));
+		printf("\t\t\t\"programs\": %zu,\n", programs.size());
+		printf("\t\t\t\"lines\": %zu,\n", lines);
+		printf("\t\t\t\"source_bytes\": %zu,\n", source_bytes);
+		printf("\t\t\t\"tokenised_bytes\": %zu,\n", tokenised_bytes);
+		printf("\t\t\t\"checksum\": %u,\n", checksum);
+		print_phase("tokenise", tokenise, source_bytes);
+		print_phase("crc", crc, tokenised_bytes);
+		print_phase("uef", uef, tokenised_bytes, true);
+		printf("\t\t}");
+	}
+
+	printf("\n\t]\n}\n");
+	return 0;
+}
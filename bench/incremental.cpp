@@ -0,0 +1,116 @@
+#include "corpus.hpp"
+
+#include "../src/cache.hpp"
+#include "../src/uef.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+	Compares full conversion of a program against incremental conversion through a
+	ConversionCache after a single line of the program has changed, at a range of program
+	sizes, reporting results as JSON.
+
+	Usage: incremental [--seed n] [--repetitions n]
+
+	Incremental times include loading and saving the cache.
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	int repetitions = 20;
+};
+
+/// @returns The best time in microseconds of @c repetitions calls to @c function.
+template <typename FunctionT>
+double best_of(const int repetitions, const FunctionT &function) {
+	auto best = std::chrono::steady_clock::duration::max();
+	for(int c = 0; c < repetitions; c++) {
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		best = std::min(best, std::chrono::steady_clock::now() - start);
+	}
+	return std::chrono::duration<double, std::micro>(best).count();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: incremental [--seed n] [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	const auto cache_file = std::string("/tmp/bas2uef-bench-") + std::to_string(getpid()) + ".cache";
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"repetitions\": %d,\n", options.repetitions);
+	printf("\t\"programs\": [\n");
+
+	// Line numbers are spaced by ten and can't exceed 32767, which bounds program length.
+	constexpr int sizes[] = {250, 500, 1000, 2000, 3000};
+	for(const auto lines: sizes) {
+		// No keyword line exceeds 1kb, so this size guarantees that the first program is complete.
+		const auto program = Corpus::generate(Corpus::Kind::Keywords, options.seed, size_t(lines) * 1024, lines).front();
+
+		// Edit one line in the middle of the program, without changing its length.
+		auto edited = program;
+		const auto middle = edited.find('\n', edited.size() / 2);
+		const auto line_end = edited.find('\n', middle + 1);
+		edited[line_end - 1] = edited[line_end - 1] == 'A' ? 'B' : 'A';
+
+		const auto full = best_of(options.repetitions, [&] {
+			tokenise_to_uef("/dev/null", edited);
+		});
+
+		// Prime the cache with the original program before each timed, incremental conversion of the edited one.
+		ConversionCache::Statistics statistics;
+		auto best = std::chrono::steady_clock::duration::max();
+		for(int c = 0; c < options.repetitions; c++) {
+			{
+				ConversionCache cache(cache_file);
+				tokenise_to_uef("/dev/null", program, false, &cache);
+				cache.save();
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			ConversionCache cache(cache_file);
+			tokenise_to_uef("/dev/null", edited, false, &cache);
+			cache.save();
+			best = std::min(best, std::chrono::steady_clock::now() - start);
+			statistics = cache.statistics();
+		}
+		const auto incremental = std::chrono::duration<double, std::micro>(best).count();
+
+		printf("\t\t{\"lines\": %d, \"source_bytes\": %zu, \"full_us\": %.1f, \"incremental_us\": %.1f, "
+			"\"lines_reused\": %zu}%s\n",
+			lines, program.size(), full, incremental,
+			statistics.lines_reused,
+			lines == sizes[std::size(sizes) - 1] ? "" : ",");
+	}
+
+	printf("\t]\n}\n");
+	unlink(cache_file.c_str());
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include "../src/keywords.hpp"
+#include "../src/trie.hpp"
+#include "map_trie.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+/*
+	Compares keyword lookup via the flat, compile-time Trie against the map-based
+	trie that it replaced.
+
+	Usage: keywords [corpus file]
+
+	If no corpus is supplied then a synthetic one of a few megabytes is used.
+*/
+
+namespace {
+
+using namespace Tokeniser;
+
+constexpr Trie<Keyword, trie_shape(keywords)> flat_tokens(keywords);
+const MapTrie<char, Keyword> map_tokens(keywords);
+
+std::string synthetic_corpus() {
+	const char *const lines[] = {
+		"10 MODE 7:PROCinit:HIMEM=&7C00\n",
+		"20 FOR I%=1 TO 100 STEP 2:PRINT TAB(I%,3);\"Hello, world\";:NEXT\n",
+		"30 IF X>=10 THEN GOTO 60 ELSE GOSUB 1000\n",
+		"40 REM This line has a comment that is copied verbatim\n",
+		"50 DATA 1,2,3,4,5,6,7,8,9,10,ELEPHANT,GIRAFFE\n",
+		"60 A$=LEFT$(B$,3)+MID$(C$,2,4)+RIGHT$(D$,1)+STRING$(10,\"*\")\n",
+		"70 SOUND 1,-15,53,20:ENVELOPE 1,1,0,0,0,0,0,0,126,-1,0,-1,126,0\n",
+		"80 DEF PROCinit:LOCAL X,Y:VDU 23,1,0;0;0;0;:ENDPROC\n",
+		"90 REPEAT:K%=INKEY(0):UNTIL K%=32 OR TIME>500\n",
+		"100 TIMER=TIME:PRINT INT(RND(1)*6)+1, SQR(ABS(SIN(PI/4)))\n",
+	};
+
+	std::string corpus;
+	while(corpus.size() < 4 * 1024 * 1024) {
+		for(const auto line: lines) corpus += line;
+	}
+	return corpus;
+}
+
+/// Scans @c corpus for longest keyword matches in the same manner as the tokeniser, using
+/// @c find to step between states and @c value to test for a complete keyword.
+template <typename StateT, typename FindT, typename ValueT>
+uint64_t scan(const std::string &corpus, const StateT root, const FindT &find, const ValueT &value) {
+	uint64_t checksum = 0;
+	size_t position = 0;
+	while(position < corpus.size()) {
+		auto state = root;
+		size_t depth = 0, found_depth = 0;
+		uint8_t token = 0;
+		while(position + depth < corpus.size()) {
+			if(value(state)) {
+				found_depth = depth;
+				token = value(state)->token;
+			}
+			const auto next = find(state, corpus[position + depth]);
+			if(!next) break;
+			state = next;
+			++depth;
+		}
+		checksum = checksum * 31 + token;
+		position += found_depth ? found_depth : 1;
+	}
+	return checksum;
+}
+
+template <typename FunctionT>
+uint64_t time(const char *const name, const std::string &corpus, const FunctionT &function) {
+	constexpr int repetitions = 5;
+
+	uint64_t checksum = 0;
+	auto best = std::chrono::steady_clock::duration::max();
+	for(int c = 0; c < repetitions; c++) {
+		const auto start = std::chrono::steady_clock::now();
+		checksum = function();
+		best = std::min(best, std::chrono::steady_clock::now() - start);
+	}
+
+	const auto ns = std::chrono::duration<double, std::nano>(best).count();
+	printf("%-10s %8.3f ns/char (checksum %016llx)\n", name, ns / double(corpus.size()), (unsigned long long)checksum);
+	return checksum;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	std::string corpus;
+	if(argc > 1) {
+		FILE *const file = fopen(argv[1], "rb");
+		if(!file) {
+			std::cerr << "Couldn't open " << argv[1] << std::endl;
+			return -1;
+		}
+		char buffer[65536];
+		size_t read;
+		while((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+			corpus.append(buffer, read);
+		}
+		fclose(file);
+	} else {
+		corpus = synthetic_corpus();
+	}
+	printf("corpus: %zu bytes\n", corpus.size());
+
+	const auto map = time("map trie", corpus, [&] {
+		return scan(corpus, &map_tokens,
+			[](const auto node, const char ch) { return node->find(ch); },
+			[](const auto node) { return node->value(); });
+	});
+	const auto flat = time("flat trie", corpus, [&] {
+		return scan(corpus, flat_tokens.Root,
+			[](const auto state, const char ch) { return flat_tokens.find(state, ch); },
+			[](const auto state) { return flat_tokens.value(state); });
+	});
+
+	if(map != flat) {
+		std::cerr << "Lookup results differ" << std::endl;
+		return -1;
+	}
+	return 0;
+}
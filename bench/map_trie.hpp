@@ -0,0 +1,47 @@
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+/// Implements a fairly-vanilla retrieval tree, with each node holding an @c unordered_map of its children.
+///
+/// This was the tokeniser's keyword index prior to the flat @c Trie in src/trie.hpp; it is retained
+/// here only as a point of comparison for benchmarking.
+///
+/// @c NodeKeyT the type that is used to index the tree.
+/// @c ValueT the type stored at nodes which complete a value.
+template <typename NodeKeyT, typename ValueT>
+struct MapTrie {
+	MapTrie() = default;
+	template <typename RangeT>
+	MapTrie(const RangeT &values) {
+		for(const auto &value: values) {
+			insert(value.first, value.second);
+		}
+	}
+
+	/// @returns This node's child corresponding to @c key if one exists; @c nullptr otherwise.
+	const MapTrie *find(const NodeKeyT key) const {
+		const auto it = children_.find(key);
+		if(it == children_.end()) return nullptr;
+		return &it->second;
+	}
+
+	/// @returns The value stored at this node if one exists; @c std::nullopt otherwise.
+	const std::optional<ValueT> &value() const {
+		return value_;
+	}
+
+private:
+	void insert(const NodeKeyT *key, const ValueT &value) {
+		if(*key) {
+			children_[*key].insert(key + 1, value);
+		} else {
+			value_ = value;
+		}
+	}
+
+	std::unordered_map<NodeKeyT, MapTrie> children_;
+	std::optional<ValueT> value_;
+};
@@ -0,0 +1,147 @@
+#include "corpus.hpp"
+
+#include "../src/memory.hpp"
+#include "../src/tokeniser.hpp"
+#include "../src/uef.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+	Times writing programs of the sizes that a test rig might use as raw memory images and as
+	memory-patch scripts, and checks each script by applying it to an empty 64KB memory: the program
+	must appear at PAGE, exactly matching the binary image, with TOP, LOMEM and VARTOP all just
+	beyond it. Also reports the tape load time that each image saves. Reports results as JSON.
+
+	Usage: memory [--seed n] [--repetitions n]
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	int repetitions = 20;
+};
+
+std::vector<uint8_t> read_file(const std::string &file_name) {
+	std::vector<uint8_t> contents(std::filesystem::file_size(file_name));
+	FILE *const file = fopen(file_name.c_str(), "rb");
+	if(!file || fread(contents.data(), 1, contents.size(), file) != contents.size()) {
+		throw std::runtime_error("Unable to read " + file_name);
+	}
+	fclose(file);
+	return contents;
+}
+
+/// Applies the script at @c file_name to @c memory.
+void apply(const std::string &file_name, std::array<uint8_t, 65536> &memory) {
+	std::ifstream script(file_name);
+	std::string line;
+	while(std::getline(script, line)) {
+		line = line.substr(0, line.find(';'));
+		const auto colon = line.find(':');
+		if(colon == std::string::npos) continue;
+
+		auto address = std::stoul(line.substr(0, colon), nullptr, 16);
+		std::istringstream bytes(line.substr(colon + 1));
+		std::string byte;
+		while(bytes >> byte) {
+			memory[address++ & 0xffff] = uint8_t(std::stoul(byte, nullptr, 16));
+		}
+	}
+}
+
+uint16_t word(const std::array<uint8_t, 65536> &memory, const uint16_t address) {
+	return uint16_t(memory[address] | (memory[address + 1] << 8));
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: memory [--seed n] [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	const auto directory = std::filesystem::temp_directory_path();
+	const auto binary = (directory / ("bas2uef-memory-" + std::to_string(getpid()) + ".bin")).string();
+	const auto script = (directory / ("bas2uef-memory-" + std::to_string(getpid()) + ".txt")).string();
+
+	using Clock = std::chrono::steady_clock;
+	bool passed = true;
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"programs\": [\n");
+
+	// Programs from a few lines up to around half of the space below HIMEM.
+	constexpr int line_counts[] = {10, 50, 150};
+	for(size_t p = 0; p < std::size(line_counts); p++) {
+		const auto source = Corpus::generate(Corpus::Kind::Keywords, options.seed, size_t(1) << 20, line_counts[p]).front();
+		const auto program = Tokeniser::import(source);
+		const auto pointers = MemoryImage::pointers(program);
+
+		double binary_seconds = 1e9, script_seconds = 1e9;
+		for(int c = 0; c < options.repetitions; c++) {
+			auto start = Clock::now();
+			MemoryImage::write_binary(binary, program);
+			binary_seconds = std::min(binary_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+
+			start = Clock::now();
+			MemoryImage::write_script(script, program, pointers);
+			script_seconds = std::min(script_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+		}
+
+		std::array<uint8_t, 65536> memory{};
+		apply(script, memory);
+		const auto end = MemoryImage::DefaultPage + program.size();
+		const bool matched =
+			read_file(binary) == program &&
+			std::equal(program.begin(), program.end(), memory.begin() + MemoryImage::DefaultPage) &&
+			std::all_of(memory.begin() + ptrdiff_t(end), memory.end(), [](const uint8_t byte) { return !byte; }) &&
+			memory[MemoryImage::Pointers::PageAddress] == MemoryImage::DefaultPage >> 8 &&
+			word(memory, MemoryImage::Pointers::TopAddress) == end &&
+			word(memory, MemoryImage::Pointers::LomemAddress) == end &&
+			word(memory, MemoryImage::Pointers::VartopAddress) == end;
+		passed &= matched;
+
+		const auto load_time = UEFReader(write_uef(program)).load_time();
+		printf("\t\t{\n");
+		printf("\t\t\t\"lines\": %d,\n", line_counts[p]);
+		printf("\t\t\t\"bytes\": %zu,\n", program.size());
+		printf("\t\t\t\"top\": %u,\n", pointers.top);
+		printf("\t\t\t\"binary_seconds\": %.6f,\n", binary_seconds);
+		printf("\t\t\t\"script_seconds\": %.6f,\n", script_seconds);
+		printf("\t\t\t\"tape_seconds_saved\": %.3f,\n", load_time.seconds_at_1200_baud);
+		printf("\t\t\t\"matched\": %s\n", matched ? "true" : "false");
+		printf("\t\t}%s\n", p + 1 < std::size(line_counts) ? "," : "");
+	}
+	std::filesystem::remove(binary);
+	std::filesystem::remove(script);
+
+	printf("\t],\n");
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	return passed ? 0 : -1;
+}
@@ -0,0 +1,115 @@
+#include "corpus.hpp"
+
+#include "../src/thread_pool.hpp"
+#include "../src/tokeniser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Measures the scaling of parallel tokenisation of a single large source file from one thread
+	up to the given number, by default the number of hardware threads, reporting results as JSON.
+	Also checks that output, and the line number of a deliberate error, match the serial path.
+
+	Usage: parallel [--seed n] [--size bytes] [--repetitions n] [--threads n]
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	size_t size = 8 * 1024 * 1024;
+	int repetitions = 5;
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+/// @returns The best time in seconds of @c repetitions calls to @c function.
+template <typename FunctionT>
+double best_of(const int repetitions, const FunctionT &function) {
+	auto best = std::chrono::steady_clock::duration::max();
+	for(int c = 0; c < repetitions; c++) {
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		best = std::min(best, std::chrono::steady_clock::now() - start);
+	}
+	return std::chrono::duration<double>(best).count();
+}
+
+/// @returns The line number of the error thrown by @c function, or 0 if there is none.
+template <typename FunctionT>
+int error_line(const FunctionT &function) {
+	try {
+		function();
+	} catch(const Tokeniser::Error &error) {
+		return error.line_number;
+	}
+	return 0;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: parallel [--seed n] [--size bytes] [--repetitions n] [--threads n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--size")			options.size = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else if(option == "--threads")		options.threads = std::max(1ul, std::stoul(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	// Build one large source from a mixture of all kinds of line. Line numbers restart with each
+	// constituent program, which the tokeniser doesn't mind.
+	std::string source;
+	for(const auto kind: Corpus::AllKinds) {
+		for(const auto &program: Corpus::generate(kind, options.seed, options.size / std::size(Corpus::AllKinds))) {
+			source += program;
+		}
+	}
+
+	// Plant an error about three quarters of the way through.
+	auto broken = source;
+	broken.insert(broken.find('\n', broken.size() * 3 / 4) + 1, "PRINT\n");
+
+	const auto expected = Tokeniser::import(source);
+	const auto expected_error = error_line([&] { Tokeniser::import(broken); });
+	const auto serial = best_of(options.repetitions, [&] { Tokeniser::import(source); });
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"source_bytes\": %zu,\n", source.size());
+	printf("\t\"serial_seconds\": %.6f,\n", serial);
+	printf("\t\"threads\": [\n");
+
+	bool matches = true;
+	for(size_t threads = 1; threads <= options.threads; threads *= 2) {
+		ThreadPool pool(threads);
+		matches &= Tokeniser::import(source, pool) == expected;
+		matches &= error_line([&] { Tokeniser::import(broken, pool); }) == expected_error;
+
+		const auto seconds = best_of(options.repetitions, [&] { Tokeniser::import(source, pool); });
+		printf("\t\t{\"threads\": %zu, \"seconds\": %.6f, \"mb_per_second\": %.3f, \"speedup\": %.3f}%s\n",
+			threads, seconds, double(source.size()) / (seconds * 1024.0 * 1024.0), serial / seconds,
+			threads * 2 <= options.threads ? "," : "");
+	}
+
+	printf("\t],\n");
+	printf("\t\"matches_serial\": %s\n", matches ? "true" : "false");
+	printf("}\n");
+	return matches ? 0 : -1;
+}
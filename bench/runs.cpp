@@ -0,0 +1,99 @@
+#include "../src/scan.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+
+/*
+	Compares ways of finding the end of each of the long runs that the tokeniser copies
+	verbatim: per-character calls through a std::function, as the tokeniser originally did,
+	against Scan's table-driven and SIMD scanners.
+
+	Usage: runs
+*/
+
+namespace {
+
+/// Builds a few megabytes of runs drawn from @c alphabet, each with a length in [@c min_length, @c max_length]
+/// and followed by a character from @c terminators.
+std::string corpus(const std::string &alphabet, const std::string &terminators, const int min_length, const int max_length) {
+	std::mt19937 generator(1);
+	std::uniform_int_distribution<int> length(min_length, max_length);
+	std::uniform_int_distribution<size_t> character(0, alphabet.size() - 1);
+	std::uniform_int_distribution<size_t> terminator(0, terminators.size() - 1);
+
+	std::string result;
+	while(result.size() < 4 * 1024 * 1024) {
+		for(int c = length(generator); c > 0; c--) {
+			result.push_back(alphabet[character(generator)]);
+		}
+		result.push_back(terminators[terminator(generator)]);
+	}
+	return result;
+}
+
+/// Walks @c text run by run, using @c run_end to find the end of each.
+template <typename RunEndT>
+uint64_t walk(const std::string &text, const RunEndT &run_end) {
+	uint64_t total = 0;
+	const char *begin = text.data();
+	const char *const end = begin + text.size();
+	while(begin != end) {
+		const auto stop = run_end(begin, end);
+		total += uint64_t(stop - begin);
+		begin = stop + (stop != end);
+	}
+	return total;
+}
+
+template <typename RunEndT>
+void time(const char *const name, const std::string &text, const RunEndT &run_end) {
+	constexpr int repetitions = 10;
+
+	uint64_t total = 0;
+	auto best = std::chrono::steady_clock::duration::max();
+	for(int c = 0; c < repetitions; c++) {
+		const auto start = std::chrono::steady_clock::now();
+		total = walk(text, run_end);
+		best = std::min(best, std::chrono::steady_clock::now() - start);
+	}
+
+	const auto ns = std::chrono::duration<double, std::nano>(best).count();
+	printf("    %-10s %8.3f ns/byte (%llu bytes in runs)\n", name, ns / double(text.size()), (unsigned long long)total);
+}
+
+template <Scan::Class cls>
+void compare(const char *const name, const std::string &text, const std::function<int(int)> &predicate) {
+	printf("%s: %zu bytes\n", name, text.size());
+
+	time("function", text, [&](const char *begin, const char *const end) {
+		while(begin != end && *begin != '\r' && *begin != '\n' && predicate(*begin)) ++begin;
+		return begin;
+	});
+	time("table", text, [](const char *const begin, const char *const end) {
+		return Scan::run_end_scalar<cls>(begin, end);
+	});
+	time("simd", text, [](const char *const begin, const char *const end) {
+		return Scan::run_end<cls>(begin, end);
+	});
+}
+
+}
+
+int main() {
+	const std::string printable = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 !#$%&'()*+,-./:;<=>?@";
+	const std::string alphanumeric = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+	compare<Scan::NotQuote>("String literals", corpus(printable, "\"", 1, 80),
+		[](const int ch) { return ch != '"'; });
+	compare<Scan::Any>("REM, DATA and * lines", corpus(printable + "\"", "\n", 20, 200),
+		[](int) { return true; });
+	compare<Scan::Alphanumeric>("Identifiers", corpus(alphanumeric, "=:,() ", 1, 12),
+		[](const int ch) { return isalnum(ch); });
+
+	return 0;
+}
@@ -0,0 +1,196 @@
+#include "corpus.hpp"
+
+#include "../src/server.hpp"
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern char **environ;
+
+/*
+	Compares the latency of converting a program via a resident server against that of
+	spawning a fresh process for the conversion, reporting results as JSON.
+
+	Usage: server [--binary path] [--requests n] [--clients n] [--lines n] [--seed n]
+
+	The program converted is a synthetic one of the given number of lines, as per Corpus::Kind::Keywords.
+*/
+
+namespace {
+
+struct Options {
+	std::string binary = "./bas2uef";
+	int requests = 200;
+	int clients = 4;
+	int lines = 200;
+	uint64_t seed = 1;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double microseconds(const Clock::duration duration) {
+	return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+pid_t spawn(const std::vector<std::string> &arguments) {
+	std::vector<char *> argv;
+	for(const auto &argument: arguments) {
+		argv.push_back(const_cast<char *>(argument.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	pid_t pid;
+	if(posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ)) {
+		throw std::runtime_error("Unable to launch " + arguments[0]);
+	}
+	return pid;
+}
+
+int connect_to(const std::string &socket_path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address))) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void print_latencies(const char *const name, std::vector<double> &latencies, const double seconds, const bool last = false) {
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&](const double fraction) {
+		return latencies[std::min(latencies.size() - 1, size_t(fraction * double(latencies.size())))];
+	};
+	printf("\t\"%s\": {\"requests\": %zu, \"median_us\": %.1f, \"p99_us\": %.1f, \"requests_per_second\": %.1f}%s\n",
+		name, latencies.size(), percentile(0.5), percentile(0.99), double(latencies.size()) / seconds, last ? "" : ",");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: server [--binary path] [--requests n] [--clients n] [--lines n] [--seed n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--binary")			options.binary = value;
+		else if(option == "--requests")		options.requests = std::max(1, std::stoi(value));
+		else if(option == "--clients")		options.clients = std::max(1, std::stoi(value));
+		else if(option == "--lines")		options.lines = std::max(1, std::stoi(value));
+		else if(option == "--seed")			options.seed = std::stoull(value);
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	// No keyword line exceeds 1kb, so this size guarantees that the first program is complete.
+	const auto program = Corpus::generate(Corpus::Kind::Keywords, options.seed, size_t(options.lines) * 1024, options.lines).front();
+	const auto base = std::string("/tmp/bas2uef-bench-") + std::to_string(getpid());
+	const auto source_path = base + ".bas";
+	const auto output_path = base + ".uef";
+	const auto socket_path = base + ".sock";
+	std::ofstream(source_path) << program;
+
+	// Cold spawns, one after another.
+	std::vector<double> cold;
+	const auto cold_start = Clock::now();
+	for(int c = 0; c < options.requests; c++) {
+		const auto start = Clock::now();
+		int status;
+		waitpid(spawn({options.binary, "-i", source_path, "-o", output_path}), &status, 0);
+		cold.push_back(microseconds(Clock::now() - start));
+	}
+	const auto cold_seconds = std::chrono::duration<double>(Clock::now() - cold_start).count();
+
+	std::ifstream spawned(output_path, std::ios::binary);
+	const std::vector<uint8_t> expected{std::istreambuf_iterator<char>(spawned), {}};
+
+	// Start a server and wait for it to be ready.
+	const auto server = spawn({options.binary, "-s", socket_path});
+	int fd = -1;
+	for(int attempt = 0; attempt < 1000 && fd < 0; attempt++) {
+		fd = connect_to(socket_path);
+		if(fd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	if(fd < 0) {
+		std::cerr << "Server didn't start" << std::endl;
+		kill(server, SIGTERM);
+		return -1;
+	}
+
+	// Sequential requests over a single connection.
+	std::vector<double> warm;
+	bool matches = true;
+	const auto warm_start = Clock::now();
+	for(int c = 0; c < options.requests; c++) {
+		const auto start = Clock::now();
+		const auto response = Server::convert(fd, program);
+		warm.push_back(microseconds(Clock::now() - start));
+		matches &= response.status == Server::Status::Success && response.image == expected;
+	}
+	const auto warm_seconds = std::chrono::duration<double>(Clock::now() - warm_start).count();
+	close(fd);
+
+	// Concurrent clients, each with its own connection.
+	std::vector<std::vector<double>> per_client(size_t(options.clients));
+	std::vector<std::thread> clients;
+	const auto concurrent_start = Clock::now();
+	for(auto &latencies: per_client) {
+		clients.emplace_back([&] {
+			const int fd = connect_to(socket_path);
+			for(int c = 0; c < options.requests && fd >= 0; c++) {
+				const auto start = Clock::now();
+				Server::convert(fd, program);
+				latencies.push_back(microseconds(Clock::now() - start));
+			}
+			close(fd);
+		});
+	}
+	for(auto &client: clients) client.join();
+	const auto concurrent_seconds = std::chrono::duration<double>(Clock::now() - concurrent_start).count();
+
+	std::vector<double> concurrent;
+	for(const auto &latencies: per_client) {
+		concurrent.insert(concurrent.end(), latencies.begin(), latencies.end());
+	}
+
+	int status;
+	kill(server, SIGTERM);
+	waitpid(server, &status, 0);
+	unlink(source_path.c_str());
+	unlink(output_path.c_str());
+
+	printf("{\n");
+	printf("\t\"lines\": %d,\n", options.lines);
+	printf("\t\"source_bytes\": %zu,\n", program.size());
+	printf("\t\"clients\": %d,\n", options.clients);
+	printf("\t\"outputs_match\": %s,\n", matches ? "true" : "false");
+	print_latencies("cold_spawn", cold, cold_seconds);
+	print_latencies("server", warm, warm_seconds);
+	print_latencies("server_concurrent", concurrent, concurrent_seconds, true);
+	printf("}\n");
+	return matches ? 0 : -1;
+}
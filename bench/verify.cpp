@@ -0,0 +1,138 @@
+#include "corpus.hpp"
+
+#include "../src/tokeniser.hpp"
+#include "../src/uef.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+	Times verification of UEF images of many small programs, as for a large archive of tapes,
+	separating parsing, CRC verification, detokenisation and retokenisation. Also checks that
+	every program survives the round trip, both plain and gzip-compressed. Reports results as JSON.
+
+	Usage: verify [--seed n] [--size bytes] [--repetitions n]
+*/
+
+namespace {
+
+struct Options {
+	uint64_t seed = 1;
+	size_t size = 4 * 1024 * 1024;
+	int repetitions = 5;
+};
+
+struct Times {
+	double parse = 0.0, verify = 0.0, detokenise = 0.0, retokenise = 0.0;
+
+	double total() const {
+		return parse + verify + detokenise + retokenise;
+	}
+};
+
+/// Verifies every image in @c images, accumulating time spent in each phase.
+///
+/// @returns The number of images that verified successfully.
+size_t verify(const std::vector<std::vector<uint8_t>> &images, Times &times) {
+	using Clock = std::chrono::steady_clock;
+	const auto seconds = [](const Clock::time_point begin, const Clock::time_point end) {
+		return std::chrono::duration<double>(end - begin).count();
+	};
+
+	size_t verified = 0;
+	for(const auto &image: images) {
+		try {
+			const auto start = Clock::now();
+			const UEFReader reader(image);
+			const auto files = reader.files();
+			const auto parsed = Clock::now();
+			reader.verify();
+			const auto checked = Clock::now();
+
+			bool matches = true;
+			for(const auto &file: files) {
+				const auto before = Clock::now();
+				const auto text = Tokeniser::detokenise(file.data.data(), file.data.data() + file.data.size());
+				const auto middle = Clock::now();
+				matches &= Tokeniser::import(text) == file.data;
+				const auto after = Clock::now();
+
+				times.detokenise += seconds(before, middle);
+				times.retokenise += seconds(middle, after);
+			}
+
+			times.parse += seconds(start, parsed);
+			times.verify += seconds(parsed, checked);
+			verified += matches;
+		} catch(const std::exception &) {}
+	}
+	return verified;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for(int c = 1; c < argc; c++) {
+		if(c == argc - 1) {
+			std::cerr << "usage: verify [--seed n] [--size bytes] [--repetitions n]" << std::endl;
+			return -1;
+		}
+
+		const std::string option = argv[c];
+		const std::string value = argv[++c];
+		if(option == "--seed")				options.seed = std::stoull(value);
+		else if(option == "--size")			options.size = std::stoull(value);
+		else if(option == "--repetitions")	options.repetitions = std::max(1, std::stoi(value));
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	// Archived tapes tend to hold programs of a few kilobytes; aim for about a hundred lines each.
+	std::vector<std::vector<uint8_t>> images, compressed_images;
+	size_t program_bytes = 0;
+	for(const auto kind: Corpus::AllKinds) {
+		for(const auto &program: Corpus::generate(kind, options.seed, options.size / std::size(Corpus::AllKinds), 100)) {
+			images.push_back(tokenise_to_uef(program));
+			compressed_images.push_back(tokenise_to_uef(program, true));
+			program_bytes += program.size();
+		}
+	}
+
+	// Keep the best repetition of each phase.
+	Times best{1e9, 1e9, 1e9, 1e9};
+	size_t verified = 0;
+	for(int c = 0; c < options.repetitions; c++) {
+		Times times;
+		verified = verify(images, times);
+		best.parse = std::min(best.parse, times.parse);
+		best.verify = std::min(best.verify, times.verify);
+		best.detokenise = std::min(best.detokenise, times.detokenise);
+		best.retokenise = std::min(best.retokenise, times.retokenise);
+	}
+
+	Times compressed_times;
+	const auto compressed_verified = verify(compressed_images, compressed_times);
+	const bool passed = verified == images.size() && compressed_verified == compressed_images.size();
+
+	printf("{\n");
+	printf("\t\"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("\t\"tapes\": %zu,\n", images.size());
+	printf("\t\"source_bytes\": %zu,\n", program_bytes);
+	printf("\t\"parse_seconds\": %.6f,\n", best.parse);
+	printf("\t\"crc_seconds\": %.6f,\n", best.verify);
+	printf("\t\"detokenise_seconds\": %.6f,\n", best.detokenise);
+	printf("\t\"retokenise_seconds\": %.6f,\n", best.retokenise);
+	printf("\t\"tapes_per_second\": %.1f,\n", double(images.size()) / best.total());
+	printf("\t\"compressed_tapes_per_second\": %.1f,\n", double(compressed_images.size()) / compressed_times.total());
+	printf("\t\"verified\": %zu,\n", verified);
+	printf("\t\"compressed_verified\": %zu,\n", compressed_verified);
+	printf("\t\"passed\": %s\n", passed ? "true" : "false");
+	printf("}\n");
+	return passed ? 0 : -1;
+}
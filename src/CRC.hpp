@@ -4,7 +4,14 @@
 #include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <numeric>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC_HAS_CLMUL
+#include <immintrin.h>
+#endif
 
 namespace CRC {
 struct ByteSwapped16 {
@@ -14,42 +21,219 @@ public:
 	}
 	ByteSwapped16() = default;
 
-	uint16_t raw() const {	return value_;	}
-	static ByteSwapped16 from_raw(const uint16_t raw) {
+	constexpr uint16_t raw() const {	return value_;	}
+	static constexpr ByteSwapped16 from_raw(const uint16_t raw) {
 		ByteSwapped16 result{};
 		result.value_ = raw;
 		return result;
 	}
 
-	explicit operator uint16_t() const {	return std::rotl(value_, 8);	}
-	uint8_t high() const {	return uint8_t(value_ >> 0);	}
-	uint8_t low() const {	return uint8_t(value_ >> 8);	}
+	explicit constexpr operator uint16_t() const {	return std::rotl(value_, 8);	}
+	constexpr uint8_t high() const {	return uint8_t(value_ >> 0);	}
+	constexpr uint8_t low() const {	return uint8_t(value_ >> 8);	}
 
 private:
 	uint16_t value_ = 0;
 };
 
+/// Implements the individual CRC engines; @c crc16 picks between them. All take and return CRCs
+/// in their natural, unswapped form.
+namespace Engine {
+
+/// @returns (a · b) mod the CRC polynomial, for polynomials a and b of degree below 16.
+template <uint16_t polynomial>
+constexpr uint16_t multiply(uint16_t a, uint16_t b) {
+	uint16_t product = 0;
+	for(int bit = 15; bit >= 0; bit--) {
+		product = uint16_t((product << 1) ^ ((product & 0x8000) ? polynomial : 0));
+		if(b & (1 << bit)) product ^= a;
+	}
+	return product;
+}
+
+/// @returns x^n mod the CRC polynomial.
+template <uint16_t polynomial>
+constexpr uint16_t x_to_the(uint64_t n) {
+	uint16_t result = 1;
+	uint16_t square = 2;
+	while(n) {
+		if(n & 1) result = multiply<polynomial>(result, square);
+		square = multiply<polynomial>(square, square);
+		n >>= 1;
+	}
+	return result;
+}
+
+/// Tables for slicing-by-N: entry [k][b] is the CRC of byte b followed by k zero bytes.
+template <uint16_t polynomial>
+constexpr auto slicing_tables = [] {
+	std::array<std::array<uint16_t, 256>, 16> tables{};
+	for(int byte = 0; byte < 256; byte++) {
+		uint16_t value = uint16_t(byte << 8);
+		for(int bit = 0; bit < 8; bit++) {
+			value = uint16_t((value << 1) ^ ((value & 0x8000) ? polynomial : 0));
+		}
+		tables[0][byte] = value;
+	}
+	for(size_t k = 1; k < tables.size(); k++) {
+		for(int byte = 0; byte < 256; byte++) {
+			const auto previous = tables[k - 1][byte];
+			tables[k][byte] = uint16_t((previous << 8) ^ tables[0][previous >> 8]);
+		}
+	}
+	return tables;
+} ();
+
+template <uint16_t polynomial>
+uint16_t bytewise(const uint8_t *data, size_t length, uint16_t crc) {
+	const auto &table = slicing_tables<polynomial>[0];
+	while(length--) {
+		crc = uint16_t((crc << 8) ^ table[(crc >> 8) ^ *data++]);
+	}
+	return crc;
+}
+
+/// Processes @c slice bytes per step, using one table lookup per byte and no dependency between
+/// lookups other than on the CRC at the start of the step.
+template <uint16_t polynomial, size_t slice>
+uint16_t slicing(const uint8_t *data, size_t length, uint16_t crc) {
+	static_assert(slice >= 2 && slice <= 16);
+	const auto &tables = slicing_tables<polynomial>;
+
+	while(length >= slice) {
+		uint16_t next = tables[slice - 1][data[0] ^ (crc >> 8)] ^ tables[slice - 2][data[1] ^ (crc & 0xff)];
+		for(size_t c = 2; c < slice; c++) {
+			next ^= tables[slice - 1 - c][data[c]];
+		}
+		crc = next;
+		data += slice;
+		length -= slice;
+	}
+	return bytewise<polynomial>(data, length, crc);
+}
+
+#ifdef CRC_HAS_CLMUL
+
+/// @returns @c true if the carry-less multiply engine can be used on this processor.
+inline bool has_clmul() {
+	static const bool result = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+	return result;
+}
+
+__attribute__((target("pclmul,ssse3")))
+inline __m128i byte_reverse(const __m128i value) {
+	return _mm_shuffle_epi8(value, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/// Loads 16 bytes so that the first is most significant, i.e. as a polynomial of degree below 128.
+__attribute__((target("pclmul,ssse3")))
+inline __m128i load_polynomial(const uint8_t *const data) {
+	return byte_reverse(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+}
+
+/// @returns A polynomial of degree below 79 congruent to @c value · x^d, given @c constants of
+/// (x^(d+64) mod P, x^d mod P) in its (high, low) halves.
+__attribute__((target("pclmul,ssse3")))
+inline __m128i fold(const __m128i value, const __m128i constants) {
+	return _mm_xor_si128(
+		_mm_clmulepi64_si128(value, constants, 0x11),
+		_mm_clmulepi64_si128(value, constants, 0x00));
+}
+
+/// Folds the input 64 bytes at a time through carry-less multiplication, until fewer than 16
+/// bytes remain; then finishes with a table. Requires at least 64 bytes.
+template <uint16_t polynomial>
+__attribute__((target("pclmul,ssse3")))
+uint16_t clmul(const uint8_t *data, size_t length, uint16_t crc) {
+	const auto fold_128 = _mm_set_epi64x(x_to_the<polynomial>(128 + 64), x_to_the<polynomial>(128));
+	const auto fold_512 = _mm_set_epi64x(x_to_the<polynomial>(512 + 64), x_to_the<polynomial>(512));
+
+	// An initial value is equivalent to its exclusive OR into the first two bytes of data.
+	__m128i lanes[4];
+	for(int c = 0; c < 4; c++) {
+		lanes[c] = load_polynomial(data + c * 16);
+	}
+	lanes[0] = _mm_xor_si128(lanes[0], _mm_set_epi64x(int64_t(uint64_t(crc) << 48), 0));
+	data += 64;
+	length -= 64;
+
+	// Fold four independent lanes forward by 512 bits per step.
+	while(length >= 64) {
+		for(int c = 0; c < 4; c++) {
+			lanes[c] = _mm_xor_si128(fold(lanes[c], fold_512), load_polynomial(data + c * 16));
+		}
+		data += 64;
+		length -= 64;
+	}
+
+	// Merge lanes, then fold in any further whole 16-byte blocks.
+	auto value = lanes[0];
+	for(int c = 1; c < 4; c++) {
+		value = _mm_xor_si128(fold(value, fold_128), lanes[c]);
+	}
+	while(length >= 16) {
+		value = _mm_xor_si128(fold(value, fold_128), load_polynomial(data));
+		data += 16;
+		length -= 16;
+	}
+
+	// The CRC of the folded value, as a 16-byte message, is that of everything so far.
+	alignas(16) uint8_t folded[16];
+	_mm_store_si128(reinterpret_cast<__m128i *>(folded), byte_reverse(value));
+	crc = slicing<polynomial, 16>(folded, 16, 0);
+	return bytewise<polynomial>(data, length, crc);
+}
+
+#endif
+
+/// Uses whichever engine is likely fastest for @c length bytes on this processor.
+template <uint16_t polynomial>
+uint16_t best(const uint8_t *const data, const size_t length, const uint16_t crc) {
+#ifdef CRC_HAS_CLMUL
+	if(length >= 128 && has_clmul()) {
+		return clmul<polynomial>(data, length, crc);
+	}
+#endif
+	if(length >= 16) {
+		return slicing<polynomial, 16>(data, length, crc);
+	}
+	return bytewise<polynomial>(data, length, crc);
+}
+
+// Generates an at-compile-time table mapping from the top byte of a 16-bit CRC in progress
+// to the net XOR mask that results from bit-by-bit rotates to the left.
+//
+// The final table is byte swapped to simplify the loop in crc16; only one is included in the
+// produced binary per polynomial, regardless of iterator type.
+template <uint16_t polynomial>
+constexpr auto xor_table = [] {
+	constexpr uint16_t xor_masks[] = {0, std::rotl(uint16_t(polynomial ^ 1), 8)};
+	std::array<uint16_t, 256> table;
+
+	std::iota(table.begin(), table.end(), 0);
+	for(auto &value: table) {
+		for(int bit = 0; bit < 8; bit++) {
+			value = std::rotl(value, 1);
+			value ^= xor_masks[(value >> 8) & 1];
+		}
+	}
+	return table;
+} ();
+
+}
+
+/// Calculates the CRC of the bytes from @c begin to @c end, continuing from @c initial. This may
+/// also be evaluated at compile time, in which case the table-driven form is always used.
 template <uint16_t polynomial = 0x1021, typename IteratorT>
-ByteSwapped16 crc16(IteratorT begin, const IteratorT end, const ByteSwapped16 initial = ByteSwapped16{0x0000}) {
-	// Generates an at-compile-time table mapping from the top byte of a 16-bit CRC in progress
-	// to the net XOR mask that results from bit-by-bit rotates to the left.
-	//
-	// The final table is byte swapped to simplify the loop below; the compiler proved
-	// trustworthy in spotting that these tables are independent of the type of IteratorT,
-	// including only one per polynomial in the produced binary.
-	static constexpr auto xor_table = [] {
-		constexpr uint16_t xor_masks[] = {0, std::rotl(uint16_t(polynomial ^ 1), 8)};
-		std::array<uint16_t, 256> table;
-
-		std::iota(table.begin(), table.end(), 0);
-		for(auto &value: table) {
-			for(int bit = 0; bit < 8; bit++) {
-				value = std::rotl(value, 1);
-				value ^= xor_masks[(value >> 8) & 1];
-			}
+constexpr ByteSwapped16 crc16(IteratorT begin, const IteratorT end, const ByteSwapped16 initial = ByteSwapped16{0x0000}) {
+	// Contiguous runs of bytes can be handed to the faster engines.
+	if constexpr (std::contiguous_iterator<IteratorT> && sizeof(std::iter_value_t<IteratorT>) == 1) {
+		if(!std::is_constant_evaluated()) {
+			const auto data = reinterpret_cast<const uint8_t *>(std::to_address(begin));
+			return ByteSwapped16(Engine::best<polynomial>(data, size_t(end - begin), uint16_t(initial)));
 		}
-		return table;
-	} ();
+	}
+	const auto &xor_table = Engine::xor_table<polynomial>;
 
 	// Calculate the CRC in byte-swapped form so as slighltly to simplify the inner loop.
 	uint16_t crc = initial.raw();
@@ -59,4 +243,14 @@ ByteSwapped16 crc16(IteratorT begin, const IteratorT end, const ByteSwapped16 in
 	}
 	return ByteSwapped16::from_raw(crc);
 }
+
+/// Given @c first, the CRC of some data A, and @c second, the CRC of some data B of length
+/// @c second_length calculated with an initial value of zero, returns the CRC of A followed by B.
+///
+/// This allows separate parts of a buffer to be checksummed in parallel.
+template <uint16_t polynomial = 0x1021>
+ByteSwapped16 crc16_combine(const ByteSwapped16 first, const ByteSwapped16 second, const size_t second_length) {
+	const auto shifted = Engine::multiply<polynomial>(uint16_t(first), Engine::x_to_the<polynomial>(uint64_t(second_length) * 8));
+	return ByteSwapped16(uint16_t(shifted ^ uint16_t(second)));
+}
 }
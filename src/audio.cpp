@@ -0,0 +1,443 @@
+#include "audio.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+/*
+	Rendering is split in three:
+
+		* a Player walks the chunks of the tape, reducing everything to runs of cycles and
+		to silence, timed against a fractional sample clock so that rounding never accumulates;
+		* an Encoder turns each run into the bytes of the output format, copying it from a table
+		of precomputed encodings keyed by number of cycles and length in samples; and
+		* an OutputFile streams those bytes out through a fixed-size buffer, patching in the
+		header, which records the total length, once everything else has been written.
+
+	A bit is a single run, e.g. at 1200 baud a 0 is one cycle of the base frequency and a 1 is
+	two of twice the base frequency, both over a single period of the base frequency. As a bit
+	period is rarely a whole number of samples there are a couple of lengths of each in practice,
+	so the table stays tiny and nearly all of the work is in copying.
+*/
+
+namespace Audio {
+
+Format format_for(const std::string &file_name) {
+	auto extension = std::filesystem::path(file_name).extension().string();
+	for(auto &ch: extension) ch = char(tolower(ch));
+	return extension == ".csw" ? Format::CSW : Format::WAV;
+}
+
+namespace {
+
+//
+// MARK: - OutputFile.
+//
+
+/// Writes a file front to back through a fixed-size buffer, other than for a header which is
+/// written last. If destroyed without being closed then the partial file is removed.
+class OutputFile {
+public:
+	static constexpr size_t BufferSize = 1024 * 1024;
+
+	explicit OutputFile(const std::string &file_name) :
+		file_name_(file_name), buffer_(std::make_unique<uint8_t[]>(BufferSize)) {
+		file_ = open(file_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if(file_ < 0) {
+			throw std::runtime_error("Unable to open for output: " + file_name_);
+		}
+	}
+
+	~OutputFile() {
+		if(file_ < 0) return;
+		::close(file_);
+		unlink(file_name_.c_str());
+	}
+
+	/// @returns Space for @c length bytes, at most @c BufferSize, which must be filled before the next call.
+	uint8_t *reserve(const size_t length) {
+		if(BufferSize - used_ < length) {
+			flush();
+		}
+		const auto result = buffer_.get() + used_;
+		used_ += length;
+		return result;
+	}
+
+	void append(const std::vector<uint8_t> &data) {
+		memcpy(reserve(data.size()), data.data(), data.size());
+	}
+
+	void fill(const uint8_t value, uint64_t length) {
+		while(length) {
+			const auto run = size_t(std::min(length, uint64_t(BufferSize)));
+			memset(reserve(run), value, run);
+			length -= run;
+		}
+	}
+
+	uint64_t size() const {
+		return written_ + used_;
+	}
+
+	/// Writes out all remaining data, then @c header over the start of the file, and closes it.
+	///
+	/// @throws std::runtime_error if the file can't be written.
+	void close(const std::vector<uint8_t> &header) {
+		flush();
+		write(header.data(), header.size(), 0);
+
+		const int file = file_;
+		file_ = -1;
+		if(::close(file)) {
+			unlink(file_name_.c_str());
+			throw std::runtime_error("Unable to complete output: " + file_name_);
+		}
+	}
+
+private:
+	void flush() {
+		write(buffer_.get(), used_, written_);
+		written_ += used_;
+		used_ = 0;
+	}
+
+	void write(const uint8_t *data, size_t length, uint64_t offset) {
+		while(length) {
+			const auto written = pwrite(file_, data, length, off_t(offset));
+			if(written < 0) {
+				if(errno == EINTR) continue;
+				throw std::runtime_error("Unable to write output: " + file_name_);
+			}
+			data += written;
+			length -= size_t(written);
+			offset += uint64_t(written);
+		}
+	}
+
+	const std::string file_name_;
+	int file_ = -1;
+	std::unique_ptr<uint8_t[]> buffer_;
+	size_t used_ = 0;
+	uint64_t written_ = 0;
+};
+
+//
+// MARK: - Encoder.
+//
+
+/// Appends a CSW pulse of @c length samples to @c target: a single byte if it fits, otherwise
+/// a zero followed by the length in four bytes.
+void append_pulse(std::vector<uint8_t> &target, const uint64_t length) {
+	if(length < 256) {
+		target.push_back(uint8_t(length));
+		return;
+	}
+	const auto value = uint32_t(std::min(length, uint64_t(UINT32_MAX)));
+	target.insert(target.end(), {0, uint8_t(value >> 0), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)});
+}
+
+class Encoder {
+public:
+	Encoder(const Format format, OutputFile &file) : format_(format), file_(file) {}
+
+	/// Appends @c count cycles, which must be 1, 2, 4 or 8, spread evenly over @c length samples.
+	void cycles(const unsigned count, const size_t length) {
+		file_.append(encoding(count, length));
+		pulses_ += count * 2;
+	}
+
+	/// Appends @c length samples of silence; in a CSW that's a single pulse.
+	void silence(const uint64_t length) {
+		if(!length) return;
+		if(format_ == Format::WAV) {
+			file_.fill(Midpoint, length);
+			return;
+		}
+
+		pulse_.clear();
+		append_pulse(pulse_, length);
+		file_.append(pulse_);
+		++pulses_;
+	}
+
+	uint64_t pulses() const {
+		return pulses_;
+	}
+
+private:
+	static constexpr uint8_t Midpoint = 0x80;
+
+	const std::vector<uint8_t> &encoding(const unsigned count, const size_t length) {
+		auto &encodings = encodings_[size_t(std::countr_zero(count))];
+		if(encodings.size() <= length) {
+			encodings.resize(length + 1);
+		}
+		auto &encoding = encodings[length];
+		if(encoding.empty()) {
+			encoding = encode(count, length);
+		}
+		return encoding;
+	}
+
+	std::vector<uint8_t> encode(const unsigned count, const size_t length) const {
+		std::vector<uint8_t> result;
+		if(format_ == Format::WAV) {
+			// Sample at the middle of each sample period, so that the two halves of each cycle mirror each other.
+			result.resize(length);
+			for(size_t c = 0; c < length; c++) {
+				const auto phase = 2.0 * std::numbers::pi * double(count) * (double(c) + 0.5) / double(length);
+				result[c] = uint8_t(std::lround(Midpoint + 127.0 * std::sin(phase)));
+			}
+			return result;
+		}
+
+		// Each cycle is two pulses, as near equal in length as possible.
+		const size_t pulses = count * 2;
+		size_t start = 0;
+		for(size_t c = 1; c <= pulses; c++) {
+			const size_t end = (length * c + pulses / 2) / pulses;
+			append_pulse(result, end - start);
+			start = end;
+		}
+		return result;
+	}
+
+	const Format format_;
+	OutputFile &file_;
+	uint64_t pulses_ = 0;
+	std::vector<uint8_t> pulse_;
+
+	/// Encodings of 1, 2, 4 and 8 cycles, each indexed by length.
+	std::array<std::vector<std::vector<uint8_t>>, 4> encodings_;
+};
+
+//
+// MARK: - Player.
+//
+
+class Player {
+public:
+	Player(Encoder &encoder, const uint32_t sample_rate) : encoder_(encoder), sample_rate_(sample_rate) {
+		set_base_frequency(1200.0);
+	}
+
+	void play(const UEFReader &tape) {
+		for(const auto &chunk: tape.chunks()) {
+			const auto &contents = chunk.contents;
+			const auto integer = [&](const size_t offset) {
+				return uint16_t(contents[offset] | (contents[offset + 1] << 8));
+			};
+			const auto real = [&](const size_t offset) {
+				return std::bit_cast<float>(uint32_t(integer(offset) | (integer(offset + 2) << 16)));
+			};
+
+			// UEFReader has already checked the lengths of all but chunk $0117.
+			switch(chunk.id) {
+				default: break;
+
+				case 0x0100:
+					for(const auto value: contents) {
+						byte(value);
+					}
+				break;
+
+				case 0x0110:
+					carrier(integer(0));
+				break;
+
+				case 0x0111:
+					carrier(integer(0));
+					byte(0xaa);
+					carrier(integer(2));
+				break;
+
+				case 0x0112:
+					// An integer gap is measured in cycles of carrier.
+					silence(double(integer(0)) / (2.0 * base_frequency_));
+				break;
+
+				case 0x0113:
+					set_base_frequency(real(0));
+				break;
+
+				case 0x0116:
+					silence(real(0));
+				break;
+
+				case 0x0117:
+					if(contents.size() != 2) throw std::runtime_error("Bad data rate chunk");
+					bit_length_ = integer(0) == 300 ? 4 : 1;
+				break;
+			}
+		}
+	}
+
+	uint64_t samples() const {
+		return emitted_;
+	}
+
+private:
+	void set_base_frequency(const double frequency) {
+		// Keep at least a couple of samples per pulse, and each encoding within the output buffer.
+		const double samples_per_cycle = double(sample_rate_) / frequency;
+		if(!(samples_per_cycle >= 8.0 && samples_per_cycle <= 65536.0)) {
+			throw std::runtime_error(
+				"A base frequency of " + std::to_string(frequency) + "Hz can't be rendered at " +
+				std::to_string(sample_rate_) + "Hz");
+		}
+		base_frequency_ = frequency;
+		samples_per_cycle_ = samples_per_cycle;
+	}
+
+	/// Plays @c count cycles over @c periods periods of the base frequency.
+	void cycles(const unsigned count, const double periods) {
+		clock_ += periods * samples_per_cycle_;
+		const auto end = uint64_t(clock_ + 0.5);
+		encoder_.cycles(count, size_t(end - emitted_));
+		emitted_ = end;
+	}
+
+	void silence(const double seconds) {
+		if(!(seconds > 0.0)) return;
+		clock_ += seconds * double(sample_rate_);
+		const auto end = uint64_t(clock_ + 0.5);
+		encoder_.silence(end - emitted_);
+		emitted_ = end;
+	}
+
+	/// Plays @c count cycles of twice the base frequency.
+	void carrier(unsigned count) {
+		for(; count >= 2; count -= 2) {
+			cycles(2, 1.0);
+		}
+		if(count) {
+			cycles(1, 0.5);
+		}
+	}
+
+	/// Plays a start bit, then the bits of @c value from least significant, then a stop bit.
+	void byte(uint8_t value) {
+		bit(false);
+		for(int c = 0; c < 8; c++) {
+			bit(value & 1);
+			value >>= 1;
+		}
+		bit(true);
+	}
+
+	void bit(const bool value) {
+		cycles(value ? bit_length_ * 2 : bit_length_, bit_length_);
+	}
+
+	Encoder &encoder_;
+	const uint32_t sample_rate_;
+	double base_frequency_ = 1200.0;
+	double samples_per_cycle_ = 0.0;
+
+	/// The length of a bit in periods of the base frequency: 1 at 1200 baud, 4 at 300.
+	unsigned bit_length_ = 1;
+
+	double clock_ = 0.0;
+	uint64_t emitted_ = 0;
+};
+
+//
+// MARK: - Headers.
+//
+
+constexpr size_t WAVHeaderLength = 44;
+constexpr size_t CSWHeaderLength = 52;
+
+struct HeaderBuilder {
+	void text(const char *const value) {
+		bytes.insert(bytes.end(), value, value + strlen(value));
+	}
+	void integer(const uint64_t value, const size_t length) {
+		for(size_t c = 0; c < length; c++) {
+			bytes.push_back(uint8_t(value >> (c * 8)));
+		}
+	}
+	std::vector<uint8_t> bytes;
+};
+
+std::vector<uint8_t> wav_header(const uint32_t sample_rate, const uint64_t samples) {
+	if(samples > UINT32_MAX - WAVHeaderLength) {
+		throw std::runtime_error("Tape is too long for a WAV file");
+	}
+
+	HeaderBuilder header;
+	header.text("RIFF");
+	header.integer(WAVHeaderLength - 8 + samples, 4);
+	header.text("WAVE");
+
+	// PCM, one channel of eight bits.
+	header.text("fmt ");
+	header.integer(16, 4);
+	header.integer(1, 2);
+	header.integer(1, 2);
+	header.integer(sample_rate, 4);
+	header.integer(sample_rate, 4);
+	header.integer(1, 2);
+	header.integer(8, 2);
+
+	header.text("data");
+	header.integer(samples, 4);
+	return header.bytes;
+}
+
+std::vector<uint8_t> csw_header(const uint32_t sample_rate, const uint64_t pulses) {
+	if(pulses > UINT32_MAX) {
+		throw std::runtime_error("Tape is too long for a CSW file");
+	}
+
+	HeaderBuilder header;
+	header.text("Compressed Square Wave\x1a");
+	header.integer(2, 1);
+	header.integer(0, 1);
+	header.integer(sample_rate, 4);
+	header.integer(pulses, 4);
+
+	// RLE, starting low, with no header extension; then the encoding application, padded to 16 bytes.
+	header.integer(1, 1);
+	header.integer(0, 1);
+	header.integer(0, 1);
+	header.text("bas2uef v1.0");
+	header.bytes.resize(CSWHeaderLength);
+	return header.bytes;
+}
+
+}
+
+Result render(const UEFReader &tape, const std::string &file_name, const Options &options) {
+	OutputFile file(file_name);
+	const size_t header_length = options.format == Format::WAV ? WAVHeaderLength : CSWHeaderLength;
+	file.fill(0, header_length);
+
+	Encoder encoder(options.format, file);
+	Player player(encoder, options.sample_rate);
+	player.play(tape);
+
+	Result result;
+	result.samples = player.samples();
+	result.seconds = double(result.samples) / double(options.sample_rate);
+	result.bytes = file.size();
+	file.close(
+		options.format == Format::WAV ?
+			wav_header(options.sample_rate, result.samples) :
+			csw_header(options.sample_rate, encoder.pulses()));
+	return result;
+}
+
+}
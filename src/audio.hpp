@@ -0,0 +1,45 @@
+#pragma once
+
+#include "uef.hpp"
+
+#include <cstdint>
+#include <string>
+
+/// Renders UEF images as the audio that a cassette recorder would play: WAV files of 8-bit
+/// mono PCM, or CSW files of RLE-encoded pulse lengths.
+namespace Audio {
+
+enum class Format {
+	WAV,
+	CSW,
+};
+
+/// @returns @c Format::CSW if @c file_name has a .csw extension; @c Format::WAV otherwise.
+Format format_for(const std::string &file_name);
+
+struct Options {
+	Format format = Format::WAV;
+	uint32_t sample_rate = 44100;
+};
+
+struct Result {
+	/// The length of the recording.
+	uint64_t samples = 0;
+	double seconds = 0.0;
+
+	/// The size of the file written.
+	uint64_t bytes = 0;
+};
+
+/// Renders @c tape to @c file_name, streaming it out as it goes.
+///
+/// Carrier tone in chunks $0110 and $0111 becomes cycles of twice the base frequency; each byte
+/// of chunks $0100 becomes a start bit, eight data bits from least significant and a stop bit; gaps
+/// in chunks $0112 and $0116 become silence. Base frequency changes in chunk $0113 and data rate
+/// changes in chunk $0117 are honoured. Other chunks are skipped.
+///
+/// @throws std::runtime_error if the file can't be written, or if the tape's base frequency is
+/// too high or too low for @c options.sample_rate. No partial file is left behind.
+Result render(const UEFReader &tape, const std::string &file_name, const Options &options = Options());
+
+}
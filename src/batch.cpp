@@ -0,0 +1,479 @@
+#include "batch.hpp"
+
+#include "input.hpp"
+#include "thread_pool.hpp"
+#include "tokeniser.hpp"
+#include "uef.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+namespace Batch {
+namespace {
+
+std::string output_name(const std::filesystem::path &input, const std::string &output_directory) {
+	auto output = input;
+	output.replace_extension(".uef");
+	if(!output_directory.empty()) {
+		output = std::filesystem::path(output_directory) / output.filename();
+	}
+	return output.string();
+}
+
+/// @returns All regular files directly within @c directory with extension @c extension, in name order.
+std::vector<std::filesystem::path> directory_contents(const std::string &directory, const char *const extension) {
+	std::error_code error;
+	std::vector<std::filesystem::path> contents;
+	for(const auto &entry: std::filesystem::directory_iterator(directory, error)) {
+		if(entry.is_regular_file() && entry.path().extension() == extension) {
+			contents.push_back(entry.path());
+		}
+	}
+	if(error) {
+		throw std::runtime_error("Couldn't read directory " + directory);
+	}
+
+	std::sort(contents.begin(), contents.end());
+	return contents;
+}
+
+/// @returns @c text as a JSON string literal.
+std::string json_string(const std::string &text) {
+	std::string result = "\"";
+	for(const auto ch: text) {
+		if(ch == '"' || ch == '\\') {
+			result += '\\';
+			result += ch;
+		} else if(uint8_t(ch) < 0x20) {
+			char escape[7];
+			snprintf(escape, sizeof(escape), "\\u%04x", ch);
+			result += escape;
+		} else {
+			result += ch;
+		}
+	}
+	return result + "\"";
+}
+
+uint32_t parse_address(std::string address) {
+	if(!address.empty() && address[0] == '&') address.erase(0, 1);
+	size_t parsed = 0;
+	unsigned long value = 0;
+	try {
+		value = std::stoul(address, &parsed, 16);
+	} catch(const std::exception &) {}
+	if(address.empty() || parsed != address.size() || value > 0xffff'ffff) {
+		throw std::runtime_error("Invalid address: " + address);
+	}
+	return uint32_t(value);
+}
+
+Program program(const std::filesystem::path &input) {
+	Program program{input.string(), CassetteFile()};
+	program.file.name = input.stem().string().substr(0, 10);
+	return program;
+}
+
+/// @returns The DFS form of cassette file name @c name: cut to seven characters, other than a directory prefix.
+std::string disc_name(const std::string &name) {
+	const size_t prefix = name.size() > 2 && name[1] == '.' ? 2 : 0;
+	return name.substr(0, prefix + 7);
+}
+
+void write_catalogue(const std::string &file_name, const std::string &tape, const bool compress, const std::vector<CatalogueEntry> &entries) {
+	FILE *const file = fopen(file_name.c_str(), "w");
+	if(!file) {
+		throw std::runtime_error("Unable to open for output: " + file_name);
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"tape\": %s,\n", json_string(tape).c_str());
+	fprintf(file, "\t\"compressed\": %s,\n", compress ? "true" : "false");
+	fprintf(file, "\t\"files\": [\n");
+	for(size_t c = 0; c < entries.size(); c++) {
+		const auto &entry = entries[c];
+		fprintf(file,
+			"\t\t{\"name\": %s, \"input\": %s, \"load\": %u, \"exec\": %u, "
+			"\"offset\": %zu, \"length\": %zu, \"first_block\": %zu, \"blocks\": %zu}%s\n",
+			json_string(entry.file.name).c_str(), json_string(entry.input).c_str(),
+			entry.file.load_address, entry.file.execution_address,
+			entry.offset, entry.length, entry.first_block, entry.blocks, c + 1 < entries.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+
+	if(ferror(file) | fclose(file)) {
+		throw std::runtime_error("Unable to write " + file_name);
+	}
+}
+
+struct Outcome {
+	size_t bytes_in = 0;
+	std::string error;
+};
+
+Outcome verify(const std::string &tape, ThreadPool *const pool) {
+	Outcome outcome;
+	try {
+		const UEFReader reader(tape);
+		for(const auto &block: reader.blocks()) {
+			outcome.bytes_in += block.data.size();
+		}
+		reader.verify(pool);
+
+		for(const auto &file: reader.files()) {
+			const auto text = Tokeniser::detokenise(file.data.data(), file.data.data() + file.data.size());
+			const auto program = pool ? Tokeniser::import(text, *pool) : Tokeniser::import(text);
+			if(program != file.data) {
+				throw std::runtime_error(file.name + " doesn't survive detokenisation");
+			}
+		}
+	} catch(const Tokeniser::Error &error) {
+		outcome.error = "Detokenised text doesn't tokenise: " + error.to_string();
+	} catch(const std::exception &error) {
+		outcome.error = error.what();
+	}
+	return outcome;
+}
+
+Outcome convert(const Job &job, const bool compress, const TapeLayout &layout, const Tokeniser::Dialect dialect) {
+	Outcome outcome;
+	try {
+		const InputBuffer source(job.input);
+		outcome.bytes_in = source.view().size();
+		tokenise_to_uef(job.output, source.view(), compress, nullptr, nullptr, layout, dialect);
+	} catch(const Tokeniser::Error &error) {
+		outcome.error = error.to_string();
+	} catch(const std::exception &error) {
+		outcome.error = error.what();
+	}
+	return outcome;
+}
+
+}
+
+std::vector<Job> collect(const std::vector<std::string> &inputs, const std::string &output_directory) {
+	std::vector<Job> jobs;
+
+	for(const auto &input: inputs) {
+		if(!input.empty() && input[0] == '@') {
+			const auto manifest_name = input.substr(1);
+			std::ifstream manifest(manifest_name);
+			if(!manifest) {
+				throw std::runtime_error("Couldn't open manifest " + manifest_name);
+			}
+
+			std::string line;
+			while(std::getline(manifest, line)) {
+				std::istringstream fields(line);
+				std::string source, output;
+				if(!(fields >> source)) continue;
+				if(!(fields >> output)) output = output_name(source, output_directory);
+				jobs.push_back(Job{source, output});
+			}
+			continue;
+		}
+
+		std::error_code error;
+		if(std::filesystem::is_directory(input, error)) {
+			for(const auto &source: directory_contents(input, ".bas")) {
+				jobs.push_back(Job{source.string(), output_name(source, output_directory)});
+			}
+			continue;
+		}
+
+		jobs.push_back(Job{input, output_name(input, output_directory)});
+	}
+
+	return jobs;
+}
+
+size_t convert(
+	const std::vector<Job> &jobs,
+	const size_t threads,
+	const bool compress,
+	const TapeLayout &layout,
+	const Tokeniser::Dialect dialect
+) {
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::future<Outcome>> outcomes;
+	outcomes.reserve(jobs.size());
+	ThreadPool pool(threads);
+	for(const auto &job: jobs) {
+		outcomes.push_back(pool.submit([&job, compress, &layout, dialect] { return convert(job, compress, layout, dialect); }));
+	}
+
+	// Report in job order regardless of completion order.
+	size_t failures = 0;
+	size_t bytes_in = 0;
+	for(size_t c = 0; c < jobs.size(); c++) {
+		const auto outcome = outcomes[c].get();
+		bytes_in += outcome.bytes_in;
+		if(!outcome.error.empty()) {
+			std::cout << "ERROR: " << jobs[c].input << ": " << outcome.error << std::endl;
+			++failures;
+		}
+	}
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout <<
+		"Converted " << (jobs.size() - failures) << " of " << jobs.size() << " files" <<
+		" on " << pool.size() << " threads in " << seconds << "s: " <<
+		double(jobs.size()) / seconds << " files/s, " <<
+		double(bytes_in) / (seconds * 1024.0 * 1024.0) << " MB/s" << std::endl;
+
+	return failures;
+}
+
+std::vector<std::string> collect_tapes(const std::vector<std::string> &inputs) {
+	std::vector<std::string> tapes;
+	for(const auto &input: inputs) {
+		std::error_code error;
+		if(std::filesystem::is_directory(input, error)) {
+			for(const auto &tape: directory_contents(input, ".uef")) {
+				tapes.push_back(tape.string());
+			}
+			continue;
+		}
+		tapes.push_back(input);
+	}
+	return tapes;
+}
+
+size_t verify(const std::vector<std::string> &tapes, const size_t threads) {
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::future<Outcome>> outcomes;
+	outcomes.reserve(tapes.size());
+	ThreadPool pool(threads);
+	if(tapes.size() == 1) {
+		// Verify a lone tape on this thread, dividing its work between the pool.
+		outcomes.push_back(std::async(std::launch::deferred, [&] { return verify(tapes.front(), &pool); }));
+	} else {
+		for(const auto &tape: tapes) {
+			outcomes.push_back(pool.submit([&tape] { return verify(tape, nullptr); }));
+		}
+	}
+
+	size_t failures = 0;
+	size_t bytes_in = 0;
+	for(size_t c = 0; c < tapes.size(); c++) {
+		const auto outcome = outcomes[c].get();
+		bytes_in += outcome.bytes_in;
+		if(!outcome.error.empty()) {
+			std::cout << "ERROR: " << tapes[c] << ": " << outcome.error << std::endl;
+			++failures;
+		}
+	}
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout <<
+		"Verified " << (tapes.size() - failures) << " of " << tapes.size() << " tapes" <<
+		" on " << pool.size() << " threads in " << seconds << "s: " <<
+		double(tapes.size()) / seconds << " tapes/s, " <<
+		double(bytes_in) / (seconds * 1024.0 * 1024.0) << " MB/s of programs" << std::endl;
+
+	return failures;
+}
+
+std::vector<Program> collect_programs(const std::vector<std::string> &inputs) {
+	std::vector<Program> programs;
+
+	for(const auto &input: inputs) {
+		if(!input.empty() && input[0] == '@') {
+			const auto manifest_name = input.substr(1);
+			std::ifstream manifest(manifest_name);
+			if(!manifest) {
+				throw std::runtime_error("Couldn't open manifest " + manifest_name);
+			}
+
+			std::string line;
+			while(std::getline(manifest, line)) {
+				std::istringstream fields(line);
+				std::string source, name, load, exec;
+				if(!(fields >> source)) continue;
+
+				auto &entry = programs.emplace_back(program(source));
+				if(fields >> name) entry.file.name = name;
+				if(fields >> load) entry.file.load_address = parse_address(load);
+				if(fields >> exec) entry.file.execution_address = parse_address(exec);
+			}
+			continue;
+		}
+
+		std::error_code error;
+		if(std::filesystem::is_directory(input, error)) {
+			for(const auto &source: directory_contents(input, ".bas")) {
+				programs.push_back(program(source));
+			}
+			continue;
+		}
+
+		programs.push_back(program(input));
+	}
+
+	return programs;
+}
+
+size_t pack(
+	const std::vector<Program> &programs,
+	const std::string &output,
+	const std::string &catalogue,
+	const size_t threads,
+	const bool compress,
+	const TapeLayout &layout,
+	const Tokeniser::Dialect dialect
+) {
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::future<std::vector<uint8_t>>> tokenised;
+	tokenised.reserve(programs.size());
+	ThreadPool pool(threads);
+	for(const auto &program: programs) {
+		tokenised.push_back(pool.submit([&program, dialect] {
+			const InputBuffer source(program.input);
+			return Tokeniser::import(source.view(), dialect);
+		}));
+	}
+
+	// Write files in order, each as soon as it's ready; once anything has failed, just collect errors.
+	UEFWriter writer(output, compress);
+	writer.chunk(0x0000, "bas2uef v1.0");
+	std::optional<UEFBlockStream> blocks;
+	std::vector<CatalogueEntry> entries;
+	size_t failures = 0;
+	size_t bytes_in = 0;
+	size_t block_count = 0;
+	for(size_t c = 0; c < programs.size(); c++) {
+		std::vector<uint8_t> program;
+		try {
+			program = tokenised[c].get();
+		} catch(const Tokeniser::Error &error) {
+			std::cout << "ERROR: " << programs[c].input << ": " << error.to_string() << std::endl;
+			++failures;
+		} catch(const std::exception &error) {
+			std::cout << "ERROR: " << programs[c].input << ": " << error.what() << std::endl;
+			++failures;
+		}
+		if(failures) continue;
+
+		auto &entry = entries.emplace_back();
+		entry.input = programs[c].input;
+		entry.file = programs[c].file;
+		entry.offset = writer.size();
+		if(blocks) {
+			blocks->begin_file(entry.file);
+		} else {
+			blocks.emplace(writer, nullptr, layout, entry.file);
+		}
+		blocks->append(program.data(), program.data() + program.size());
+		blocks->finish();
+
+		entry.length = writer.size() - entry.offset;
+		entry.first_block = block_count;
+		entry.blocks = (program.size() + UEFBlockStream::BlockSize - 1) / UEFBlockStream::BlockSize;
+		block_count += entry.blocks;
+		bytes_in += program.size();
+	}
+
+	// An unclosed writer leaves nothing behind.
+	if(failures) {
+		return failures;
+	}
+	writer.close();
+	write_catalogue(catalogue, output, compress, entries);
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout <<
+		"Packed " << programs.size() << " files in " << block_count << " blocks" <<
+		" on " << pool.size() << " threads in " << seconds << "s: " <<
+		double(programs.size()) / seconds << " files/s, " <<
+		double(bytes_in) / (seconds * 1024.0 * 1024.0) << " MB/s of programs" << std::endl;
+
+	return 0;
+}
+
+size_t disc(
+	const std::vector<Program> &programs,
+	const std::string &output,
+	const size_t threads,
+	const DiscOptions &options,
+	const Tokeniser::Dialect dialect
+) {
+	const auto start = std::chrono::steady_clock::now();
+	DFS::Disc disc(DFS::format_for(output), options.tracks, options.title);
+
+	std::vector<std::future<std::vector<uint8_t>>> tokenised;
+	tokenised.reserve(programs.size());
+	ThreadPool pool(threads);
+	for(const auto &program: programs) {
+		tokenised.push_back(pool.submit([&program, dialect] {
+			const InputBuffer source(program.input);
+			return Tokeniser::import(source.view(), dialect);
+		}));
+	}
+
+	// The !BOOT file goes first, so that it's sure of a place on the first side.
+	if(options.boot && !programs.empty()) {
+		DFS::File boot;
+		boot.name = "!BOOT";
+		boot.load_address = boot.execution_address = 0;
+		disc.add(boot, DFS::boot_file(disc_name(programs.front().file.name)));
+		disc.set_boot_option(DFS::BootOption::Exec);
+	}
+
+	// Add files in order, each straight into the image as soon as it's ready.
+	size_t failures = 0;
+	size_t bytes_in = 0;
+	for(size_t c = 0; c < programs.size(); c++) {
+		try {
+			const auto program = tokenised[c].get();
+
+			DFS::File file;
+			file.name = disc_name(programs[c].file.name);
+			file.load_address = programs[c].file.load_address;
+			file.execution_address = programs[c].file.execution_address;
+			if(disc.add(file, program) && !c && options.boot) {
+				throw std::runtime_error("No room for the program that !BOOT runs on the first side");
+			}
+			bytes_in += program.size();
+		} catch(const Tokeniser::Error &error) {
+			std::cout << "ERROR: " << programs[c].input << ": " << error.to_string() << std::endl;
+			++failures;
+		} catch(const std::exception &error) {
+			std::cout << "ERROR: " << programs[c].input << ": " << error.what() << std::endl;
+			++failures;
+		}
+	}
+
+	if(failures) {
+		return failures;
+	}
+	disc.write(output);
+
+	size_t free_sectors = 0;
+	for(size_t side = 0; side < disc.sides(); side++) {
+		free_sectors += disc.free_sectors(side);
+	}
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout <<
+		"Wrote " << programs.size() << " files to " << disc.sides() << (disc.sides() == 1 ? " side" : " sides") <<
+		", leaving " << free_sectors << " sectors free," <<
+		" on " << pool.size() << " threads in " << seconds << "s: " <<
+		double(programs.size()) / seconds << " files/s, " <<
+		double(bytes_in) / (seconds * 1024.0 * 1024.0) << " MB/s of programs" << std::endl;
+
+	return 0;
+}
+
+}
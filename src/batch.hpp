@@ -0,0 +1,142 @@
+#pragma once
+
+#include "dfs.hpp"
+#include "uef.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Batch {
+
+struct Job {
+	std::string input;
+	std::string output;
+};
+
+/// Expands a list of inputs into conversion jobs. Each input may be:
+///
+/// * a BASIC source file;
+/// * a directory, in which case all .bas files directly within it are included, in name order; or
+/// * a manifest, named with a leading @, listing one source file per line optionally followed
+/// by whitespace and an output file name.
+///
+/// Unless a manifest says otherwise, each output is named for its input with a .uef extension,
+/// placed in @c output_directory if one is supplied or alongside the input otherwise.
+///
+/// @throws std::runtime_error if a directory or manifest can't be read.
+std::vector<Job> collect(const std::vector<std::string> &inputs, const std::string &output_directory);
+
+/// Converts every job in @c jobs on a pool of @c threads workers, or one per hardware
+/// thread if @c threads is zero, gzip-compressing the output if @c compress is @c true
+/// and placing blocks according to @c layout. Sources are read as @c dialect.
+/// Failures are reported per job, in job order, and don't prevent the remaining jobs from
+/// completing. Aggregate throughput is reported at the end.
+///
+/// @returns The number of jobs that failed.
+size_t convert(
+	const std::vector<Job> &jobs,
+	size_t threads,
+	bool compress,
+	const TapeLayout &layout = TapeLayout(),
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2);
+
+/// Expands a list of inputs into UEF images to verify. Each input may be an image or a
+/// directory, in which case all .uef files directly within it are included, in name order.
+///
+/// @throws std::runtime_error if a directory can't be read.
+std::vector<std::string> collect_tapes(const std::vector<std::string> &inputs);
+
+/// Verifies every image in @c tapes on a pool of @c threads workers, or one per hardware
+/// thread if @c threads is zero. Each image must parse, all of its block CRCs must be correct,
+/// and every file on it must detokenise to text that tokenises back to the same bytes.
+/// A single image is verified using the whole pool. Failures are reported per image, in order,
+/// and aggregate throughput is reported at the end.
+///
+/// @returns The number of images that failed.
+size_t verify(const std::vector<std::string> &tapes, size_t threads);
+
+/// A program to be packed onto a shared tape.
+struct Program {
+	std::string input;
+	CassetteFile file;
+};
+
+/// Expands a list of inputs into programs to pack. Each input may be:
+///
+/// * a BASIC source file;
+/// * a directory, in which case all .bas files directly within it are included, in name order; or
+/// * a manifest, named with a leading @, listing one source file per line optionally followed
+/// by whitespace and a cassette file name, then a load address and then an execution address,
+/// the addresses in hexadecimal with an optional leading &.
+///
+/// Unless a manifest says otherwise, each file is named for its input, without extension and
+/// cut to ten characters, and has the usual addresses of a BASIC program.
+///
+/// @throws std::runtime_error if a directory or manifest can't be read, or an address can't be parsed.
+std::vector<Program> collect_programs(const std::vector<std::string> &inputs);
+
+/// Records where a packed file lies on its tape.
+struct CatalogueEntry {
+	std::string input;
+	CassetteFile file;
+
+	/// The extent of the file's chunks within the uncompressed image, from the end of the
+	/// previous file's, or of the tape's origin chunk, to the end of its final block. So it
+	/// includes the carrier tone that leads the file.
+	size_t offset = 0;
+	size_t length = 0;
+
+	/// The file's blocks, counted from the first on the tape.
+	size_t first_block = 0;
+	size_t blocks = 0;
+};
+
+/// Tokenises every program in @c programs on a pool of @c threads workers, or one per hardware
+/// thread if @c threads is zero, and writes them in order as the files of a single tape to
+/// @c output, gzip-compressing it if @c compress is @c true and placing blocks according
+/// to @c layout. Sources are read as @c dialect. A catalogue of where each file lies is written as JSON to @c catalogue.
+///
+/// Each program is written as soon as it and all those before it are tokenised. Failures are
+/// reported per program, in order; if there are any then neither tape nor catalogue is written.
+///
+/// @returns The number of programs that failed.
+/// @throws std::runtime_error if the tape or catalogue can't be written.
+size_t pack(
+	const std::vector<Program> &programs,
+	const std::string &output,
+	const std::string &catalogue,
+	size_t threads,
+	bool compress,
+	const TapeLayout &layout = TapeLayout(),
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2);
+
+struct DiscOptions {
+	/// Per side; either 40 or 80.
+	size_t tracks = 80;
+	std::string title;
+
+	/// If @c true then a !BOOT file that CHAINs the first program is added, and the disc set to
+	/// *EXEC it on SHIFT+BREAK.
+	bool boot = false;
+};
+
+/// Tokenises every program in @c programs on a pool of @c threads workers, or one per hardware
+/// thread if @c threads is zero, and writes them all to a single DFS disc image at @c output,
+/// which is double-sided if named with a .dsd extension and single-sided otherwise.
+///
+/// Each file keeps its load and execution addresses; names are cut to seven characters unless
+/// they name a directory, as in "G.INVADE". Files fill the first side before the second.
+/// Failures, including running out of room, are reported per program, in order; if there are
+/// any then no image is written.
+///
+/// @returns The number of programs that failed.
+/// @throws std::runtime_error if the image can't be written or @c options are invalid.
+size_t disc(
+	const std::vector<Program> &programs,
+	const std::string &output,
+	size_t threads,
+	const DiscOptions &options = DiscOptions(),
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2);
+
+}
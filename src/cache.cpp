@@ -0,0 +1,192 @@
+#include "cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+/*
+	The cache file holds, with all integers little endian:
+
+		the signature "bas2uef cache 3\0";
+		uint8_t		the dialect of BASIC that lines were tokenised as;
+		uint32_t	the number of lines;
+		for each line:
+			uint64_t	the hash of its text;
+			uint32_t	the length of its text;
+			uint8_t		the length of its tokenised form;
+			...			its text, then its tokenised form.
+
+	Block CRCs aren't kept: confirming that a block is unchanged costs about as much as
+	calculating its CRC afresh.
+*/
+
+namespace {
+
+constexpr char Signature[] = "bas2uef cache 3";
+
+/// Hashes @c text eight bytes at a time. Hashes are compared only with those produced by the same
+/// build, and are always verified against the text, so portability isn't a concern.
+uint64_t hash(const std::string_view text) {
+	constexpr uint64_t multiplier = 0x9e3779b97f4a7c15;
+	const auto mix = [](uint64_t value) {
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+		return value ^ (value >> 31);
+	};
+
+	uint64_t result = text.size() * multiplier;
+	size_t offset = 0;
+	for(; offset + 8 <= text.size(); offset += 8) {
+		uint64_t word;
+		memcpy(&word, &text[offset], 8);
+		result = (result ^ word) * multiplier;
+		result ^= result >> 32;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, text.data() + offset, text.size() - offset);
+	return mix(result ^ tail);
+}
+
+/// Reads fields sequentially from a byte range, failing if the range is exhausted.
+class Reader {
+public:
+	Reader(const std::string_view source) :
+		cursor_(reinterpret_cast<const uint8_t *>(source.data())), end_(cursor_ + source.size()) {}
+
+	std::span<const uint8_t> bytes(const size_t length) {
+		if(size_t(end_ - cursor_) < length) {
+			throw std::runtime_error("Truncated cache");
+		}
+		const auto result = std::span<const uint8_t>(cursor_, length);
+		cursor_ += length;
+		return result;
+	}
+
+	template <typename IntT>
+	IntT integer() {
+		const auto source = bytes(sizeof(IntT));
+		IntT result = 0;
+		for(size_t c = 0; c < sizeof(IntT); c++) {
+			result |= IntT(source[c]) << (c * 8);
+		}
+		return result;
+	}
+
+private:
+	const uint8_t *cursor_;
+	const uint8_t *const end_;
+};
+
+template <typename IntT>
+void put(std::vector<uint8_t> &destination, const IntT value) {
+	for(size_t c = 0; c < sizeof(IntT); c++) {
+		destination.push_back(uint8_t(value >> (c * 8)));
+	}
+}
+
+}
+
+ConversionCache::ConversionCache(const std::string &file_name, const Tokeniser::Dialect dialect) :
+	file_name_(file_name), dialect_(dialect) {
+	try {
+		load();
+	} catch(const std::exception &) {
+		// Any problem with the existing cache just means starting again.
+		lines_.clear();
+		file_.reset();
+	}
+}
+
+void ConversionCache::load() {
+	file_ = std::make_unique<InputBuffer>(file_name_);
+	Reader reader(file_->view());
+
+	const auto signature = reader.bytes(sizeof(Signature));
+	if(memcmp(signature.data(), Signature, sizeof(Signature))) {
+		throw std::runtime_error("Not a cache");
+	}
+	if(reader.integer<uint8_t>() != uint8_t(dialect_)) {
+		throw std::runtime_error("Cache is of another dialect");
+	}
+
+	auto count = reader.integer<uint32_t>();
+	lines_.reserve(count);
+	for(; count; --count) {
+		const auto key = reader.integer<uint64_t>();
+		const auto text_length = reader.integer<uint32_t>();
+		const auto tokens_length = reader.integer<uint8_t>();
+		const auto text = reader.bytes(text_length);
+		const auto tokens = reader.bytes(tokens_length);
+		lines_.emplace(key, Line{
+			std::string_view(reinterpret_cast<const char *>(text.data()), text.size()),
+			tokens
+		});
+	}
+}
+
+bool ConversionCache::find(const std::string_view line, std::vector<uint8_t> &destination) {
+	++statistics_.lines;
+
+	const auto entry = lines_.find(hash(line));
+	if(entry == lines_.end() || entry->second.text != line) {
+		return false;
+	}
+
+	entry->second.used = true;
+	destination.insert(destination.end(), entry->second.tokens.begin(), entry->second.tokens.end());
+	++statistics_.lines_reused;
+	return true;
+}
+
+void ConversionCache::store(const std::string_view line, const uint8_t *const begin, const uint8_t *const end) {
+	// Lines too long to be valid aren't worth keeping; neither is anything that collides with an
+	// existing entry.
+	if(end - begin > 255) return;
+	const auto key = hash(line);
+	if(lines_.count(key)) return;
+
+	auto &storage = new_lines_.emplace_back(line);
+	storage.append(begin, end);
+	lines_.emplace(key, Line{
+		std::string_view(storage.data(), line.size()),
+		std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(storage.data()) + line.size(), size_t(end - begin)),
+		true
+	});
+}
+
+void ConversionCache::save() {
+	size_t used = 0, size = sizeof(Signature) + 5;
+	for(const auto &entry: lines_) {
+		if(!entry.second.used) continue;
+		++used;
+		size += 13 + entry.second.text.size() + entry.second.tokens.size();
+	}
+
+	std::vector<uint8_t> output;
+	output.reserve(size);
+	output.insert(output.end(), std::begin(Signature), std::end(Signature));
+	put(output, uint8_t(dialect_));
+	put(output, uint32_t(used));
+	for(const auto &[key, line]: lines_) {
+		if(!line.used) continue;
+		put(output, key);
+		put(output, uint32_t(line.text.size()));
+		put(output, uint8_t(line.tokens.size()));
+		output.insert(output.end(), line.text.begin(), line.text.end());
+		output.insert(output.end(), line.tokens.begin(), line.tokens.end());
+	}
+
+	// Write to a temporary file and then rename, so that the cache is never seen half-written.
+	const auto temporary = file_name_ + ".tmp";
+	FILE *const file = fopen(temporary.c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("Unable to write cache: " + file_name_);
+	}
+	const bool written = fwrite(output.data(), 1, output.size(), file) == output.size();
+	if(fclose(file) || !written || rename(temporary.c_str(), file_name_.c_str())) {
+		remove(temporary.c_str());
+		throw std::runtime_error("Unable to write cache: " + file_name_);
+	}
+}
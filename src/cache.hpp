@@ -0,0 +1,61 @@
+#pragma once
+
+#include "input.hpp"
+#include "tokeniser.hpp"
+#include "uef.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// Persists the tokenised form of every line of a program, keyed by a hash of its text, so that
+/// reconverting an edited version of the program tokenises again only those lines that have changed.
+///
+/// Only what is used by a conversion is saved, so the cache follows the program as it evolves
+/// rather than growing without bound.
+class ConversionCache: public Tokeniser::LineCache {
+public:
+	/// Loads the cache stored at @c file_name, if there is one and it is valid for @c dialect;
+	/// otherwise starts empty.
+	explicit ConversionCache(const std::string &file_name, Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2);
+
+	/// Replaces the stored cache with the lines used since construction.
+	///
+	/// @throws std::runtime_error if the cache can't be written.
+	void save();
+
+	bool find(std::string_view line, std::vector<uint8_t> &destination) override;
+	void store(std::string_view line, const uint8_t *begin, const uint8_t *end) override;
+
+	struct Statistics {
+		size_t lines = 0;
+		size_t lines_reused = 0;
+	};
+	const Statistics &statistics() const {
+		return statistics_;
+	}
+
+private:
+	void load();
+
+	std::string file_name_;
+	Tokeniser::Dialect dialect_;
+	Statistics statistics_;
+
+	// The previously-saved cache; loaded lines refer directly into it.
+	std::unique_ptr<InputBuffer> file_;
+
+	struct Line {
+		std::string_view text;
+		std::span<const uint8_t> tokens;
+		bool used = false;
+	};
+	std::unordered_map<uint64_t, Line> lines_;
+	std::deque<std::string> new_lines_;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "CRC.hpp"
+#include "importer.hpp"
+#include "uef.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+	Tokenises programs and builds UEF images of them at compile time, for embedding BASIC
+	within C++ without any runtime cost:
+
+		constexpr auto program = Tokeniser::compile<"10 PRINT \"HELLO\"\n">();
+		constexpr auto tape = compile_uef<"10 PRINT \"HELLO\"\n">();
+
+	Each is a std::array<uint8_t, N> holding exactly what Tokeniser::import or tokenise_to_uef
+	would produce at runtime. A program that can't be tokenised fails to compile, with a
+	diagnostic that names the error via Tokeniser::Private::compile_time_error.
+*/
+
+namespace Tokeniser {
+
+/// Holds a string literal such that it can be passed as a template argument.
+template <size_t N>
+struct Literal {
+	consteval Literal(const char (&source)[N]) {
+		std::copy_n(source, N, text);
+	}
+
+	constexpr std::string_view view() const {
+		return std::string_view(text, N - 1);
+	}
+
+	char text[N]{};
+};
+
+namespace Private {
+
+/// Counts output, so that storage for it can be sized.
+struct CountingSink: public Sink {
+	constexpr ~CountingSink() override {}
+
+	constexpr void append(const uint8_t *const begin, const uint8_t *const end) override {
+		size += size_t(end - begin);
+	}
+	size_t size = 0;
+};
+
+/// Collects output into an array of exactly the right size.
+template <size_t size>
+struct ArraySink: public Sink {
+	constexpr ~ArraySink() override {}
+
+	constexpr void append(const uint8_t *const begin, const uint8_t *const end) override {
+		std::copy(begin, end, result.begin() + ptrdiff_t(length));
+		length += size_t(end - begin);
+	}
+	std::array<uint8_t, size> result{};
+	size_t length = 0;
+};
+
+template <Literal source>
+consteval size_t compiled_size() {
+	CountingSink sink;
+	Importer<Dialects::BASIC2>(source.view(), sink, nullptr).tokenise();
+	return sink.size;
+}
+
+}
+
+/// Tokenises @c source at compile time.
+///
+/// @returns The same bytes as @c import(source).
+template <Literal source>
+consteval auto compile() {
+	Private::ArraySink<Private::compiled_size<source>()> sink;
+	Private::Importer<Dialects::BASIC2>(source.view(), sink, nullptr).tokenise();
+	return sink.result;
+}
+
+}
+
+/// Tokenises @c source and builds a UEF image of it, all at compile time, with the default
+/// @c TapeLayout and @c CassetteFile.
+///
+/// @returns The same bytes as @c tokenise_to_uef(source).
+template <Tokeniser::Literal source>
+consteval auto compile_uef() {
+	constexpr auto program = Tokeniser::compile<source>();
+	const CassetteFile file;
+	constexpr TapeLayout layout;
+
+	// Each block is preceded by a carrier chunk and surrounded by a block chunk header,
+	// a synchronisation byte, the block header and two CRCs.
+	constexpr size_t block_header_length = CassetteFile().name.size() + 1 + 17;
+	constexpr size_t block_overhead = 8 + 6 + 1 + block_header_length + 2 + 2;
+	constexpr size_t blocks = (program.size() + UEFBlockStream::BlockSize - 1) / UEFBlockStream::BlockSize;
+	constexpr uint8_t preamble[] = {
+		'U', 'E', 'F', ' ', 'F', 'i', 'l', 'e', '!', 0x00, 10, 0,
+		0x00, 0x00, 13, 0, 0, 0, 'b', 'a', 's', '2', 'u', 'e', 'f', ' ', 'v', '1', '.', '0', 0x00,
+		0x11, 0x01, 4, 0, 0, 0,
+		uint8_t(layout.leader_cycles >> 0), uint8_t(layout.leader_cycles >> 8),
+		uint8_t(layout.leader_cycles >> 0), uint8_t(layout.leader_cycles >> 8),
+	};
+	std::array<uint8_t, sizeof(preamble) + blocks * block_overhead + program.size()> image{};
+
+	size_t cursor = 0;
+	const auto put = [&](const uint8_t value) {
+		image[cursor++] = value;
+	};
+	for(const auto value: preamble) {
+		put(value);
+	}
+
+	for(size_t offset = 0, block = 0; offset < program.size(); offset += UEFBlockStream::BlockSize, ++block) {
+		const auto length = std::min(UEFBlockStream::BlockSize, program.size() - offset);
+		const bool is_last = offset + length == program.size();
+
+		put(0x10); put(0x01); put(2); put(0); put(0); put(0);
+		put(uint8_t(layout.carrier_cycles >> 0)); put(uint8_t(layout.carrier_cycles >> 8));
+
+		const auto chunk_length = uint32_t(1 + block_header_length + 2 + length + 2);
+		put(0x00); put(0x01);
+		put(uint8_t(chunk_length >> 0)); put(uint8_t(chunk_length >> 8));
+		put(uint8_t(chunk_length >> 16)); put(uint8_t(chunk_length >> 24));
+		put(0x2a);
+
+		const auto header = cursor;
+		for(const auto ch: file.name) put(uint8_t(ch));
+		put(0x00);
+		for(const auto address: {file.load_address, file.execution_address}) {
+			put(uint8_t(address >> 0)); put(uint8_t(address >> 8));
+			put(uint8_t(address >> 16)); put(uint8_t(address >> 24));
+		}
+		put(uint8_t(block >> 0)); put(uint8_t(block >> 8));
+		put(uint8_t(length >> 0)); put(uint8_t(length >> 8));
+		put(is_last ? 0x80 : 0x00);
+		put(0); put(0); put(0); put(0);
+
+		const auto header_crc = CRC::crc16(image.begin() + ptrdiff_t(header), image.begin() + ptrdiff_t(cursor));
+		put(header_crc.high()); put(header_crc.low());
+
+		const auto data = program.begin() + ptrdiff_t(offset);
+		for(size_t c = 0; c < length; c++) {
+			put(data[c]);
+		}
+		const auto data_crc = CRC::crc16(data, data + ptrdiff_t(length));
+		put(data_crc.high()); put(data_crc.low());
+	}
+	return image;
+}
@@ -0,0 +1,133 @@
+#include "counters.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+/*
+	All events are opened as one group, led by the first that opens, so that they're scheduled
+	onto the hardware together and can be read with a single system call. A group read gives,
+	with PERF_FORMAT_GROUP and both time formats:
+
+		uint64_t	the number of events;
+		uint64_t	the time for which the group was enabled;
+		uint64_t	the time for which it was actually counting;
+		uint64_t	each event's value, in the order opened.
+
+	If the kernel had to share the hardware with other groups then the two times differ, and
+	counts are scaled up accordingly.
+*/
+
+namespace Counters {
+
+namespace {
+
+perf_event_attr attributes(const Event event) {
+	perf_event_attr attr{};
+	attr.size = sizeof(attr);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	constexpr auto cache_read_miss = [](const uint64_t cache) {
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	};
+	switch(event) {
+		default:
+		case Cycles:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+		case Instructions:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+		case BranchMisses:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+		case L1DMisses:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = cache_read_miss(PERF_COUNT_HW_CACHE_L1D);
+		break;
+		case LLCMisses:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = cache_read_miss(PERF_COUNT_HW_CACHE_LL);
+		break;
+	}
+	return attr;
+}
+
+}
+
+Group::Group() {
+	descriptors_.fill(-1);
+	positions_.fill(-1);
+
+	int error = 0;
+	for(size_t c = 0; c < EventCount; c++) {
+		auto attr = attributes(Event(c));
+		const auto descriptor = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, PERF_FLAG_FD_CLOEXEC));
+		if(descriptor < 0) {
+			error = errno;
+			continue;
+		}
+
+		descriptors_[c] = descriptor;
+		positions_[c] = int(count_++);
+		if(leader_ < 0) leader_ = descriptor;
+	}
+
+	if(leader_ < 0) {
+		reason_ = std::string("perf_event_open failed: ") + strerror(error);
+		if(error == EACCES || error == EPERM) {
+			reason_ += "; see /proc/sys/kernel/perf_event_paranoid";
+		}
+	}
+}
+
+Group::~Group() {
+	for(const auto descriptor: descriptors_) {
+		if(descriptor >= 0) close(descriptor);
+	}
+}
+
+Group::Reading Group::read() const {
+	Reading reading;
+	if(available()) {
+		uint64_t buffer[3 + EventCount];
+		if(::read(leader_, buffer, sizeof(buffer)) >= ssize_t(sizeof(uint64_t) * (3 + count_))) {
+			reading.enabled = buffer[1];
+			reading.running = buffer[2];
+			for(size_t c = 0; c < EventCount; c++) {
+				if(positions_[c] >= 0) reading.values[c] = buffer[3 + positions_[c]];
+			}
+		}
+	}
+	reading.time = Clock::now();
+	return reading;
+}
+
+Sample Group::since(const Reading &start) const {
+	const auto end = read();
+
+	Sample sample;
+	sample.seconds = std::chrono::duration<double>(end.time - start.time).count();
+
+	// Nothing is known if the group never made it onto the hardware.
+	const auto running = end.running - start.running;
+	if(!running) return sample;
+
+	const auto scale = double(end.enabled - start.enabled) / double(running);
+	for(size_t c = 0; c < EventCount; c++) {
+		if(positions_[c] < 0) continue;
+		sample.counts[c] = double(end.values[c] - start.values[c]) * scale;
+		sample.counted[c] = true;
+	}
+	return sample;
+}
+
+}
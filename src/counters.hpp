@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// Reads hardware performance counters via perf_event_open, for finer profiling than wall time
+/// alone. Only user-space events of the calling thread are counted.
+namespace Counters {
+
+enum Event {
+	Cycles,
+	Instructions,
+	BranchMisses,
+	L1DMisses,
+	LLCMisses,
+
+	EventCount
+};
+
+/// @returns The name of @c event as used in reports.
+constexpr const char *name(const Event event) {
+	switch(event) {
+		default:
+		case Cycles:		return "cycles";
+		case Instructions:	return "instructions";
+		case BranchMisses:	return "branch_misses";
+		case L1DMisses:		return "l1d_misses";
+		case LLCMisses:		return "llc_misses";
+	}
+}
+
+/// The events counted over some interval, along with its length.
+struct Sample {
+	double seconds = 0.0;
+
+	/// Counts, scaled up if the kernel had to multiplex counters; meaningful only for those events
+	/// marked in @c counted.
+	std::array<double, EventCount> counts{};
+	std::array<bool, EventCount> counted{};
+};
+
+/// A group of counters, opened at construction and read thereafter.
+class Group {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// Opens as many of the events as the kernel and hardware allow. If none can be opened then
+	/// the group is unavailable, and measurements give times alone.
+	Group();
+	~Group();
+
+	Group(const Group &) = delete;
+	Group &operator =(const Group &) = delete;
+
+	bool available() const {
+		return leader_ >= 0;
+	}
+
+	/// @returns Why no events could be counted, if @c available() is @c false.
+	const std::string &unavailable_reason() const {
+		return reason_;
+	}
+
+	struct Reading {
+		Clock::time_point time;
+		std::array<uint64_t, EventCount> values{};
+		uint64_t enabled = 0, running = 0;
+	};
+
+	/// @returns The current value of every counter.
+	Reading read() const;
+
+	/// @returns The events counted since @c start was read.
+	Sample since(const Reading &start) const;
+
+	/// @returns The events counted during a call to @c function.
+	template <typename FunctionT>
+	Sample measure(const FunctionT &function) const {
+		const auto start = read();
+		function();
+		return since(start);
+	}
+
+private:
+	int leader_ = -1;
+	std::array<int, EventCount> descriptors_;
+
+	/// The position of each event's value within a group read, or -1 if it isn't counted.
+	std::array<int, EventCount> positions_;
+	size_t count_ = 0;
+	std::string reason_;
+};
+
+}
@@ -0,0 +1,569 @@
+#include "cruncher.hpp"
+#include "keywords.hpp"
+#include "tokeniser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace Cruncher {
+namespace {
+
+using Tokeniser::Flags;
+
+constexpr auto flags = [] {
+	std::array<uint8_t, 256> flags{};
+	for(const auto &[name, keyword]: Tokeniser::keywords) {
+		flags[keyword.token] = keyword.flags;
+	}
+	return flags;
+} ();
+
+/// @returns The token that stands for @c name.
+constexpr uint8_t token(const std::string_view name) {
+	uint8_t result = 0;
+	for(const auto &[keyword_name, keyword]: Tokeniser::keywords) {
+		if(name == keyword_name) result = keyword.token;
+	}
+	return result;
+}
+
+namespace Token {
+	constexpr uint8_t Data = token("DATA");
+	constexpr uint8_t Def = token("DEF");
+	constexpr uint8_t Else = token("ELSE");
+	constexpr uint8_t Erl = token("ERL");
+	constexpr uint8_t Eval = token("EVAL");
+	constexpr uint8_t Gosub = token("GOSUB");
+	constexpr uint8_t Goto = token("GOTO");
+	constexpr uint8_t If = token("IF");
+	constexpr uint8_t On = token("ON");
+	constexpr uint8_t Rem = token("REM");
+	constexpr uint8_t Restore = token("RESTORE");
+	constexpr uint8_t LineNumber = 0x8d;
+}
+
+bool is_digit(const uint8_t ch) {
+	return ch >= '0' && ch <= '9';
+}
+
+bool is_name_character(const uint8_t ch) {
+	return is_digit(ch) || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch == '_' || ch == '`';
+}
+
+/// A lexical element of a tokenised line, classified only as finely as crunching needs.
+struct Piece {
+	enum class Kind {
+		Token,			// A single keyword token.
+		LineNumber,		// An encoded line number, including its $8d prefix.
+		String,			// A string literal, including its quotes.
+		Rest,			// Everything following REM or DATA, or a star command.
+		Name,			// The name following PROC or FN.
+		Identifier,		// A variable name, excluding any type suffix.
+		Number,			// A decimal number or the digits of a hexadecimal one.
+		Space,
+		Other,			// Any other single character.
+	};
+
+	Kind kind;
+	std::string text;
+
+	bool is_token(const uint8_t token) const {
+		return kind == Kind::Token && uint8_t(text[0]) == token;
+	}
+	bool is_other(const char ch) const {
+		return kind == Kind::Other && text[0] == ch;
+	}
+};
+using Kind = Piece::Kind;
+
+struct Line {
+	uint16_t number;
+	std::vector<Piece> pieces;
+
+	std::string body() const {
+		std::string body;
+		for(const auto &piece: pieces) body += piece.text;
+		return body;
+	}
+};
+
+/// Divides a line's body into pieces, keeping the same state as the tokeniser and detokeniser
+/// in order to know which bytes are literal regardless of value.
+std::vector<Piece> lex(const uint8_t *cursor, const uint8_t *const end) {
+	std::vector<Piece> pieces;
+	const auto add = [&](const Kind kind, const uint8_t *const run_end) {
+		pieces.push_back(Piece{kind, std::string(cursor, run_end)});
+		cursor = run_end;
+	};
+	const auto run = [&](const auto &predicate) {
+		auto run_end = cursor;
+		while(run_end != end && predicate(*run_end)) ++run_end;
+		return run_end;
+	};
+
+	bool statement_start = true;
+	while(cursor != end) {
+		const auto ch = *cursor;
+
+		if(ch & 0x80) {
+			add(Kind::Token, cursor + 1);
+			const auto token_flags = flags[ch];
+
+			if(token_flags & Flags::FNProc) {
+				const auto name_end = run([](const uint8_t ch) { return is_name_character(ch) && ch != '`'; });
+				if(name_end != cursor) add(Kind::Name, name_end);
+			}
+
+			if(token_flags & Flags::LineNumber) {
+				while(cursor != end && (*cursor == ' ' || *cursor == '\t')) {
+					add(Kind::Space, cursor + 1);
+				}
+				if(end - cursor >= 4 && *cursor == Token::LineNumber) {
+					add(Kind::LineNumber, cursor + 4);
+				}
+			}
+
+			if(token_flags & Flags::REM && cursor != end) {
+				add(Kind::Rest, end);
+			}
+
+			statement_start &= !(token_flags & Flags::Middle);
+			statement_start |= token_flags & Flags::Start;
+			continue;
+		}
+
+		const bool was_start = statement_start;
+		statement_start = ch == ':';
+		if(ch == '*' && was_start) {
+			add(Kind::Rest, end);
+		} else if(ch == '"') {
+			const auto quote = std::find(cursor + 1, end, '"');
+			add(Kind::String, quote == end ? end : quote + 1);
+		} else if(ch == ' ' || ch == '\t') {
+			add(Kind::Space, cursor + 1);
+		} else if(is_digit(ch)) {
+			add(Kind::Number, run([](const uint8_t ch) { return is_digit(ch) || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z'); }));
+		} else if(is_name_character(ch)) {
+			add(Kind::Identifier, run(is_name_character));
+		} else if(ch == '&') {
+			add(Kind::Other, cursor + 1);
+			const auto digits_end = run([](const uint8_t ch) { return is_digit(ch) || (ch >= 'A' && ch <= 'F'); });
+			if(digits_end != cursor) add(Kind::Number, digits_end);
+		} else {
+			add(Kind::Other, cursor + 1);
+		}
+	}
+	return pieces;
+}
+
+std::vector<Line> parse(const std::vector<uint8_t> &program) {
+	std::vector<Line> lines;
+	auto cursor = program.data();
+	const auto end = program.data() + program.size();
+	while(true) {
+		if(end - cursor < 2 || cursor[0] != 0x0d) throw std::runtime_error("Malformed program");
+		if(cursor[1] == 0xff) break;
+		if(end - cursor < 4 || cursor[3] < 4 || end - cursor < cursor[3]) throw std::runtime_error("Malformed program");
+
+		lines.push_back(Line{uint16_t((cursor[1] << 8) | cursor[2]), lex(cursor + 4, cursor + cursor[3])});
+		cursor += cursor[3];
+	}
+	return lines;
+}
+
+void append_line(std::vector<uint8_t> &program, const uint16_t number, const std::string &body) {
+	program.push_back(0x0d);
+	program.push_back(uint8_t(number >> 8));
+	program.push_back(uint8_t(number));
+	program.push_back(uint8_t(body.size() + 4));
+	program.insert(program.end(), body.begin(), body.end());
+}
+
+/// The longest body that a line may have; the tokeniser reports anything longer as LineTooLong.
+constexpr size_t MaximumBody = 254 - 4;
+
+/// @returns @c true if @c body, as line @c number, detokenises to text that tokenises back to it.
+/// Crunching preserves this so that crunched programs still list faithfully.
+bool lists_faithfully(const uint16_t number, const std::string &body) {
+	if(body.size() > MaximumBody) return false;
+
+	std::vector<uint8_t> program;
+	append_line(program, number, body);
+	program.push_back(0x0d);
+	program.push_back(0xff);
+	try {
+		return Tokeniser::import(Tokeniser::detokenise(program.data(), program.data() + program.size())) == program;
+	} catch(...) {
+		return false;
+	}
+}
+
+/// @returns The index of the nearest piece before @c index that isn't a space, or -1 if there is none.
+ptrdiff_t previous_non_space(const std::vector<Piece> &pieces, ptrdiff_t index) {
+	while(--index >= 0 && pieces[size_t(index)].kind == Kind::Space);
+	return index;
+}
+
+/// @returns The index of the nearest piece after @c index that isn't a space, or the number of pieces if there is none.
+size_t next_non_space(const std::vector<Piece> &pieces, size_t index) {
+	while(++index < pieces.size() && pieces[index].kind == Kind::Space);
+	return index;
+}
+
+/// Describes what a program does that constrains crunching.
+struct Survey {
+	std::set<int> referenced;
+
+	bool computed_jumps = false;
+	bool evaluates_strings = false;
+	bool uses_assembler = false;
+	bool uses_error_line = false;
+};
+
+Survey survey(const std::vector<Line> &lines) {
+	Survey survey;
+	for(const auto &line: lines) {
+		// The tokeniser encodes only the first target of ON ... GOTO, so treat any number in
+		// such a line as a potential target.
+		const bool has_on = std::any_of(line.pieces.begin(), line.pieces.end(), [](const Piece &piece) {
+			return piece.is_token(Token::On);
+		});
+
+		for(size_t c = 0; c < line.pieces.size(); c++) {
+			const auto &piece = line.pieces[c];
+			switch(piece.kind) {
+				default: break;
+
+				case Kind::LineNumber: {
+					const auto b1 = uint8_t(piece.text[1]), b2 = uint8_t(piece.text[2]), b3 = uint8_t(piece.text[3]);
+					const int low = (b2 & 0x3f) | ((b1 << 2) & 0xc0);
+					const int high = (b3 & 0x3f) | ((b1 << 4) & 0xc0);
+					survey.referenced.insert(((high << 8) | low) ^ 0b0100'0000'0100'0000);
+				} break;
+
+				case Kind::Number:
+					if(has_on && piece.text.size() <= 5 && std::all_of(piece.text.begin(), piece.text.end(), is_digit)) {
+						survey.referenced.insert(std::stoi(piece.text));
+					}
+				break;
+
+				case Kind::Other:
+					survey.uses_assembler |= piece.is_other('[');
+				break;
+
+				case Kind::Token:
+					survey.evaluates_strings |= piece.is_token(Token::Eval);
+					survey.uses_error_line |= piece.is_token(Token::Erl);
+
+					// A GOTO, GOSUB or RESTORE is computed unless followed by a line number or nothing at all.
+					if(piece.is_token(Token::Goto) || piece.is_token(Token::Gosub) || piece.is_token(Token::Restore)) {
+						const auto next = next_non_space(line.pieces, c);
+						survey.computed_jumps |=
+							next < line.pieces.size() &&
+							line.pieces[next].kind != Kind::LineNumber &&
+							!line.pieces[next].is_other(':') &&
+							!line.pieces[next].is_token(Token::Else);
+					}
+				break;
+			}
+		}
+	}
+	return survey;
+}
+
+/// Removes REM statements; then removes lines left empty, other than those that might be jumped to.
+void remove_remarks(std::vector<Line> &lines, const Survey &survey, Result &result) {
+	for(auto &line: lines) {
+		for(size_t c = 0; c < line.pieces.size(); c++) {
+			if(!line.pieces[c].is_token(Token::Rem)) continue;
+
+			// Only a REM that begins a statement can go; one following THEN or ELSE is that statement.
+			const auto previous = previous_non_space(line.pieces, ptrdiff_t(c));
+			if(previous >= 0 && !line.pieces[size_t(previous)].is_other(':')) break;
+
+			const auto cut = previous < 0 ? 0 : size_t(previous_non_space(line.pieces, previous) + 1);
+			line.pieces.erase(line.pieces.begin() + ptrdiff_t(cut), line.pieces.end());
+			break;
+		}
+	}
+
+	if(survey.computed_jumps) return;
+	const auto original_size = lines.size();
+	std::erase_if(lines, [&](const Line &line) {
+		return
+			!survey.referenced.count(line.number) &&
+			std::all_of(line.pieces.begin(), line.pieces.end(), [](const Piece &piece) { return piece.kind == Kind::Space; });
+	});
+	result.lines_removed += original_size - lines.size();
+}
+
+/// Gives the most-used names the shortest replacements. Replacements are lower case so that none
+/// can be mistaken for a keyword or become one of the resident integer variables.
+///
+/// @param fixed Names to leave as they are.
+void shorten_names(std::vector<Line> &lines, const std::set<std::string> &fixed, Result &result) {
+	std::unordered_map<std::string, size_t> uses;
+	for(const auto &line: lines) {
+		for(const auto &piece: line.pieces) {
+			if(piece.kind == Kind::Identifier || piece.kind == Kind::Name) {
+				++uses[piece.text];
+			}
+		}
+	}
+
+	std::vector<std::pair<std::string, size_t>> names;
+	std::copy_if(uses.begin(), uses.end(), std::back_inserter(names), [&](const auto &use) {
+		return !fixed.count(use.first);
+	});
+	std::sort(names.begin(), names.end(), [](const auto &lhs, const auto &rhs) {
+		return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first;
+	});
+
+	// Candidates are generated in order of length: a–z, then a–z followed by 0–9 or a–z, and so on.
+	size_t index = 0;
+	std::string candidate;
+	const auto next_candidate = [&] {
+		do {
+			static constexpr std::string_view subsequent = "0123456789abcdefghijklmnopqrstuvwxyz";
+			candidate.clear();
+			size_t remainder = index++;
+			size_t count = 26;
+			while(remainder >= count) {
+				remainder -= count;
+				count *= subsequent.size();
+			}
+			while(count > 26) {
+				count /= subsequent.size();
+				candidate.insert(candidate.begin(), subsequent[remainder % subsequent.size()]);
+				remainder /= subsequent.size();
+			}
+			candidate.insert(candidate.begin(), char('a' + remainder));
+		} while(uses.count(candidate));
+	};
+	next_candidate();
+
+	std::unordered_map<std::string, std::string> replacements;
+	for(const auto &[name, count]: names) {
+		if(candidate.size() >= name.size()) continue;
+		replacements[name] = candidate;
+		next_candidate();
+	}
+
+	for(auto &line: lines) {
+		for(auto &piece: line.pieces) {
+			if(piece.kind != Kind::Identifier && piece.kind != Kind::Name) continue;
+
+			const auto replacement = replacements.find(piece.text);
+			if(replacement != replacements.end()) piece.text = replacement->second;
+		}
+	}
+	result.names_shortened = replacements.size();
+}
+
+/// @returns @c true if a space between @c previous and @c next is needed to keep them apart.
+bool separates(const Piece *const previous, const Piece *const next) {
+	if(!previous || !next) return false;
+
+	const auto ends_name = [](const Piece &piece) {
+		return
+			piece.kind == Kind::Identifier || piece.kind == Kind::Number || piece.kind == Kind::Name ||
+			piece.is_other('%') || piece.is_other('$') || piece.is_other('.');
+	};
+	const auto continues_name = [](const Piece &piece) {
+		return
+			piece.kind == Kind::Identifier || piece.kind == Kind::Number || piece.kind == Kind::Name ||
+			piece.is_other('%') || piece.is_other('$') || piece.is_other('.') || piece.is_other('(');
+	};
+	return ends_name(*previous) && continues_name(*next);
+}
+
+void remove_spaces(std::vector<Line> &lines) {
+	for(auto &line: lines) {
+		auto &pieces = line.pieces;
+
+		// Determine which spaces may go, keeping the first of any run that separates names or numbers.
+		std::vector<size_t> removable;
+		for(size_t c = 0; c < pieces.size(); c++) {
+			if(pieces[c].kind != Kind::Space) continue;
+
+			const auto previous = previous_non_space(pieces, ptrdiff_t(c));
+			const auto next = next_non_space(pieces, c);
+			const bool first_in_run = !c || pieces[c - 1].kind != Kind::Space;
+			if(
+				first_in_run &&
+				separates(previous < 0 ? nullptr : &pieces[size_t(previous)], next < pieces.size() ? &pieces[next] : nullptr)
+			) {
+				continue;
+			}
+			removable.push_back(c);
+		}
+		if(removable.empty()) continue;
+
+		const auto without = [&](const std::vector<size_t> &removed) {
+			std::vector<Piece> result;
+			for(size_t c = 0, r = 0; c < pieces.size(); c++) {
+				if(r < removed.size() && removed[r] == c) {
+					++r;
+					continue;
+				}
+				result.push_back(pieces[c]);
+			}
+			return result;
+		};
+
+		// Remove everything possible unless that affects listing, in which case fall back
+		// to removing one space at a time.
+		auto candidate = Line{line.number, without(removable)};
+		if(!lists_faithfully(line.number, line.body()) || lists_faithfully(line.number, candidate.body())) {
+			pieces = std::move(candidate.pieces);
+			continue;
+		}
+
+		std::vector<size_t> removed;
+		for(const auto index: removable) {
+			removed.push_back(index);
+			if(!lists_faithfully(line.number, Line{line.number, without(removed)}.body())) {
+				removed.pop_back();
+			}
+		}
+		pieces = without(removed);
+	}
+}
+
+/// Appends lines onto their predecessors where nothing can refer to them and doing so can't
+/// change which statements are executed.
+void merge_lines(std::vector<Line> &lines, const Survey &survey, Result &result) {
+	// A line can't be extended if it ends in anything that consumes the rest of the line, or if
+	// it contains anything that conditionally skips the rest of the line, or if it contains a
+	// DEF, which causes the line to be skipped when encountered.
+	const auto extensible = [](const Line &line) {
+		return std::none_of(line.pieces.begin(), line.pieces.end(), [](const Piece &piece) {
+			return
+				piece.kind == Kind::Rest ||
+				piece.is_token(Token::If) || piece.is_token(Token::Else) || piece.is_token(Token::On) ||
+				piece.is_token(Token::Def) || piece.is_token(Token::Rem) || piece.is_token(Token::Data);
+		});
+	};
+
+	// DEF and DATA are found only at the start of a line.
+	const auto appendable = [&](const Line &line) {
+		if(survey.referenced.count(line.number)) return false;
+		const auto first = next_non_space(line.pieces, size_t(-1));
+		return
+			first == line.pieces.size() ||
+			!(line.pieces[first].is_token(Token::Def) || line.pieces[first].is_token(Token::Data) || line.pieces[first].is_token(Token::Else));
+	};
+
+	std::vector<Line> merged;
+	for(auto &line: lines) {
+		if(!merged.empty() && extensible(merged.back()) && appendable(line)) {
+			auto &target = merged.back();
+			const auto first = next_non_space(line.pieces, size_t(-1));
+
+			// A target left empty, such as by the removal of a REM, needs no separator.
+			auto candidate = target;
+			if(first < line.pieces.size()) {
+				if(next_non_space(target.pieces, size_t(-1)) < target.pieces.size()) {
+					candidate.pieces.push_back(Piece{Kind::Other, ":"});
+				}
+				candidate.pieces.insert(candidate.pieces.end(), line.pieces.begin() + ptrdiff_t(first), line.pieces.end());
+			}
+
+			const auto body = candidate.body();
+			if(
+				body.size() <= MaximumBody &&
+				(
+					!lists_faithfully(target.number, target.body()) ||
+					!lists_faithfully(line.number, line.body()) ||
+					lists_faithfully(target.number, body)
+				)
+			) {
+				target = std::move(candidate);
+				++result.lines_merged;
+				continue;
+			}
+		}
+		merged.push_back(std::move(line));
+	}
+	lines = std::move(merged);
+}
+
+}
+
+Result crunch(const std::vector<uint8_t> &program, const Options &options) {
+	Result result;
+	auto lines = parse(program);
+	const auto constraints = survey(lines);
+
+	if(constraints.computed_jumps && (options.remarks || options.merge)) {
+		result.notes.push_back("Lines weren't removed or merged, as the program jumps to computed line numbers");
+	}
+	if(options.remarks) {
+		remove_remarks(lines, constraints, result);
+	}
+
+	if(options.names) {
+		if(constraints.evaluates_strings) {
+			result.notes.push_back("Names weren't shortened, as the program uses EVAL");
+		} else if(constraints.uses_assembler) {
+			result.notes.push_back("Names weren't shortened, as the program contains assembly language");
+		} else {
+			// A new name could join onto an adjacent keyword in a listing, in which case keep the
+			// original names of every line affected and try again.
+			std::vector<bool> faithful;
+			for(const auto &line: lines) faithful.push_back(lists_faithfully(line.number, line.body()));
+
+			std::set<std::string> fixed;
+			while(true) {
+				auto renamed = lines;
+				shorten_names(renamed, fixed, result);
+
+				const auto fixed_count = fixed.size();
+				for(size_t c = 0; c < lines.size(); c++) {
+					if(faithful[c] && !lists_faithfully(renamed[c].number, renamed[c].body())) {
+						for(const auto &piece: lines[c].pieces) {
+							if(piece.kind == Kind::Identifier || piece.kind == Kind::Name) fixed.insert(piece.text);
+						}
+					}
+				}
+				if(fixed.size() == fixed_count) {
+					lines = std::move(renamed);
+					break;
+				}
+			}
+		}
+	}
+
+	if(options.spaces) {
+		if(constraints.uses_assembler) {
+			result.notes.push_back("Spaces weren't removed, as the program contains assembly language");
+		} else {
+			remove_spaces(lines);
+		}
+	}
+
+	if(options.merge && !constraints.computed_jumps) {
+		if(constraints.uses_error_line) {
+			result.notes.push_back("Lines weren't merged, as the program uses ERL");
+		} else if(constraints.uses_assembler) {
+			result.notes.push_back("Lines weren't merged, as the program contains assembly language");
+		} else {
+			merge_lines(lines, constraints, result);
+		}
+	}
+
+	result.program.reserve(program.size());
+	for(const auto &line: lines) {
+		append_line(result.program, line.number, line.body());
+	}
+	result.program.push_back(0x0d);
+	result.program.push_back(0xff);
+	return result;
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+	Shrinks a tokenised program without changing what it does, so that it loads sooner
+	and leaves more memory free.
+
+	Line numbers are never changed, so every line-number reference remains correct; lines
+	are only ever removed or merged into their predecessors when nothing can refer to them.
+	Each transformation is abandoned for the whole program if the program does something that
+	would make it unsafe, such as jumping to a computed line number or evaluating strings.
+*/
+
+namespace Cruncher {
+
+struct Options {
+	/// Removes REM statements, and lines consisting only of them that nothing refers to.
+	bool remarks = true;
+
+	/// Removes spaces that neither separate two names or numbers nor change how the line lists.
+	bool spaces = true;
+
+	/// Renames variables, procedures and functions to the shortest names available, giving the
+	/// shortest to those used most.
+	bool names = true;
+
+	/// Appends lines that nothing refers to onto their predecessors, separated by colons.
+	bool merge = true;
+};
+
+struct Result {
+	std::vector<uint8_t> program;
+
+	size_t lines_removed = 0;
+	size_t lines_merged = 0;
+	size_t names_shortened = 0;
+
+	/// Explanations of any transformations that were skipped as unsafe for this program.
+	std::vector<std::string> notes;
+};
+
+/// Crunches @c program, a tokenised program as produced by @c Tokeniser::import.
+///
+/// @throws std::runtime_error if @c program is malformed.
+Result crunch(const std::vector<uint8_t> &program, const Options &options = Options());
+
+}
@@ -0,0 +1,283 @@
+#include "tokeniser.hpp"
+#include "importer.hpp"
+#include "keywords.hpp"
+#include "scan.hpp"
+#include "trie.hpp"
+
+#include <array>
+#include <stdexcept>
+#include <string_view>
+
+/*
+	Implements the inverse of the tokeniser: expands a tokenised program back into text.
+
+	So that the text tokenises back to the same bytes, each line is walked with the same
+	state the tokeniser keeps, principally to know which bytes lie within string literals,
+	REM and DATA statements or star commands, and are therefore literal regardless of value.
+
+	The one case in which the tokeniser discards input is a conditional keyword followed
+	by an alphanumeric: the keyword's text is kept but the character after it is lost.
+	Any keyword found in literal text where the tokeniser would have looked for one must
+	have resulted from that, so a digit is reinserted after the conditional keyword that
+	begins it, to be lost again.
+*/
+
+namespace Tokeniser {
+namespace {
+
+/// Maps tokens to keywords, with flags, for a dialect.
+struct Names {
+	std::array<std::string_view, 256> names{};
+	std::array<uint8_t, 256> flags{};
+
+	/// The second bytes of two-byte tokens, indexed by prefix less $c6.
+	std::array<std::array<std::string_view, 256>, 3> extended_names{};
+	std::array<std::array<uint8_t, 256>, 3> extended_flags{};
+};
+
+/// Maps each token of @c DialectT to its keyword. Tokens $8f–$93 are the function forms of PTR,
+/// PAGE, TIME, LOMEM and HIMEM; their statement forms follow from the final entries in the keyword list.
+template <typename DialectT>
+constexpr auto names = [] {
+	Names names;
+	for(const auto &[name, keyword]: DialectT::keywords) {
+		if(keyword.extension) {
+			names.extended_names[keyword.token - 0xc6][keyword.extension] = name;
+			names.extended_flags[keyword.token - 0xc6][keyword.extension] = keyword.flags;
+		} else {
+			names.names[keyword.token] = name;
+			names.flags[keyword.token] = keyword.flags;
+		}
+	}
+	if constexpr (DialectT::extended_tokens) {
+		for(int prefix = 0xc6; prefix <= 0xc8; prefix++) {
+			names.names[prefix] = {};
+		}
+	}
+	if constexpr (DialectT::line_start_else != 0) {
+		names.names[DialectT::line_start_else] = names.names[0x8b];
+		names.flags[DialectT::line_start_else] = names.flags[0x8b];
+	}
+	return names;
+} ();
+
+/// @returns The length of the longest conditional keyword that prefixes [@c begin, @c end), or 0 if there is none.
+template <typename DialectT>
+size_t conditional_keyword(const uint8_t *const begin, const uint8_t *const end) {
+	constexpr auto &tokens = Private::tokens<DialectT>;
+	auto node = tokens.Root;
+	size_t length = 0;
+	for(auto cursor = begin; ; ++cursor) {
+		if(tokens.value(node) && tokens.value(node)->flags & Flags::Conditional) {
+			length = size_t(cursor - begin);
+		}
+		if(cursor == end) break;
+
+		node = tokens.find(node, char(*cursor));
+		if(node == tokens.NoState) break;
+	}
+	return length;
+}
+
+/// Stands in for text when only statistics are wanted.
+struct Discard {
+	void reserve(size_t) {}
+	void append(const char *, size_t) {}
+	Discard &operator +=(char) { return *this; }
+	Discard &operator +=(std::string_view) { return *this; }
+};
+
+template <typename TextT, typename DialectT>
+class Exporter {
+public:
+	Exporter(const uint8_t *const begin, const uint8_t *const end) : cursor_(begin), end_(end) {
+		// Keywords are mostly longer than their tokens, so text is usually somewhat longer than the program.
+		text_.reserve(size_t(end - begin) * 3 / 2);
+	}
+
+	/// Walks the entire program, producing its text.
+	TextT detokenise() {
+		while(true) {
+			if(next() != 0x0d) fail("Missing line start");
+			const auto high = next();
+			if(high == 0xff) break;
+
+			const auto low = next();
+			const auto length = next();
+			if(length < 4 || size_t(end_ - cursor_) < size_t(length - 4)) fail("Bad line length");
+
+			text_ += std::to_string((high << 8) | low);
+			detokenise_line(cursor_ + length - 4);
+			text_ += '\n';
+			++statistics_.lines;
+		}
+		return std::move(text_);
+	}
+
+	const Statistics &statistics() const {
+		return statistics_;
+	}
+
+private:
+	void detokenise_line(const uint8_t *const line_end) {
+		bool statement_start = true;
+
+		while(cursor_ != line_end) {
+			const auto ch = *cursor_++;
+
+			// Under BASIC V, OTHERWISE is the one token below $80.
+			if(ch & 0x80 || (DialectT::extended_tokens && ch == 0x7f)) {
+				auto name = names<DialectT>.names[ch];
+				auto flags = names<DialectT>.flags[ch];
+				auto count = &statistics_.tokens[ch];
+				if constexpr (DialectT::extended_tokens) {
+					if(ch >= 0xc6 && ch <= 0xc8) {
+						if(cursor_ == line_end) fail("Truncated token");
+						name = names<DialectT>.extended_names[ch - 0xc6][*cursor_];
+						flags = names<DialectT>.extended_flags[ch - 0xc6][*cursor_];
+						count = &statistics_.extended_tokens[ch - 0xc6][*cursor_];
+						++cursor_;
+					}
+				}
+				if(name.empty()) fail("Unknown token");
+				text_ += name;
+				++*count;
+
+				if(flags & Flags::FNProc) {
+					copy_while([](const uint8_t ch) { return Scan::is<Scan::ProcedureName>(char(ch)); }, line_end);
+				}
+
+				if(flags & Flags::LineNumber) {
+					copy_while([](const uint8_t ch) { return Scan::is<Scan::Space>(char(ch)); }, line_end);
+					if(cursor_ != line_end && *cursor_ == 0x8d) {
+						++cursor_;
+						detokenise_line_number(line_end);
+					}
+				}
+
+				if(flags & Flags::REM) {
+					copy_while([](uint8_t) { return true; }, line_end);
+				}
+
+				statement_start &= !(flags & Flags::Middle);
+				statement_start |= flags & Flags::Start;
+				continue;
+			}
+
+			// Everything else is literal, other than the sole case in which the tokeniser will
+			// have dropped a character; see above.
+			if(const auto length = conditional_keyword<DialectT>(cursor_ - 1, line_end)) {
+				text_.append(reinterpret_cast<const char *>(cursor_ - 1), length);
+				text_ += '0';
+				cursor_ += length - 1;
+				++statistics_.untokenised_conditionals;
+				copy_while([](const uint8_t ch) { return Scan::is<Scan::Alphanumeric>(char(ch)); }, line_end);
+				continue;
+			}
+
+			text_ += char(ch);
+			const bool was_start = statement_start;
+			statement_start = ch == ':';
+			switch(ch) {
+				case '*':
+					if(was_start) {
+						copy_while([](uint8_t) { return true; }, line_end);
+					}
+				break;
+
+				case '"':
+					copy_while([](const uint8_t ch) { return ch != '"'; }, line_end);
+					if(cursor_ != line_end) {
+						text_ += char(*cursor_++);
+					}
+				break;
+
+				case '&':
+					copy_while([](const uint8_t ch) { return Scan::is<Scan::HexDigit>(char(ch)); }, line_end);
+				break;
+
+				default:
+					if(Scan::is<Scan::Alphanumeric>(char(ch))) {
+						copy_while([](const uint8_t ch) { return Scan::is<Scan::Alphanumeric>(char(ch)); }, line_end);
+					}
+				break;
+			}
+		}
+	}
+
+	void detokenise_line_number(const uint8_t *const line_end) {
+		if(line_end - cursor_ < 3) fail("Truncated line number");
+		const auto b1 = cursor_[0], b2 = cursor_[1], b3 = cursor_[2];
+		cursor_ += 3;
+
+		const int low = (b2 & 0x3f) | ((b1 << 2) & 0xc0);
+		const int high = (b3 & 0x3f) | ((b1 << 4) & 0xc0);
+		text_ += std::to_string(((high << 8) | low) ^ 0b0100'0000'0100'0000);
+	}
+
+	template <typename PredicateT>
+	void copy_while(const PredicateT &predicate, const uint8_t *const line_end) {
+		while(cursor_ != line_end && predicate(*cursor_)) {
+			text_ += char(*cursor_++);
+		}
+	}
+
+	uint8_t next() {
+		if(cursor_ == end_) fail("Missing program terminator");
+		return *cursor_++;
+	}
+
+	[[noreturn]] void fail(const char *const reason) const {
+		throw std::runtime_error(reason);
+	}
+
+	const uint8_t *cursor_;
+	const uint8_t *const end_;
+	TextT text_;
+	Statistics statistics_;
+};
+
+}
+
+std::string detokenise(const uint8_t *const begin, const uint8_t *const end, const Dialect dialect) {
+	switch(dialect) {
+		default:
+		case Dialect::BASIC2:	return Exporter<std::string, Dialects::BASIC2>(begin, end).detokenise();
+		case Dialect::BASIC4:	return Exporter<std::string, Dialects::BASIC4>(begin, end).detokenise();
+		case Dialect::BASIC5:	return Exporter<std::string, Dialects::BASIC5>(begin, end).detokenise();
+	}
+}
+
+Statistics analyse(const uint8_t *const begin, const uint8_t *const end, const Dialect dialect) {
+	const auto analyse = [&](auto exporter) {
+		exporter.detokenise();
+		return exporter.statistics();
+	};
+	switch(dialect) {
+		default:
+		case Dialect::BASIC2:	return analyse(Exporter<Discard, Dialects::BASIC2>(begin, end));
+		case Dialect::BASIC4:	return analyse(Exporter<Discard, Dialects::BASIC4>(begin, end));
+		case Dialect::BASIC5:	return analyse(Exporter<Discard, Dialects::BASIC5>(begin, end));
+	}
+}
+
+std::string_view keyword(const uint8_t token, const Dialect dialect) {
+	switch(dialect) {
+		default:
+		case Dialect::BASIC2:	return names<Dialects::BASIC2>.names[token];
+		case Dialect::BASIC4:	return names<Dialects::BASIC4>.names[token];
+		case Dialect::BASIC5:	return names<Dialects::BASIC5>.names[token];
+	}
+}
+
+std::string_view keyword(const uint8_t prefix, const uint8_t extension, const Dialect dialect) {
+	if(prefix < 0xc6 || prefix > 0xc8) return {};
+	switch(dialect) {
+		default:
+		case Dialect::BASIC2:	return names<Dialects::BASIC2>.extended_names[prefix - 0xc6][extension];
+		case Dialect::BASIC4:	return names<Dialects::BASIC4>.extended_names[prefix - 0xc6][extension];
+		case Dialect::BASIC5:	return names<Dialects::BASIC5>.extended_names[prefix - 0xc6][extension];
+	}
+}
+
+}
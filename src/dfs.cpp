@@ -0,0 +1,200 @@
+#include "dfs.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+/*
+	Each side of a disc begins with a catalogue of two sectors:
+
+		sector 0:	the first eight characters of the title;
+					for each file, eight bytes: its name padded with spaces to seven characters,
+					then its directory with bit 7 set if the file is locked.
+		sector 1:	the last four characters of the title;
+					uint8_t		the number of times the catalogue has been written, in BCD;
+					uint8_t		eight times the number of files;
+					uint8_t		the boot option in bits 4–5, and bits 8–9 of the number of sectors
+								on the side in bits 0–1;
+					uint8_t		bits 0–7 of the number of sectors on the side;
+					for each file, eight bytes: the low sixteen bits of its load address, of its
+					execution address and of its length, all little endian; a byte holding bits
+					16–17 of the execution address in bits 6–7, of the length in bits 4–5, of the
+					load address in bits 2–3 and of the start sector in bits 0–1; then bits 0–7 of
+					its start sector.
+
+	Files are listed in decreasing order of start sector. A double-sided image interleaves its
+	sides a track at a time, starting with track 0 of side 0.
+*/
+
+namespace DFS {
+
+namespace {
+
+bool is_valid(const char c) {
+	return c > ' ' && c < 0x7f && !strchr(".:\"#*", c);
+}
+
+/// @returns @c name as stored in a catalogue: seven characters padded with spaces, then the directory.
+/// @throws std::runtime_error if @c name is invalid.
+std::array<char, 8> catalogue_name(const std::string &name) {
+	std::string_view file = name;
+	char directory = '$';
+	if(file.size() > 2 && file[1] == '.') {
+		directory = file[0];
+		file.remove_prefix(2);
+	}
+	if(file.empty() || file.size() > 7 || !is_valid(directory) || !std::all_of(file.begin(), file.end(), is_valid)) {
+		throw std::runtime_error("Invalid DFS file name: " + name);
+	}
+
+	std::array<char, 8> result;
+	std::fill(result.begin(), result.end(), ' ');
+	std::copy(file.begin(), file.end(), result.begin());
+	result[7] = directory;
+	return result;
+}
+
+}
+
+Format format_for(const std::string &file_name) {
+	auto extension = std::filesystem::path(file_name).extension().string();
+	for(auto &ch: extension) ch = char(tolower(ch));
+	return extension == ".dsd" ? Format::DSD : Format::SSD;
+}
+
+std::vector<uint8_t> boot_file(const std::string_view name) {
+	std::vector<uint8_t> text;
+	const auto append = [&](const std::string_view string) {
+		text.insert(text.end(), string.begin(), string.end());
+	};
+	append("CHAIN \"");
+	append(name);
+	append("\"\r");
+	return text;
+}
+
+Disc::Disc(const Format format, const size_t tracks, const std::string_view title) :
+	sides_(format == Format::DSD ? 2 : 1), sectors_per_side_(tracks * SectorsPerTrack) {
+	if(tracks != 40 && tracks != 80) {
+		throw std::runtime_error("Discs have either 40 or 80 tracks");
+	}
+	if(title.size() > 12) {
+		throw std::runtime_error("Disc titles are at most twelve characters");
+	}
+
+	// Unused parts of the title, and everything else, are zero.
+	image_.resize(sides_ * sectors_per_side_ * SectorSize);
+	for(size_t side = 0; side < sides_; side++) {
+		auto *const names = sector(side, 0);
+		auto *const details = sector(side, 1);
+		for(size_t c = 0; c < title.size(); c++) {
+			(c < 8 ? names[c] : details[c - 8]) = uint8_t(title[c]);
+		}
+		details[6] = uint8_t(sectors_per_side_ >> 8);
+		details[7] = uint8_t(sectors_per_side_);
+	}
+}
+
+uint8_t *Disc::sector(const size_t side, const size_t sector) {
+	const auto track = sector / SectorsPerTrack;
+	return image_.data() + ((track * sides_ + side) * SectorsPerTrack + sector % SectorsPerTrack) * SectorSize;
+}
+
+const uint8_t *Disc::sector(const size_t side, const size_t sector) const {
+	return const_cast<Disc *>(this)->sector(side, sector);
+}
+
+size_t Disc::files(const size_t side) const {
+	return sector(side, 1)[5] >> 3;
+}
+
+bool Disc::contains(const size_t side, const std::string_view name) const {
+	const auto *const names = sector(side, 0) + 8;
+	for(size_t file = 0; file < files(side); file++) {
+		const auto *const entry = names + file * 8;
+		bool matches = true;
+		for(size_t c = 0; c < 8; c++) {
+			matches &= toupper(entry[c] & 0x7f) == toupper(name[c]);
+		}
+		if(matches) return true;
+	}
+	return false;
+}
+
+int Disc::add(const File &file, const std::span<const uint8_t> data) {
+	const auto name = catalogue_name(file.name);
+	const auto sectors = (data.size() + SectorSize - 1) / SectorSize;
+
+	size_t side = 0;
+	while(side < sides_ && (files(side) == CatalogueSize || next_sector_[side] + sectors > sectors_per_side_)) {
+		++side;
+	}
+	if(side == sides_) {
+		throw std::runtime_error("No room on disc for " + file.name);
+	}
+	if(contains(side, std::string_view(name.data(), name.size()))) {
+		throw std::runtime_error("Duplicate DFS file name: " + file.name);
+	}
+
+	// Copy a sector at a time, as consecutive sectors needn't be adjacent in the image.
+	const auto start = next_sector_[side];
+	for(size_t offset = 0; offset < data.size(); offset += SectorSize) {
+		memcpy(sector(side, start + offset / SectorSize), data.data() + offset, std::min(SectorSize, data.size() - offset));
+	}
+	next_sector_[side] += sectors;
+
+	// The new file has the highest start sector so far, so goes at the head of the catalogue.
+	auto *const names = sector(side, 0) + 8;
+	auto *const details = sector(side, 1) + 8;
+	const auto count = files(side);
+	memmove(names + 8, names, count * 8);
+	memmove(details + 8, details, count * 8);
+
+	memcpy(names, name.data(), name.size());
+	if(file.locked) names[7] |= 0x80;
+
+	const auto length = uint32_t(data.size());
+	details[0] = uint8_t(file.load_address);
+	details[1] = uint8_t(file.load_address >> 8);
+	details[2] = uint8_t(file.execution_address);
+	details[3] = uint8_t(file.execution_address >> 8);
+	details[4] = uint8_t(length);
+	details[5] = uint8_t(length >> 8);
+	details[6] = uint8_t(
+		(((file.execution_address >> 16) & 3) << 6) |
+		(((length >> 16) & 3) << 4) |
+		(((file.load_address >> 16) & 3) << 2) |
+		((start >> 8) & 3)
+	);
+	details[7] = uint8_t(start);
+	sector(side, 1)[5] = uint8_t((count + 1) * 8);
+
+	return int(side * 2);
+}
+
+void Disc::set_boot_option(const BootOption option) {
+	auto &flags = sector(0, 1)[6];
+	flags = uint8_t((flags & ~0x30) | (uint8_t(option) << 4));
+}
+
+size_t Disc::free_sectors(const size_t side) const {
+	return sectors_per_side_ - next_sector_[side];
+}
+
+void Disc::write(const std::string &file_name) const {
+	FILE *const file = fopen(file_name.c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("Unable to open for output: " + file_name);
+	}
+	const bool written = fwrite(image_.data(), 1, image_.size(), file) == image_.size();
+	if(fclose(file) || !written) {
+		remove(file_name.c_str());
+		throw std::runtime_error("Unable to write output: " + file_name);
+	}
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Builds Acorn DFS disc images: .ssd files of a single side, and .dsd files of two sides with
+/// their tracks interleaved.
+namespace DFS {
+
+enum class Format {
+	SSD,
+	DSD,
+};
+
+/// @returns @c Format::DSD if @c file_name has a .dsd extension; @c Format::SSD otherwise.
+Format format_for(const std::string &file_name);
+
+/// The action taken on SHIFT+BREAK, as set by *OPT 4.
+enum class BootOption: uint8_t {
+	None = 0,
+	Load = 1,
+	Run = 2,
+	Exec = 3,
+};
+
+struct File {
+	/// Between one and seven characters, optionally preceded by a directory and a dot as
+	/// in "G.INVADE"; files without a directory are placed in $.
+	std::string name;
+
+	/// The defaults are those given by SAVE in BASIC, as for tape.
+	uint32_t load_address = 0x1900;
+	uint32_t execution_address = 0x8023;
+	bool locked = false;
+};
+
+/// @returns The text of a !BOOT file that, run via *EXEC, CHAINs @c name.
+std::vector<uint8_t> boot_file(std::string_view name);
+
+/// A disc image, allocated in full at construction and filled in place as files are added;
+/// each side's catalogue is kept current throughout, so the image is complete at all times.
+class Disc {
+public:
+	static constexpr size_t SectorSize = 256;
+	static constexpr size_t SectorsPerTrack = 10;
+
+	/// The most files that one side's catalogue can hold.
+	static constexpr size_t CatalogueSize = 31;
+
+	/// @param tracks The number of tracks per side: 40 or 80.
+	/// @param title Up to twelve characters, given to every side.
+	/// @throws std::runtime_error if @c tracks or @c title is invalid.
+	Disc(Format format, size_t tracks = 80, std::string_view title = "");
+
+	/// Adds @c file with contents @c data to the first side with room for it in both its catalogue
+	/// and its sectors, following the files already there.
+	///
+	/// @returns The drive number that the file can be loaded from: 0 for the first side, 2 for the second.
+	/// @throws std::runtime_error if the name is invalid or already in use on the side that the
+	/// file would go to, or if the disc has no room for the file.
+	int add(const File &file, std::span<const uint8_t> data);
+
+	/// Sets the boot option of the first side.
+	void set_boot_option(BootOption option);
+
+	/// @returns The number of sectors on side @c side, of those available to files, that are unused.
+	size_t free_sectors(size_t side) const;
+
+	size_t sides() const {
+		return sides_;
+	}
+
+	const std::vector<uint8_t> &image() const {
+		return image_;
+	}
+
+	/// Writes the image to @c file_name.
+	///
+	/// @throws std::runtime_error if the file can't be written, in which case none is left behind.
+	void write(const std::string &file_name) const;
+
+private:
+	/// @returns The start of logical sector @c sector of side @c side.
+	uint8_t *sector(size_t side, size_t sector);
+	const uint8_t *sector(size_t side, size_t sector) const;
+
+	/// @returns The number of files in the catalogue of side @c side.
+	size_t files(size_t side) const;
+
+	/// @returns @c true if the catalogue of side @c side holds a file named @c name, given as
+	/// stored there: seven characters padded with spaces, then the directory.
+	bool contains(size_t side, std::string_view name) const;
+
+	size_t sides_;
+	size_t sectors_per_side_;
+	std::vector<uint8_t> image_;
+
+	/// The first unused sector of each side; files are allocated upwards from just above the catalogue.
+	size_t next_sector_[2] = {2, 2};
+};
+
+}
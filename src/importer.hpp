@@ -0,0 +1,458 @@
+#pragma once
+
+#include "keywords.hpp"
+#include "scan.hpp"
+#include "tokeniser.hpp"
+#include "trie.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/*
+	Implements parsing of BBC BASIC v2, and of BASIC IV and V by way of their keyword lists.
+
+	Heavily based on the descriptions provided by Mark Plumbley in
+	BASIC ROM User Guide, ISBN 0 947929 04 5, section 2.3.
+
+	The importer is specialised per dialect, each with its own keyword automaton, so that
+	nothing in the per-character loop depends on which dialect is in use.
+
+	Everything here may also be evaluated at compile time, as by Tokeniser::compile.
+*/
+
+namespace Tokeniser {
+namespace Private {
+
+template <typename DialectT>
+inline constexpr Trie<Keyword, trie_shape(DialectT::keywords)> tokens(DialectT::keywords);
+
+/// Is called, at compile time only, in place of throwing an error of type @c type; not being
+/// constexpr, it ends compilation with a diagnostic that names @c type.
+template <Error::Type type>
+void compile_time_error() {}
+
+/// @c DialectT one of the descriptions in @c Tokeniser::Dialects.
+template <typename DialectT>
+struct Importer {
+	/// @param terminate If @c true then the program terminator is appended after the final line.
+	/// @param errors If supplied, errors are recorded here rather than thrown, and tokenisation
+	/// resumes at the following line; lines with errors are omitted from the output.
+	constexpr Importer(
+		const std::string_view input,
+		Sink &sink,
+		LineCache *const cache,
+		const bool terminate = true,
+		std::vector<Error> *const errors = nullptr
+	) :
+		cursor_(input.data()), end_(input.data() + input.size()), sink_(sink), cache_(cache), terminate_(terminate), errors_(errors) {
+		// Any valid line fits in this buffer, which is reused for every line, so tokenisation
+		// allocates nothing further unless on the way to a LineTooLong error.
+		result.reserve(256);
+	}
+
+	constexpr void tokenise() {
+		// Outer loop for tokenising one line at a time.
+		if(errors_) {
+			while(!end_of_file_) {
+				const auto line_start = position();
+				try {
+					if(!tokenise_next_line()) break;
+				} catch(const Error &error) {
+					errors_->push_back(error);
+					resynchronise(line_start);
+				}
+			}
+		} else {
+			while(!end_of_file_ && tokenise_next_line());
+		}
+
+		// Store program terminator.
+		if(terminate_) {
+			constexpr uint8_t terminator[] = {0x0d, 0xff};
+			sink_.append(std::begin(terminator), std::end(terminator));
+		}
+	}
+
+private:
+	/// Tokenises a single line and passes it to the sink.
+	///
+	/// @returns @c false if the input ended before a line began; @c true otherwise.
+	constexpr bool tokenise_next_line() {
+		// Get line number.
+		const auto line_number = read_line_number(false);
+		if(line_number < 0) return false;
+
+		// Write start of line, including line number.
+		result.assign({
+			0x0d,
+			uint8_t(line_number >> 8),
+			uint8_t(line_number >> 0)
+		});
+
+		// Reserve a spot for line length.
+		const auto size_position = result.size();
+		result.push_back(0);
+
+		// Encode line.
+		if(cache_) {
+			tokenise_cached_line();
+		} else {
+			tokenise_line();
+		}
+
+		// Set line length.
+		const auto line_length = 3 + result.size() - size_position;
+		if(line_length >= 255) throw_error(Error::Type::LineTooLong);
+		result[size_position] = uint8_t(line_length);
+
+		// Pass the completed line onward.
+		sink_.append(result.data(), result.data() + result.size());
+		return true;
+	}
+
+	constexpr void tokenise_line() {
+		constexpr auto &tokens = Private::tokens<DialectT>;
+		bool statement_start = true;
+
+		while(!end_of_file_) {
+			// Check for a new token. Keep track of where it started, in case a conditional
+			// token is found and isn't ultimately tokenised.
+			const auto token_start = position();
+			auto node = tokens.Root;
+
+			auto last_found = tokens.NoState;
+			auto last_found_position = token_start;
+			while(true) {
+				// Keep track of last node that represented a complete token.
+				if(tokens.value(node)) {
+					last_found = node;
+					last_found_position = position();
+				}
+
+				const auto ch = next();
+
+				// Search should find the longest token that matches
+				// so don't stop until a dead-end is found.
+				const auto next_node = tokens.find(node, ch);
+				if(next_node == tokens.NoState) {
+					// Retreat to the last observed match, if any.
+					node = last_found;
+					rewind(last_found_position);
+					break;
+				}
+
+				// Keep searching.
+				node = next_node;
+			}
+
+			// If a token was found and is conditional, check whether to tokenise.
+			if(node != tokens.NoState && tokens.value(node)->flags & Flags::Conditional) {
+				const auto token_end = position();
+				const auto ch = next();
+				if(Scan::is<Scan::Alphanumeric>(ch)) {
+					// Don't treat as a token then. Recover the text of this token and then copy in
+					// as many alphanumerics as follow.
+					std::copy_if(token_start.cursor, token_end.cursor, std::back_inserter(result), [](const char c) {
+						return c != '\r';
+					});
+					copy_while<Scan::Alphanumeric>();
+					continue;
+				}
+				rewind(token_end);
+			}
+
+			if(node != tokens.NoState) {
+				const auto &keyword = *tokens.value(node);
+				result.push_back(keyword.token);
+				if constexpr (DialectT::extended_tokens) {
+					if(keyword.extension) {
+						result.push_back(keyword.extension);
+					}
+				}
+				if constexpr (DialectT::line_start_else != 0) {
+					// Only spaces can precede an ELSE that begins the line; the token and line header
+					// account for the rest.
+					if(keyword.token == 0x8b && std::all_of(result.begin() + 4, result.end() - 1, [](const uint8_t ch) { return ch == ' '; })) {
+						result.back() = DialectT::line_start_else;
+					}
+				}
+
+				if(keyword.flags & Flags::FNProc) {
+					// Copy all alphanumerics (and underscores?)
+					copy_while<Scan::ProcedureName>();
+				}
+
+				if(keyword.flags & Flags::LineNumber) {
+					// Means only that a line number *might* be next.
+					copy_while<Scan::Space>();
+					if(Scan::is<Scan::Digit>(peek())) {
+						tokenise_line_number();
+					}
+				}
+
+				if(keyword.flags & Flags::REM) {
+					// Copy rest of line without tokenisation.
+					copy_while<Scan::Any>();
+				}
+
+				if(statement_start && (keyword.flags & Flags::PseudoVariable)) {
+					// Adjust token; if it was at the start and is a pseudo-variable then it should
+					// be encoded as its function not its statement. Which is achieved by adding $40.
+					result.back() += 0x40;
+				}
+
+				statement_start &= !(keyword.flags & Flags::Middle);
+				statement_start |= keyword.flags & Flags::Start;
+				continue;
+			}
+
+			// If here: no token was found. So copy at least one character
+			// from the input and possibly more.
+			const auto ch = next();
+			if(ch == '\n') return;
+			result.push_back(ch);
+
+			// Treat any non-token as ending start-of-statement mode.
+			// E.g. this avoids the risk of `LET A = 10 * PI:PRINT` still thinking it's
+			// in start-of-statement mode when it reaches the asterisk and then copying
+			// the rest of the line verbatim rather than tokenising PI and PRINT.
+			const bool was_start = statement_start;
+			statement_start = false;
+			switch(ch) {
+				case ':':
+					// Go back into start mode after each colon.
+					statement_start = true;
+				break;
+
+				case '*':
+					// If a * is encountered while in start mode, blindly copy from it to
+					// the end of the line.
+					if(was_start) {
+						copy_while<Scan::Any>();
+					}
+				break;
+
+				case '"':
+					// Copy an entire string.
+					if(copy_while<Scan::NotQuote>() != ExitReason::Predicate) {
+						throw_error(Error::Type::BadStringLiteral);
+					}
+					// Copy the closing quotation mark.
+					result.push_back(next());
+				break;
+
+				case '&':
+					// Copy an entire hex number.
+					copy_while<Scan::HexDigit>();
+				break;
+
+				default:
+					// If this is a variable name or number, copy it all.
+					if(Scan::is<Scan::Alphanumeric>(ch)) {
+						copy_while<Scan::Alphanumeric>();
+					}
+				break;
+			}
+		}
+	}
+
+	constexpr void tokenise_cached_line() {
+		// A final line without a newline can tokenise differently from the same text with one,
+		// so isn't cached.
+		const auto newline = find_newline(cursor_);
+		if(!newline) {
+			tokenise_line();
+			return;
+		}
+
+		// Skip the line if its tokenised form is already known, leaving the cursor exactly
+		// as tokenise_line would.
+		const std::string_view line(cursor_, size_t(newline - cursor_));
+		const auto start = result.size();
+		if(cache_->find(line, result)) {
+			cursor_ = newline + 1;
+			++source_line_;
+			return;
+		}
+
+		tokenise_line();
+		cache_->store(line, result.data() + start, result.data() + result.size());
+	}
+
+	constexpr int read_line_number(const bool retain_whitespace) {
+		// Consume whitespace, possibly copying it.
+		if(retain_whitespace) {
+			copy_while<Scan::Space>();
+		} else {
+			consume<Scan::Space>([](char) {});
+		}
+
+		// Allow an empty final line.
+		if(end_of_file_ && !retain_whitespace) {
+			return -1;
+		}
+
+		// Perform validity check.
+		const auto start = position();
+		const auto ch = next();
+		if(!Scan::is<Scan::Digit>(ch)) {
+			throw_error(Error::Type::BadLineNumber);
+		}
+		rewind(start);
+
+		// Obtain line number, but throw it goes out of bounds.
+		int line_number = 0;
+		consume<Scan::Digit>([&](const char num) {
+			line_number = (line_number * 10) + (num - '0');
+			if(line_number > 32767) {
+				throw_error(Error::Type::BadLineNumber);
+			}
+		});
+		return line_number;
+	}
+
+	constexpr void tokenise_line_number() {
+		// $8d is the token for a line number; the three subsequent bytes all have
+		// 01 as their top two bits and some other portion of the original bits beneath.
+		// Bit 6 of both bytes of the target line number is inverted.
+
+		const int number = read_line_number(true) ^ 0b0100'0000'0100'0000;
+		const auto high = uint8_t(number >> 8);
+		const auto low = uint8_t(number);
+
+		result.push_back(0x8d);
+		result.push_back(0b0100'0000 | ((low & 0b1100'0000) >> 2) | ((high & 0b1100'0000) >> 4));
+		result.push_back(0b0100'0000 | (low & 0b0011'1111));
+		result.push_back(0b0100'0000 | (high & 0b0011'1111));
+	}
+
+	/// Describes a point in the input to which it is possible to rewind.
+	struct Position {
+		const char *cursor;
+		int source_line;
+	};
+
+	constexpr Position position() const {
+		return Position{cursor_, source_line_};
+	}
+
+	constexpr void rewind(const Position position) {
+		cursor_ = position.cursor;
+		source_line_ = position.source_line;
+	}
+
+	/// Skips to the start of the line after the one that began at @c line_start. Every error
+	/// is detected no later than the end of its line, so nothing beyond that has yet been read.
+	constexpr void resynchronise(const Position line_start) {
+		const auto newline = find_newline(line_start.cursor);
+		if(!newline) {
+			cursor_ = end_;
+			end_of_file_ = true;
+			return;
+		}
+		cursor_ = newline + 1;
+		source_line_ = line_start.source_line + 1;
+	}
+
+	/// @returns The next character without consuming it, ignoring \r; 0 if the end of the input has been reached.
+	constexpr char peek() {
+		while(cursor_ != end_ && *cursor_ == '\r') ++cursor_;
+		if(cursor_ == end_) {
+			end_of_file_ = true;
+			return 0;
+		}
+		return *cursor_;
+	}
+
+	constexpr char next() {
+		// Consume a character, keeping track of the current line.
+		const auto next = peek();
+		if(cursor_ != end_) {
+			++cursor_;
+			source_line_ += next == '\n';
+		}
+		return next;
+	}
+
+	/// @returns The first newline at or after @c begin, or @c nullptr if there is none.
+	constexpr const char *find_newline(const char *const begin) const {
+		if(std::is_constant_evaluated()) {
+			const auto newline = std::find(begin, end_, '\n');
+			return newline == end_ ? nullptr : newline;
+		}
+		return static_cast<const char *>(memchr(begin, '\n', size_t(end_ - begin)));
+	}
+
+	constexpr void throw_error(const Error::Type type) const {
+		// Exceptions can't be thrown during constant evaluation; name the error instead.
+		if(std::is_constant_evaluated()) {
+			switch(type) {
+				case Error::Type::NoLineNumber:		compile_time_error<Error::Type::NoLineNumber>();		break;
+				case Error::Type::BadLineNumber:	compile_time_error<Error::Type::BadLineNumber>();		break;
+				case Error::Type::LineTooLong:		compile_time_error<Error::Type::LineTooLong>();			break;
+				case Error::Type::BadStringLiteral:	compile_time_error<Error::Type::BadStringLiteral>();	break;
+			}
+			return;
+		}
+		throw Error{type, source_line_};
+	}
+
+	enum class ExitReason {
+		EndOfLine,
+		EndOfFile,
+		Predicate,
+	};
+	template <Scan::Class cls, typename ConsumerT>
+	constexpr ExitReason consume(const ConsumerT &consumer) {
+		while(true) {
+			const auto start = position();
+			char ch = next();
+			if(end_of_file_) return ExitReason::EndOfFile;
+			if(ch == '\n') {
+				rewind(start);
+				return ExitReason::EndOfLine;
+			}
+			if(!Scan::is<cls>(ch)) {
+				rewind(start);
+				return ExitReason::Predicate;
+			}
+			consumer(ch);
+		}
+	}
+
+	template <Scan::Class cls>
+	constexpr ExitReason copy_while() {
+		return consume<cls>([&](const char ch) {
+			result.push_back(ch);
+
+			// Copy in bulk whatever run of the same class directly follows. Any \r ends the
+			// run, to be skipped as usual by next().
+			if(!end_of_file_) {
+				const auto run_end = Scan::run_end<cls>(cursor_, end_);
+				result.insert(result.end(), cursor_, run_end);
+				cursor_ = run_end;
+			}
+		});
+	}
+
+	// The line currently being tokenised.
+	std::vector<uint8_t> result;
+	const char *cursor_;
+	const char *const end_;
+	int source_line_ = 1;
+
+	// Set upon the first attempt to read beyond the end of input; rewinding doesn't reset it.
+	bool end_of_file_ = false;
+
+	Sink &sink_;
+	LineCache *const cache_;
+	const bool terminate_;
+	std::vector<Error> *const errors_;
+};
+
+}
+}
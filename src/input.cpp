@@ -0,0 +1,75 @@
+#include "input.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t BlockSize = 1024 * 1024;
+
+}
+
+InputBuffer::InputBuffer(const std::string &path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		throw std::runtime_error(std::string("Couldn't open ") + path);
+	}
+
+	// Map regular files directly; mmap rejects zero-length mappings so empty files are
+	// just left empty.
+	struct stat status;
+	if(!fstat(fd, &status) && S_ISREG(status.st_mode)) {
+		if(status.st_size) {
+			void *const mapping = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapping != MAP_FAILED) {
+				madvise(mapping, size_t(status.st_size), MADV_SEQUENTIAL);
+				mapping_ = static_cast<const char *>(mapping);
+				mapped_size_ = size_t(status.st_size);
+			}
+		}
+		if(mapping_ || !status.st_size) {
+			close(fd);
+			return;
+		}
+	}
+
+	// Otherwise fall back on reading; this covers pipes, devices and anything that failed to map.
+	size_t size = 0;
+	while(true) {
+		buffer_.resize(size + BlockSize);
+		const auto bytes = read(fd, buffer_.data() + size, BlockSize);
+		if(bytes < 0 && errno == EINTR) continue;
+		if(bytes < 0) {
+			close(fd);
+			throw std::runtime_error(std::string("Couldn't read ") + path);
+		}
+		if(!bytes) break;
+		size += size_t(bytes);
+	}
+	buffer_.resize(size);
+	close(fd);
+}
+
+InputBuffer::InputBuffer(FILE *const file) {
+	while(true) {
+		const auto size = buffer_.size();
+		buffer_.resize(size + BlockSize);
+		const auto bytes = fread(buffer_.data() + size, 1, BlockSize, file);
+		buffer_.resize(size + bytes);
+		if(bytes < BlockSize) break;
+	}
+	if(ferror(file)) {
+		throw std::runtime_error("Couldn't read input");
+	}
+}
+
+InputBuffer::~InputBuffer() {
+	if(mapping_) {
+		munmap(const_cast<char *>(mapping_), mapped_size_);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Provides the entire contents of a file or stream as a single contiguous, read-only view.
+///
+/// Regular files are memory mapped; anything else is read in large blocks.
+class InputBuffer {
+public:
+	/// Opens and maps the file at @c path.
+	///
+	/// @throws std::runtime_error if the file can't be opened or read.
+	explicit InputBuffer(const std::string &path);
+
+	/// Reads the remainder of @c file, which is not closed.
+	///
+	/// @throws std::runtime_error if @c file can't be read.
+	explicit InputBuffer(FILE *file);
+
+	~InputBuffer();
+
+	InputBuffer(const InputBuffer &) = delete;
+	InputBuffer &operator =(const InputBuffer &) = delete;
+
+	std::string_view view() const {
+		return mapping_ ? std::string_view(mapping_, mapped_size_) : std::string_view(buffer_.data(), buffer_.size());
+	}
+
+private:
+	const char *mapping_ = nullptr;
+	size_t mapped_size_ = 0;
+	std::vector<char> buffer_;
+};
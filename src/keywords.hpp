@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Tokeniser {
+
+enum Flags: uint8_t {
+	PseudoVariable = 0x40,
+	REM = 0x20,
+	LineNumber = 0x10,
+	FNProc = 0x08,
+	Start = 0x04,
+	Middle = 0x02,
+	Conditional = 0x01
+};
+struct Keyword {
+	uint8_t token = 0;
+	uint8_t flags = 0;
+
+	/// The second byte of a two-byte token, which @c token then prefixes; 0 for a single-byte token.
+	uint8_t extension = 0;
+};
+
+using KeywordEntry = std::pair<const char *, Keyword>;
+
+/// All BBC BASIC 2 keywords and their tokens. Where a keyword is listed more than once,
+/// the final entry is the one that takes effect.
+constexpr KeywordEntry keywords[] = {
+	{"AND",			{0x80}},
+	{"DIV",			{0x81}},
+	{"EOR",			{0x82}},
+	{"MOD",			{0x83}},
+	{"OR",			{0x84}},
+	{"ERROR",		{0x85, Start}},
+	{"LINE",		{0x86}},
+	{"OFF",			{0x87}},
+	{"STEP",		{0x88}},
+	{"SPC",			{0x89}},
+	{"TAB(",		{0x8a}},
+	{"ELSE",		{0x8b, LineNumber | Start}},
+	{"THEN",		{0x8c, LineNumber | Start}},
+	{"OPENIN",		{0x8e}},
+	{"PTR",			{0x8f, PseudoVariable | Middle | Conditional}},
+	{"PAGE",		{0x90, PseudoVariable | Middle | Conditional}},
+	{"TIME",		{0x91, PseudoVariable | Middle | Conditional}},
+	{"LOMEM",		{0x92, PseudoVariable | Middle | Conditional}},
+	{"HIMEM",		{0x93, PseudoVariable | Middle | Conditional}},
+	{"ABS",			{0x94}},
+	{"ACS",			{0x95}},
+	{"ADVAL",		{0x96}},
+	{"ASC",			{0x97}},
+	{"ASN",			{0x98}},
+	{"ATN",			{0x99}},
+	{"BGET",		{0x9a, Conditional}},
+	{"COS",			{0x9b}},
+	{"COUNT",		{0x9c, Conditional}},
+	{"DEG",			{0x9d}},
+	{"ERL",			{0x9e, Conditional}},
+	{"ERR",			{0x9f, Conditional}},
+	{"EVAL",		{0xa0}},
+	{"EXP",			{0xa1}},
+	{"EXT",			{0xa2, Conditional}},
+	{"FALSE",		{0xa3, Conditional}},
+	{"FN",			{0xa4, FNProc}},
+	{"GET",			{0xa5}},
+	{"INKEY",		{0xa6}},
+	{"INSTR(",		{0xa7}},
+	{"INT",			{0xa8}},
+	{"LEN",			{0xa9}},
+	{"LN",			{0xaa}},
+	{"LOG",			{0xab}},
+	{"NOT",			{0xac}},
+	{"OPENUP",		{0xad}},
+	{"OPENOUT",		{0xae}},
+	{"PI",			{0xaf, Conditional}},
+	{"POINT(",		{0xb0}},
+	{"POS",			{0xb1, Conditional}},
+	{"RAD",			{0xb2}},
+	{"RND",			{0xb3, Conditional}},
+	{"SGN",			{0xb4}},
+	{"SIN",			{0xb5}},
+	{"SQR",			{0xb6}},
+	{"TAN",			{0xb7}},
+	{"TO",			{0xb8}},
+	{"TRUE",		{0xb9, Conditional}},
+	{"USR",			{0xba}},
+	{"VAL",			{0xbb}},
+	{"VPOS",		{0xbc, Conditional}},
+	{"CHR$",		{0xbd}},
+	{"GET$",		{0xbe}},
+	{"INKEY$",		{0xbf}},
+	{"LEFT$(",		{0xc0}},
+	{"MID$(",		{0xc1}},
+	{"RIGHT$(",		{0xc2}},
+	{"STR$",		{0xc3}},
+	{"STRING$(",	{0xc4}},
+	{"EOF",			{0xc5, Conditional}},
+	{"AUTO",		{0xc6, LineNumber}},
+	{"DELETE",		{0xc7, LineNumber}},
+	{"LOAD",		{0xc8, Middle}},
+	{"LIST",		{0xc9, LineNumber}},
+	{"NEW",			{0xca, Conditional}},
+	{"OLD",			{0xcb, Conditional}},
+	{"RENUMBER",	{0xcc, LineNumber}},
+	{"SAVE",		{0xcd, Middle}},
+	{"PTR",			{0xcf}},
+	{"PAGE",		{0xd0}},
+	{"TIME",		{0xd1}},
+	{"LOMEM",		{0xd2}},
+	{"HIMEM",		{0xd3}},
+	{"SOUND",		{0xd4, Middle}},
+	{"BPUT",		{0xd5, Middle | Conditional}},
+	{"CALL",		{0xd6, Middle}},
+	{"CHAIN",		{0xd7, Middle}},
+	{"CLEAR",		{0xd8, Conditional}},
+	{"CLOSE",		{0xd9, Middle | Conditional}},
+	{"CLG",			{0xda, Conditional}},
+	{"CLS",			{0xdb, Conditional}},
+	{"DATA",		{0xdc, REM}},
+	{"DEF",			{0xdd}},
+	{"DIM",			{0xde, Middle}},
+	{"DRAW",		{0xdf, Middle}},
+	{"END",			{0xe0, Conditional}},
+	{"ENDPROC",		{0xe1, Conditional}},
+	{"ENVELOPE",	{0xe2, Middle}},
+	{"ENVELOPE",	{0xe2, Middle}},
+	{"FOR",			{0xe3, Middle}},
+	{"GOSUB",		{0xe4, LineNumber | Middle}},
+	{"GOTO",		{0xe5, LineNumber | Middle}},
+	{"GCOL",		{0xe6, Middle}},
+	{"IF",			{0xe7, Middle}},
+	{"INPUT",		{0xe8, Middle}},
+	{"LET",			{0xe9, Start}},
+	{"LOCAL",		{0xea, Middle}},
+	{"MODE",		{0xeb, Middle}},
+	{"MOVE",		{0xec, Middle}},
+	{"NEXT",		{0xed, Middle}},
+	{"ON",			{0xee, Middle}},
+	{"VDU",			{0xef, Middle}},
+	{"PLOT",		{0xf0, Middle}},
+	{"PRINT",		{0xf1, Middle}},
+	{"PROC",		{0xf2, FNProc | Middle}},
+	{"READ",		{0xf3, Middle}},
+	{"REM",			{0xf4, REM}},
+	{"REPEAT",		{0xf5}},
+	{"REPORT",		{0xf6, Conditional}},
+	{"RESTORE",		{0xf7, LineNumber | Middle}},
+	{"RETURN",		{0xf8, Conditional}},
+	{"RUN",			{0xf9, Conditional}},
+	{"STOP",		{0xfa, Conditional}},
+	{"COLOUR",		{0xfb, Middle}},
+	{"TRACE",		{0xfc, LineNumber | Middle}},
+	{"UNTIL",		{0xfd, Middle}},
+	{"WIDTH",		{0xfe, Middle}},
+	{"OSCLI",		{0xff, Middle}},
+};
+
+/// Keywords added by BASIC IV, of the Master 128.
+constexpr KeywordEntry basic4_additions[] = {
+	{"EDIT",		{0xce, LineNumber}},
+};
+
+/// Keywords added or moved by BASIC V, of RISC OS, relative to BASIC IV. The immediate commands
+/// become two-byte tokens prefixed by $c7, releasing $c9–$ce for structured statements; $c6 and
+/// $c8 prefix new functions and statements.
+constexpr KeywordEntry basic5_additions[] = {
+	{"OTHERWISE",	{0x7f, Start}},
+	{"WHEN",		{0xc9, Middle}},
+	{"OF",			{0xca}},
+	{"ENDCASE",		{0xcb, Conditional}},
+	{"ENDIF",		{0xcd, Conditional}},
+	{"ENDWHILE",	{0xce, Conditional}},
+
+	{"SUM",			{0xc6, 0, 0x8e}},
+	{"BEAT",		{0xc6, Conditional, 0x8f}},
+
+	{"APPEND",		{0xc7, Middle, 0x8e}},
+	{"AUTO",		{0xc7, LineNumber, 0x8f}},
+	{"CRUNCH",		{0xc7, Middle, 0x90}},
+	{"DELETE",		{0xc7, LineNumber, 0x91}},
+	{"EDIT",		{0xc7, LineNumber, 0x92}},
+	{"HELP",		{0xc7, Conditional, 0x93}},
+	{"LIST",		{0xc7, LineNumber, 0x94}},
+	{"LOAD",		{0xc7, Middle, 0x95}},
+	{"LVAR",		{0xc7, Conditional, 0x96}},
+	{"NEW",			{0xc7, Conditional, 0x97}},
+	{"OLD",			{0xc7, Conditional, 0x98}},
+	{"RENUMBER",	{0xc7, LineNumber, 0x99}},
+	{"SAVE",		{0xc7, Middle, 0x9a}},
+	{"TEXTLOAD",	{0xc7, Middle, 0x9b}},
+	{"TEXTSAVE",	{0xc7, Middle, 0x9c}},
+	{"TWIN",		{0xc7, Conditional, 0x9d}},
+	{"TWINO",		{0xc7, Conditional, 0x9e}},
+	{"INSTALL",		{0xc7, Middle, 0x9f}},
+
+	{"CASE",		{0xc8, Middle, 0x8e}},
+	{"CIRCLE",		{0xc8, Middle, 0x8f}},
+	{"FILL",		{0xc8, Middle, 0x90}},
+	{"ORIGIN",		{0xc8, Middle, 0x91}},
+	{"POINT",		{0xc8, Middle, 0x92}},
+	{"RECTANGLE",	{0xc8, Middle, 0x93}},
+	{"SWAP",		{0xc8, Middle, 0x94}},
+	{"WHILE",		{0xc8, Middle, 0x95}},
+	{"WAIT",		{0xc8, Middle | Conditional, 0x96}},
+	{"MOUSE",		{0xc8, Middle, 0x97}},
+	{"QUIT",		{0xc8, Conditional, 0x98}},
+	{"SYS",			{0xc8, Middle, 0x99}},
+	{"INSTALL",		{0xc8, Middle, 0x9a}},
+	{"LIBRARY",		{0xc8, Middle, 0x9b}},
+	{"TINT",		{0xc8, Middle, 0x9c}},
+	{"ELLIPSE",		{0xc8, Middle, 0x9d}},
+	{"BEATS",		{0xc8, Middle, 0x9e}},
+	{"TEMPO",		{0xc8, Middle, 0x9f}},
+	{"VOICES",		{0xc8, Middle, 0xa0}},
+	{"VOICE",		{0xc8, Middle, 0xa1}},
+	{"STEREO",		{0xc8, Middle, 0xa2}},
+	{"OVERLAY",		{0xc8, Middle, 0xa3}},
+};
+
+namespace Private {
+
+template <size_t first_size, size_t second_size>
+constexpr std::array<KeywordEntry, first_size + second_size> concatenate(
+	const std::array<KeywordEntry, first_size> &first,
+	const std::array<KeywordEntry, second_size> &second
+) {
+	std::array<KeywordEntry, first_size + second_size> result{};
+	std::copy(first.begin(), first.end(), result.begin());
+	std::copy(second.begin(), second.end(), result.begin() + first_size);
+	return result;
+}
+
+}
+
+/// Descriptions of each dialect of BBC BASIC, for specialising the tokeniser and detokeniser.
+///
+/// Each has a list of @c keywords in which, as in @c keywords above, the final entry for
+/// any keyword takes effect; if @c extended_tokens is set then @c Keyword::extension is
+/// honoured; and if @c line_start_else is nonzero then it is the token for an ELSE that
+/// begins a line, which opens the alternative of a multi-line IF.
+namespace Dialects {
+
+struct BASIC2 {
+	static constexpr auto keywords = std::to_array(Tokeniser::keywords);
+	static constexpr bool extended_tokens = false;
+	static constexpr uint8_t line_start_else = 0;
+};
+
+struct BASIC4 {
+	static constexpr auto keywords = Private::concatenate(BASIC2::keywords, std::to_array(basic4_additions));
+	static constexpr bool extended_tokens = false;
+	static constexpr uint8_t line_start_else = 0;
+};
+
+struct BASIC5 {
+	static constexpr auto keywords = Private::concatenate(BASIC4::keywords, std::to_array(basic5_additions));
+	static constexpr bool extended_tokens = true;
+	static constexpr uint8_t line_start_else = 0xcc;
+};
+
+}
+
+}
@@ -1,114 +1,766 @@
 #include "tokeniser.hpp"
-#include "CRC.hpp"
+#include "audio.hpp"
+#include "batch.hpp"
+#include "cache.hpp"
+#include "cruncher.hpp"
+#include "input.hpp"
+#include "memory.hpp"
+#include "server.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+#include "uef.hpp"
+#include "watch.hpp"
 
-#include <algorithm>
-#include <cstdint>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <exception>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace {
 
-class UEFWriter {
-public:
-	UEFWriter(const std::string &file_name) {
-		file_ = fopen(file_name.c_str(), "wb");
-		if(!file_) {
-			throw std::runtime_error(std::string("Unable to open for output: ") + file_name);
-		}
-
-		// Write header.
-		fputs("UEF File!", file_);
-		fputc(0, file_);
-		fputc(10, file_);
-		fputc(0, file_);
-	}
-
-	struct Chunk {
-	public:
-		Chunk(uint16_t id, FILE *file) : id_(id), file_(file) {}
-
-		~Chunk() {
-			// Write chunk ID.
-			fputc(uint8_t(id_ >> 0), file_);
-			fputc(uint8_t(id_ >> 8), file_);
-
-			// Write chunk length.
-			const auto length = uint32_t(chunk_contents_.size());
-			fputc(uint8_t(length >> 0), file_);
-			fputc(uint8_t(length >> 8), file_);
-			fputc(uint8_t(length >> 16), file_);
-			fputc(uint8_t(length >> 24), file_);
-
-			// Write chunk data.
-			fwrite(chunk_contents_.data(), 1, chunk_contents_.size(), file_);
-		}
-
-		template <typename IteratorT>
-		void append(IteratorT begin, IteratorT end, bool append_crc = false) {
-			// Write data. Could do a better job by type inspection but
-			// quantities of data in this program are so small that there's
-			// virtue in simplicity.
-			chunk_contents_.reserve(chunk_contents_.size() + std::distance(begin, end) + (append_crc ? 2 : 0));
-			for(auto it = begin; it != end; it++) {
-				chunk_contents_.push_back(*it);
-			}
-			if(append_crc) {
-				const auto crc = CRC::crc16(begin, end);
-				chunk_contents_.push_back(crc.high());
-				chunk_contents_.push_back(crc.low());
+void print_help() {
+	std::cout << "usage: bas2uef [-i input file] [-o output file] [-c cache file] [-j threads] [-z] [-k] [-e] [--stats[=json]] [--counters] [--crunch] [--basic version] [layout]" << std::endl;
+	std::cout << "       bas2uef -b [-o output directory] [-j threads] [-z] [--basic version] [layout] input..." << std::endl;
+	std::cout << "       bas2uef -p [-o output file] [-l catalogue] [-j threads] [-z] [--basic version] [layout] input..." << std::endl;
+	std::cout << "       bas2uef -f [-o output file] [-t title] [--tracks n] [--boot] [-j threads] [--basic version] input..." << std::endl;
+	std::cout << "       bas2uef -m [-o output file] [--script] [--page address] [-j threads] [--basic version] [input file]" << std::endl;
+	std::cout << "       bas2uef -w [-o output directory] [-z] [--debounce ms] [--basic version] [layout] input..." << std::endl;
+	std::cout << "       bas2uef -s [-j threads] [socket]" << std::endl;
+	std::cout << "       bas2uef -v [-j threads] tape..." << std::endl;
+	std::cout << "       bas2uef -d [-o output file] [--basic version] tape" << std::endl;
+	std::cout << "       bas2uef -a [-o output file] [-r sample rate] tape" << std::endl;
+	std::cout << "version: 2, 4 or 5; BASIC II is the default" << std::endl;
+	std::cout << "layout: [--fast] [--leader cycles] [--carrier cycles] [--gap seconds] [--frequency Hz]" << std::endl;
+}
+
+/// @returns @c true if @c argument is an option rather than a file name; by the time that an
+/// argument is tested, it's one that wasn't recognised, or lacked its value.
+bool is_option(const char *const argument) {
+	return argument[0] == '-';
+}
+
+/// Thrown for options that can't be honoured as given; @c main responds with usage.
+struct UsageError: public std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+/// Applies the tape layout option at @c argv[c], if it is one, advancing @c c past its value.
+///
+/// @returns @c true if an option was applied; @c false otherwise.
+/// @throws UsageError if the option's value is out of range.
+bool parse_layout(const int argc, char *argv[], int &c, TapeLayout &layout) {
+	const std::string option = argv[c];
+	if(option == "--fast") {
+		layout = TapeLayout::fast();
+		return true;
+	}
+
+	if(c == argc - 1) return false;
+	const std::string value = argv[c + 1];
+
+	// Cycles are written as 16-bit counts and times as floats; anything that wouldn't survive
+	// that, or that no reader could make sense of, is refused.
+	const auto cycles = [&] {
+		const auto count = std::stoul(value);
+		if(count > 0xffff) throw UsageError(option + " takes at most 65535 cycles");
+		return uint16_t(count);
+	};
+	const auto real = [&](const bool allow_zero) {
+		const auto number = std::stof(value);
+		if(!std::isfinite(number) || number < 0.0f || (!allow_zero && number == 0.0f)) {
+			throw UsageError(option + (allow_zero ? " must be zero or more" : " must be more than zero"));
+		}
+		return number;
+	};
+
+	if(option == "--leader")			layout.leader_cycles = cycles();
+	else if(option == "--carrier")		layout.carrier_cycles = cycles();
+	else if(option == "--gap")			layout.gap = real(true);
+	else if(option == "--frequency")	layout.base_frequency = real(false);
+	else return false;
+
+	++c;
+	return true;
+}
+
+/// Applies the dialect option at @c argv[c], if it is one, advancing @c c past its value.
+///
+/// @returns @c true if an option was applied; @c false otherwise.
+/// @throws std::runtime_error if the version named isn't one of those supported.
+bool parse_dialect(const int argc, char *argv[], int &c, Tokeniser::Dialect &dialect) {
+	if(std::string("--basic") != argv[c] || c == argc - 1) return false;
+
+	const std::string value = argv[++c];
+	if(value == "2" || value == "II")		dialect = Tokeniser::Dialect::BASIC2;
+	else if(value == "4" || value == "IV")	dialect = Tokeniser::Dialect::BASIC4;
+	else if(value == "5" || value == "V")	dialect = Tokeniser::Dialect::BASIC5;
+	else throw std::runtime_error("Unsupported BASIC version: " + value);
+	return true;
+}
+
+/// Checks that @c input, if given, can be opened, complaining to stderr if not; an empty name means stdin.
+///
+/// @returns @c true if reading may proceed; @c false otherwise.
+bool check_input(const std::string &input) {
+	if(input.empty() || !access(input.c_str(), R_OK)) return true;
+	std::cerr << "Couldn't open " << input << std::endl;
+	return false;
+}
+
+void print_load_time(const std::string &tape) {
+	const auto load_time = UEFReader(tape).load_time();
+	std::cout <<
+		"Load time: " << load_time.seconds_at_1200_baud << "s at 1200 baud, " <<
+		load_time.seconds_at_300_baud << "s at 300 baud" << std::endl;
+}
+
+int batch(int argc, char *argv[]) {
+	std::string output_directory;
+	size_t threads = 0;
+	bool compress = false;
+	TapeLayout layout;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+	std::vector<std::string> inputs;
+
+	for(int c = 2; c < argc; c++) {
+		const bool has_value = c < argc - 1;
+
+		if(std::string("-z") == argv[c]) {
+			compress = true;
+			continue;
+		}
+
+		if(parse_layout(argc, argv, c, layout) || parse_dialect(argc, argv, c, dialect)) {
+			continue;
+		}
+
+		if(std::string("-o") == argv[c] && has_value) {
+			output_directory = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-j") == argv[c] && has_value) {
+			threads = std::stoul(argv[c + 1]);
+			++c;
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		inputs.push_back(argv[c]);
+	}
+
+	if(inputs.empty()) {
+		print_help();
+		return -1;
+	}
+	return Batch::convert(Batch::collect(inputs, output_directory), threads, compress, layout, dialect) ? -1 : 0;
+}
+
+int pack(int argc, char *argv[]) {
+	std::string output = "out.uef";
+	std::string catalogue;
+	size_t threads = 0;
+	bool compress = false;
+	TapeLayout layout;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+	std::vector<std::string> inputs;
+
+	for(int c = 2; c < argc; c++) {
+		const bool has_value = c < argc - 1;
+
+		if(std::string("-z") == argv[c]) {
+			compress = true;
+			continue;
+		}
+
+		if(parse_layout(argc, argv, c, layout) || parse_dialect(argc, argv, c, dialect)) {
+			continue;
+		}
+
+		if(std::string("-o") == argv[c] && has_value) {
+			output = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-l") == argv[c] && has_value) {
+			catalogue = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-j") == argv[c] && has_value) {
+			threads = std::stoul(argv[c + 1]);
+			++c;
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		inputs.push_back(argv[c]);
+	}
+
+	if(inputs.empty()) {
+		print_help();
+		return -1;
+	}
+
+	// By default the catalogue sits alongside the tape.
+	if(catalogue.empty()) {
+		catalogue = std::filesystem::path(output).replace_extension(".json").string();
+	}
+	return Batch::pack(Batch::collect_programs(inputs), output, catalogue, threads, compress, layout, dialect) ? -1 : 0;
+}
+
+int disc(int argc, char *argv[]) {
+	std::string output = "out.ssd";
+	size_t threads = 0;
+	Batch::DiscOptions options;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+	std::vector<std::string> inputs;
+
+	for(int c = 2; c < argc; c++) {
+		const bool has_value = c < argc - 1;
+
+		if(std::string("--boot") == argv[c]) {
+			options.boot = true;
+			continue;
+		}
+
+		if(parse_dialect(argc, argv, c, dialect)) {
+			continue;
+		}
+
+		if(std::string("-o") == argv[c] && has_value) {
+			output = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-t") == argv[c] && has_value) {
+			options.title = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("--tracks") == argv[c] && has_value) {
+			options.tracks = std::stoul(argv[c + 1]);
+			++c;
+			continue;
+		}
+
+		if(std::string("-j") == argv[c] && has_value) {
+			threads = std::stoul(argv[c + 1]);
+			++c;
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		inputs.push_back(argv[c]);
+	}
+
+	if(inputs.empty()) {
+		print_help();
+		return -1;
+	}
+	return Batch::disc(Batch::collect_programs(inputs), output, threads, options, dialect) ? -1 : 0;
+}
+
+int memory(int argc, char *argv[]) {
+	std::string output = "out.bin";
+	std::string input;
+	size_t threads = 1;
+	bool script = false;
+	size_t page = MemoryImage::DefaultPage;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+
+	for(int c = 2; c < argc; c++) {
+		const bool has_value = c < argc - 1;
+
+		if(std::string("--script") == argv[c]) {
+			script = true;
+			continue;
+		}
+
+		if(parse_dialect(argc, argv, c, dialect)) {
+			continue;
+		}
+
+		if(std::string("-o") == argv[c] && has_value) {
+			output = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("--page") == argv[c] && has_value) {
+			std::string address = argv[c + 1];
+			if(!address.empty() && address[0] == '&') address.erase(0, 1);
+			size_t length = 0;
+			page = std::stoul(address, &length, 16);
+			if(length != address.size() || page > 0xffff) {
+				print_help();
+				return -1;
 			}
+			++c;
+			continue;
 		}
 
-		template <typename CollectionT>
-		void append(const CollectionT &data, bool append_crc = false) {
-			append(std::begin(data), std::end(data), append_crc);
+		if(std::string("-j") == argv[c] && has_value) {
+			threads = std::stoul(argv[c + 1]);
+			++c;
+			continue;
 		}
 
-	private:
-		uint16_t id_;
-		FILE *file_;
-		std::vector<uint8_t> chunk_contents_;
-	};
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		if(!input.empty()) {
+			print_help();
+			return -1;
+		}
+		input = argv[c];
+	}
 
-	Chunk chunk(const uint16_t id) {
-		return Chunk(id, file_);
+	// Read from file or from stdin if none was specified, and write the tokenised program as it stands.
+	if(!check_input(input)) {
+		return -1;
+	}
+	const auto source = input.empty() ? std::make_unique<InputBuffer>(stdin) : std::make_unique<InputBuffer>(input);
+	std::vector<uint8_t> program;
+	if(threads == 1) {
+		program = Tokeniser::import(source->view(), dialect);
+	} else {
+		ThreadPool pool(threads);
+		program = Tokeniser::import(source->view(), pool, dialect);
 	}
 
-	~UEFWriter() {
-		fclose(file_);
+	const auto pointers = MemoryImage::pointers(program, page);
+	if(script) {
+		MemoryImage::write_script(output, program, pointers);
+	} else {
+		MemoryImage::write_binary(output, program);
 	}
 
-private:
-	FILE *file_ = nullptr;
-};
+	printf("PAGE=&%04X TOP=&%04X LOMEM=&%04X VARTOP=&%04X\n", pointers.page, pointers.top, pointers.lomem, pointers.vartop);
+	return 0;
+}
 
-void print_help() {
-	std::cout << "usage: bas2uef [-i input file] [-o output file]" << std::endl;
+int watch(int argc, char *argv[]) {
+	Watch::Options options;
+	std::vector<std::string> inputs;
+
+	for(int c = 2; c < argc; c++) {
+		const bool has_value = c < argc - 1;
+
+		if(std::string("-z") == argv[c]) {
+			options.compress = true;
+			continue;
+		}
+
+		if(parse_layout(argc, argv, c, options.layout) || parse_dialect(argc, argv, c, options.dialect)) {
+			continue;
+		}
+
+		if(std::string("-o") == argv[c] && has_value) {
+			options.output_directory = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("--debounce") == argv[c] && has_value) {
+			options.debounce = std::chrono::microseconds(int64_t(std::stod(argv[c + 1]) * 1000.0));
+			++c;
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		inputs.push_back(argv[c]);
+	}
+
+	if(inputs.empty()) {
+		print_help();
+		return -1;
+	}
+	Watch::watch(inputs, options);
+	return 0;
 }
 
+int server(int argc, char *argv[]) {
+	std::string socket_path;
+	size_t threads = 0;
+
+	for(int c = 2; c < argc; c++) {
+		if(std::string("-j") == argv[c] && c < argc - 1) {
+			threads = std::stoul(argv[c + 1]);
+			++c;
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		if(!socket_path.empty()) {
+			print_help();
+			return -1;
+		}
+		socket_path = argv[c];
+	}
+
+	// Without a socket, requests arrive on stdin and responses leave on stdout.
+	if(socket_path.empty()) {
+		Server::serve(STDIN_FILENO, STDOUT_FILENO, threads);
+	} else {
+		Server::serve(socket_path, threads);
+	}
+	return 0;
 }
 
-int main(int argc, char *argv[]) try {
+int verify(int argc, char *argv[]) {
+	size_t threads = 0;
+	std::vector<std::string> inputs;
+
+	for(int c = 2; c < argc; c++) {
+		if(std::string("-j") == argv[c] && c < argc - 1) {
+			threads = std::stoul(argv[c + 1]);
+			++c;
+			continue;
+		}
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		inputs.push_back(argv[c]);
+	}
+
+	if(inputs.empty()) {
+		print_help();
+		return -1;
+	}
+	return Batch::verify(Batch::collect_tapes(inputs), threads) ? -1 : 0;
+}
+
+int detokenise(int argc, char *argv[]) {
+	std::string output;
+	std::string tape;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+
+	for(int c = 2; c < argc; c++) {
+		if(std::string("-o") == argv[c] && c < argc - 1) {
+			output = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(parse_dialect(argc, argv, c, dialect)) {
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		if(!tape.empty()) {
+			print_help();
+			return -1;
+		}
+		tape = argv[c];
+	}
+
+	if(tape.empty()) {
+		print_help();
+		return -1;
+	}
+
+	// List every file on the tape in turn, to stdout if no output file was specified.
+	const UEFReader reader(tape);
+	reader.verify();
+	std::string text;
+	for(const auto &file: reader.files()) {
+		text += Tokeniser::detokenise(file.data.data(), file.data.data() + file.data.size(), dialect);
+	}
+
+	FILE *const file = output.empty() ? stdout : fopen(output.c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("Unable to open for output: " + output);
+	}
+	const bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if((file != stdout && fclose(file)) || !written) {
+		throw std::runtime_error("Unable to write output");
+	}
+	return 0;
+}
+
+int render(int argc, char *argv[]) {
+	std::string output;
+	std::string tape;
+	Audio::Options options;
+
+	for(int c = 2; c < argc; c++) {
+		const bool has_value = c < argc - 1;
+
+		if(std::string("-o") == argv[c] && has_value) {
+			output = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-r") == argv[c] && has_value) {
+			options.sample_rate = uint32_t(std::stoul(argv[c + 1]));
+			++c;
+			continue;
+		}
+
+		if(is_option(argv[c])) {
+			print_help();
+			return -1;
+		}
+		if(!tape.empty()) {
+			print_help();
+			return -1;
+		}
+		tape = argv[c];
+	}
+
+	if(tape.empty()) {
+		print_help();
+		return -1;
+	}
+
+	// By default the recording sits alongside the tape, as a WAV; a .csw output selects CSW.
+	if(output.empty()) {
+		output = std::filesystem::path(tape).replace_extension(".wav").string();
+	}
+	options.format = Audio::format_for(output);
+
+	const UEFReader reader(tape);
+	const auto start = std::chrono::steady_clock::now();
+	const auto result = Audio::render(reader, output, options);
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << result.seconds << "s of tape to " << result.bytes << " bytes in " << seconds << "s" << std::endl;
+	return 0;
+}
+
+struct Options {
 	std::string output = "out.uef";
 	std::string input = "";
+	std::string cache_file = "";
+	size_t threads = 1;
+	bool compress = false;
+	bool keep_going = false;
+	bool estimate = false;
+	bool stats = false, stats_json = false;
+	bool counters = false;
+	bool crunch = false;
+	TapeLayout layout;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+};
+
+/// Tokenises @c source, crunches the result and writes it to the output file, reporting the savings.
+///
+/// @throws std::runtime_error if the program isn't BASIC II, as that's the only dialect the cruncher knows.
+int crunch(const Options &options, const std::string_view source) {
+	if(options.dialect != Tokeniser::Dialect::BASIC2) {
+		throw std::runtime_error("--crunch supports only BASIC II");
+	}
+
+	std::vector<uint8_t> program;
+	if(options.threads == 1) {
+		program = Tokeniser::import(source);
+	} else {
+		ThreadPool pool(options.threads);
+		program = Tokeniser::import(source, pool);
+	}
+	const auto result = Cruncher::crunch(program);
+	write_uef(options.output, result.program, options.compress, options.layout);
+
+	// Compare load times of uncompressed images, which are what reach the tape.
+	const auto before = UEFReader(write_uef(program, options.layout)).load_time();
+	const auto after = UEFReader(write_uef(result.program, options.layout)).load_time();
+	const auto saved = program.size() - result.program.size();
+	std::cout <<
+		"Crunched " << program.size() << " bytes to " << result.program.size() << ", saving " << saved << " (" <<
+		(program.empty() ? 0.0 : 100.0 * double(saved) / double(program.size())) << "%)" << std::endl;
+	std::cout <<
+		"Load time saved: " << before.seconds_at_1200_baud - after.seconds_at_1200_baud << "s at 1200 baud, " <<
+		before.seconds_at_300_baud - after.seconds_at_300_baud << "s at 300 baud" << std::endl;
+	std::cout <<
+		"Removed " << result.lines_removed << " lines, merged " << result.lines_merged << " lines and shortened " <<
+		result.names_shortened << " names" << std::endl;
+	for(const auto &note: result.notes) {
+		std::cout << note << std::endl;
+	}
+	return 0;
+}
+
+int convert(const Options &options) {
+	// Statistics are collected by a separate path, so as not to burden ordinary conversion.
+	if(options.stats) {
+		const auto cache = options.cache_file.empty() ? nullptr : std::make_unique<ConversionCache>(options.cache_file, options.dialect);
+		const auto pool = options.threads == 1 ? nullptr : std::make_unique<ThreadPool>(options.threads);
+		const auto report = Stats::convert(
+			options.input, options.output, options.compress, pool.get(), cache.get(), options.layout, options.dialect, options.counters);
+		if(cache) cache->save();
+		Stats::print(report, options.stats_json);
+		return 0;
+	}
+
+	// Read from file or from stdin if none was specified.
+	const auto source = options.input.empty() ?
+		std::make_unique<InputBuffer>(stdin) : std::make_unique<InputBuffer>(options.input);
+
+	// Always output to a file as this is primarily binary data.
+	if(options.crunch) {
+		return crunch(options, source->view());
+	}
+
+	if(options.keep_going) {
+		const auto errors = diagnose_to_uef(options.output, source->view(), options.compress, options.layout, options.dialect);
+		for(const auto &error: errors) {
+			std::cout << "ERROR: " << error.to_string() << std::endl;
+		}
+		return errors.empty() ? 0 : -1;
+	}
+
+	if(options.cache_file.empty()) {
+		if(options.threads == 1) {
+			tokenise_to_uef(options.output, source->view(), options.compress, nullptr, nullptr, options.layout, options.dialect);
+		} else {
+			ThreadPool pool(options.threads);
+			write_uef(options.output, Tokeniser::import(source->view(), pool, options.dialect), options.compress, options.layout);
+		}
+		return 0;
+	}
+
+	// With a cache, reuse whatever hasn't changed since the last conversion.
+	ConversionCache cache(options.cache_file, options.dialect);
+	tokenise_to_uef(options.output, source->view(), options.compress, &cache, nullptr, options.layout, options.dialect);
+	cache.save();
+
+	const auto &statistics = cache.statistics();
+	std::cout <<
+		"Reused " << statistics.lines_reused << " of " << statistics.lines << " lines (" <<
+		(statistics.lines ? 100.0 * double(statistics.lines_reused) / double(statistics.lines) : 0.0) << "%)" << std::endl;
+
+	return 0;
+}
+
+}
+
+int main(int argc, char *argv[]) try {
+	Options options;
+
+	if(argc > 1 && std::string("-b") == argv[1]) {
+		return batch(argc, argv);
+	}
+	if(argc > 1 && std::string("-p") == argv[1]) {
+		return pack(argc, argv);
+	}
+	if(argc > 1 && std::string("-m") == argv[1]) {
+		return memory(argc, argv);
+	}
+	if(argc > 1 && std::string("-f") == argv[1]) {
+		return disc(argc, argv);
+	}
+	if(argc > 1 && (std::string("-w") == argv[1] || std::string("--watch") == argv[1])) {
+		return watch(argc, argv);
+	}
+	if(argc > 1 && std::string("-s") == argv[1]) {
+		return server(argc, argv);
+	}
+	if(argc > 1 && std::string("-v") == argv[1]) {
+		return verify(argc, argv);
+	}
+	if(argc > 1 && std::string("-d") == argv[1]) {
+		return detokenise(argc, argv);
+	}
+	if(argc > 1 && std::string("-a") == argv[1]) {
+		return render(argc, argv);
+	}
 
 	// Do a negligible parsing of command-line options.
 	for(int c = 1; c < argc; c++) {
+		if(std::string("-z") == argv[c]) {
+			options.compress = true;
+			continue;
+		}
+
+		if(std::string("-k") == argv[c]) {
+			options.keep_going = true;
+			continue;
+		}
+
+		if(std::string("-e") == argv[c]) {
+			options.estimate = true;
+			continue;
+		}
+
+		if(std::string("--stats") == argv[c] || std::string("--stats=json") == argv[c]) {
+			options.stats = true;
+			options.stats_json = std::string("--stats=json") == argv[c];
+			continue;
+		}
+
+		if(std::string("--counters") == argv[c]) {
+			options.stats = options.counters = true;
+			continue;
+		}
+
+		if(std::string("--crunch") == argv[c]) {
+			options.crunch = true;
+			continue;
+		}
+
+		if(parse_layout(argc, argv, c, options.layout) || parse_dialect(argc, argv, c, options.dialect)) {
+			continue;
+		}
+
 		if(c == argc - 1) {
 			print_help();
 			return -1;
 		}
 
 		if(std::string("-o") == argv[c]) {
-			output = argv[c + 1];
+			options.output = argv[c + 1];
 			++c;
 			continue;
 		}
 
 		if(std::string("-i") == argv[c]) {
-			input = argv[c + 1];
+			options.input = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-c") == argv[c]) {
+			options.cache_file = argv[c + 1];
+			++c;
+			continue;
+		}
+
+		if(std::string("-j") == argv[c]) {
+			options.threads = std::stoul(argv[c + 1]);
 			++c;
 			continue;
 		}
@@ -117,54 +769,38 @@ int main(int argc, char *argv[]) try {
 		return -1;
 	}
 
-	// Read from file or from stdin if none was specified.
-	FILE *const in = input.empty() ? stdin : fopen(input.c_str(), "rt");
-	if(!in) {
-		std::cerr << "Couldn't open " << input << std::endl;
-		return -1;
+	// Statistics are gathered along the ordinary path only.
+	if(options.stats && (options.crunch || options.keep_going)) {
+		throw UsageError("--stats and --counters can't be combined with --crunch or -k");
 	}
-	const auto result = Tokeniser::import(in);
-	if(in != stdin) {
-		fclose(in);
+
+	// Crunching works on the whole program at once, so can neither recover from errors nor use a cache.
+	if(options.crunch && (options.keep_going || !options.cache_file.empty())) {
+		throw UsageError("--crunch can't be combined with -k or -c");
 	}
 
-	// Always output to a file as this is primarily binary data.
-	UEFWriter writer(output);
-	writer.chunk(0x0000).append("bas2uef v1.0");
-
-	// Write high tone with a dummy byte.
-	writer.chunk(0x0111).append(std::vector<uint8_t>{0xdc, 0x05, 0xdc, 0x05});
-
-	// Divide data into max-256-byte segments.
-	auto begin = std::begin(result);
-	const auto end = std::end(result);
-	uint16_t block_number = 0;
-	while(begin != end) {
-		const auto remaining = int(std::distance(begin, end));
-		const auto length = std::min(256, remaining);
-
-		const auto block_begin = begin;
-		std::advance(begin, length);
-
-		auto block = writer.chunk(0x0100);
-		block.append(std::vector<uint8_t>{ 0x2a });					// Synchronisation byte.
-		block.append(std::vector<uint8_t>{
-			'B', 'A', 'S', 'I', 'C', 0x00,							// File name, with terminator.
-			0x00, 0x19, 0x00, 0x00,									// Load address.
-			0x23, 0x80, 0x00, 0x00,									// Execution address.
-			uint8_t(block_number >> 0), uint8_t(block_number >> 8),	// Block number.
-			uint8_t(length >> 0), uint8_t(length >> 8),				// Block length.
-			uint8_t(begin == end ? 0x80 : 0x00),					// Block flag.
-			0x00, 0x00, 0x00, 0x00,									// Four unused bytes.
-		}, true);
-		block.append(block_begin, begin, true);
-		writer.chunk(0x0110).append(std::vector{0x58, 0x02});
-		++block_number;
+	// Recovery from errors is serial and uncached.
+	if(options.keep_going && (options.threads != 1 || !options.cache_file.empty())) {
+		throw UsageError("-k can't be combined with -j or -c");
 	}
 
-	return 0;
+	if(!check_input(options.input)) {
+		return -1;
+	}
+
+	const auto result = convert(options);
+	if(options.estimate) {
+		print_load_time(options.output);
+	}
+	return result;
+} catch(const UsageError &error) {
+	std::cout << "ERROR: " << error.what() << std::endl;
+	print_help();
+	return -1;
 } catch(const Tokeniser::Error &error) {
 	std::cout << "ERROR: " << error.to_string() << std::endl;
+	return -1;
 } catch(std::exception &error) {
 	std::cout << "ERROR: " << error.what() << std::endl;
+	return -1;
 }
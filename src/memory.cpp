@@ -0,0 +1,105 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+/*
+	A script begins with a comment giving the pointers, then patches the program into place and
+	finally sets the zero-page pointers, each as a line of its own:
+
+		; PAGE=&1900 TOP=&190D LOMEM=&190D VARTOP=&190D
+		1900: 0D 00 0A 0B 20 F1 20 22 48 49 22 0D FF
+		0000: 0D 19 0D 19	; LOMEM and VARTOP
+		0012: 0D 19	; TOP
+		0018: 19	; PAGE
+
+	Zero page is patched last so that nothing sees pointers to a program that isn't yet there.
+*/
+
+namespace MemoryImage {
+
+namespace {
+
+void write_file(const std::string &file_name, const void *const data, const size_t length) {
+	FILE *const file = fopen(file_name.c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("Unable to open for output: " + file_name);
+	}
+	const bool written = fwrite(data, 1, length, file) == length;
+	if(fclose(file) || !written) {
+		remove(file_name.c_str());
+		throw std::runtime_error("Unable to write output: " + file_name);
+	}
+}
+
+/// Appends a line that patches @c bytes in at @c address, followed by @c comment if there is one.
+void append_patch(std::string &script, const uint16_t address, const std::span<const uint8_t> bytes, const char *const comment = nullptr) {
+	char text[8];
+	snprintf(text, sizeof(text), "%04X:", address);
+	script += text;
+	for(const auto byte: bytes) {
+		snprintf(text, sizeof(text), " %02X", byte);
+		script += text;
+	}
+	if(comment) {
+		script += "\t; ";
+		script += comment;
+	}
+	script += '\n';
+}
+
+}
+
+Pointers pointers(const std::span<const uint8_t> program, const size_t page) {
+	if(page & 0xff) {
+		throw std::runtime_error("PAGE must be a multiple of &100");
+	}
+	if(page < LowestPage || page >= HighestHimem) {
+		throw std::runtime_error("PAGE must be at least &0E00 and below HIMEM");
+	}
+	if(page + program.size() > HighestHimem) {
+		throw std::runtime_error("Program doesn't fit below HIMEM");
+	}
+
+	Pointers result;
+	result.page = uint16_t(page);
+	result.top = result.lomem = result.vartop = uint16_t(page + program.size());
+	return result;
+}
+
+void write_binary(const std::string &file_name, const std::span<const uint8_t> program) {
+	write_file(file_name, program.data(), program.size());
+}
+
+void write_script(const std::string &file_name, const std::span<const uint8_t> program, const Pointers &pointers) {
+	// Allow for each line of sixteen bytes, at three characters apiece plus an address, and a few more lines.
+	std::string script;
+	script.reserve((program.size() / 16 + 1) * 55 + 256);
+
+	char header[80];
+	snprintf(header, sizeof(header), "; PAGE=&%04X TOP=&%04X LOMEM=&%04X VARTOP=&%04X\n",
+		pointers.page, pointers.top, pointers.lomem, pointers.vartop);
+	script += header;
+
+	for(size_t offset = 0; offset < program.size(); offset += 16) {
+		append_patch(script, uint16_t(pointers.page + offset), program.subspan(offset, std::min<size_t>(16, program.size() - offset)));
+	}
+
+	// LOMEM and VARTOP are adjacent, so are patched together.
+	static_assert(Pointers::VartopAddress == Pointers::LomemAddress + 2);
+	const uint8_t variables[] = {
+		uint8_t(pointers.lomem), uint8_t(pointers.lomem >> 8),
+		uint8_t(pointers.vartop), uint8_t(pointers.vartop >> 8),
+	};
+	const uint8_t top[] = {uint8_t(pointers.top), uint8_t(pointers.top >> 8)};
+	const uint8_t page[] = {uint8_t(pointers.page >> 8)};
+	append_patch(script, Pointers::LomemAddress, variables, "LOMEM and VARTOP");
+	append_patch(script, Pointers::TopAddress, top, "TOP");
+	append_patch(script, Pointers::PageAddress, page, "PAGE");
+
+	write_file(file_name, script.data(), script.size());
+}
+
+}
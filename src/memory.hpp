@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+/// Produces the state of memory that BASIC is left in by LOADing a program, so that an emulator
+/// can be given the program directly rather than made to load it from tape.
+namespace MemoryImage {
+
+/// PAGE on a BBC Micro with no filing system other than tape; the lowest that it can be.
+constexpr uint16_t LowestPage = 0x0e00;
+
+/// PAGE on a BBC Micro with a disc filing system; the address that SAVE gives on tape.
+constexpr uint16_t DefaultPage = 0x1900;
+
+/// The highest that HIMEM can be, on a Model B in MODE 7.
+constexpr uint16_t HighestHimem = 0x7c00;
+
+/// BASIC's pointers, and the zero-page addresses that hold them. PAGE is held as its high byte only.
+struct Pointers {
+	uint16_t page = DefaultPage;
+	uint16_t top = 0;
+	uint16_t lomem = 0;
+	uint16_t vartop = 0;
+
+	static constexpr uint16_t PageAddress = 0x18;
+	static constexpr uint16_t TopAddress = 0x12;
+	static constexpr uint16_t LomemAddress = 0x00;
+	static constexpr uint16_t VartopAddress = 0x02;
+};
+
+/// @returns The pointers that BASIC sets upon LOADing @c program at @c page: TOP just beyond the
+/// program's end marker, and LOMEM and VARTOP equal to it, as no variables yet exist.
+/// @throws std::runtime_error if @c page isn't a multiple of 256 from @c LowestPage up, or if the
+/// program wouldn't fit below @c HighestHimem.
+Pointers pointers(std::span<const uint8_t> program, size_t page = DefaultPage);
+
+/// Writes @c program to @c file_name exactly as it sits in memory from PAGE onwards.
+///
+/// @throws std::runtime_error if the file can't be written, in which case none is left behind.
+void write_binary(const std::string &file_name, std::span<const uint8_t> program);
+
+/// Writes a memory-patch script to @c file_name that places @c program at @c pointers.page and
+/// sets BASIC's pointers to match. Each line gives a hexadecimal address, a colon and then up to
+/// sixteen hexadecimal bytes to store from there; anything after a semicolon is a comment.
+///
+/// @throws std::runtime_error if the file can't be written, in which case none is left behind.
+void write_script(const std::string &file_name, std::span<const uint8_t> program, const Pointers &pointers);
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/// Provides table-driven classification of characters and fast scanning for runs of characters within a class.
+namespace Scan {
+
+enum Class: uint8_t {
+	/// Everything other than \n; i.e. the remainder of a line.
+	Any = 0x01,
+	/// Everything other than \n and ".
+	NotQuote = 0x02,
+	/// 0–9, A–Z and a–z; as per @c isalnum in the C locale.
+	Alphanumeric = 0x04,
+	/// Alphanumerics and underscores.
+	ProcedureName = 0x08,
+	/// 0–9 and A–F.
+	HexDigit = 0x10,
+	/// 0–9; as per @c isdigit in the C locale.
+	Digit = 0x20,
+	/// Space, \t, \n, \v, \f and \r; as per @c isspace in the C locale.
+	Space = 0x40,
+};
+
+namespace Private {
+
+constexpr auto classes = [] {
+	std::array<uint8_t, 256> table{};
+	for(int ch = 0; ch < 256; ch++) {
+		const bool digit = ch >= '0' && ch <= '9';
+		const bool alpha = (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z');
+
+		table[ch] =
+			(ch != '\n' ? Any : 0) |
+			(ch != '\n' && ch != '"' ? NotQuote : 0) |
+			(digit || alpha ? Alphanumeric : 0) |
+			(digit || alpha || ch == '_' ? ProcedureName : 0) |
+			(digit || (ch >= 'A' && ch <= 'F') ? HexDigit : 0) |
+			(digit ? Digit : 0) |
+			(ch == ' ' || (ch >= '\t' && ch <= '\r') ? Space : 0);
+	}
+	return table;
+} ();
+
+/// As per @c classes but with \r and \n removed from every class, for use when scanning runs.
+constexpr auto run_classes = [] {
+	auto table = classes;
+	table['\r'] = table['\n'] = 0;
+	return table;
+} ();
+
+}
+
+/// @returns @c true if @c ch is a member of class @c cls; @c false otherwise.
+template <Class cls>
+constexpr bool is(const char ch) {
+	return Private::classes[uint8_t(ch)] & cls;
+}
+
+/// @returns A pointer to the first character in [@c begin, @c end) that is a \r, a \n or is
+/// otherwise not in class @c cls; @c end if there is no such character.
+template <Class cls>
+constexpr const char *run_end_scalar(const char *begin, const char *const end) {
+	while(begin != end && (Private::run_classes[uint8_t(*begin)] & cls)) {
+		++begin;
+	}
+	return begin;
+}
+
+/// As per @c run_end_scalar but using SIMD where available for the classes that tend to be
+/// found in long runs: @c Any, @c NotQuote and @c Alphanumeric. At compile time, just as per @c run_end_scalar.
+template <Class cls>
+constexpr const char *run_end(const char *begin, const char *const end) {
+#if defined(__SSE2__)
+	if constexpr (cls == Any || cls == NotQuote || cls == Alphanumeric) {
+		if(std::is_constant_evaluated()) {
+			return run_end_scalar<cls>(begin, end);
+		}
+
+		const auto cr = _mm_set1_epi8('\r');
+		const auto lf = _mm_set1_epi8('\n');
+		const auto quote = _mm_set1_epi8('"');
+
+		while(end - begin >= 16) {
+			const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+
+			// Build a mask of characters that are in the class.
+			__m128i members;
+			if constexpr (cls == Alphanumeric) {
+				// Bytes above 0x7f are negative, so fall outside all of these signed ranges.
+				const auto in_range = [](const __m128i value, const char low, const char high) {
+					return _mm_and_si128(
+						_mm_cmpgt_epi8(value, _mm_set1_epi8(low - 1)),
+						_mm_cmplt_epi8(value, _mm_set1_epi8(high + 1)));
+				};
+				const auto lower_case = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+				members = _mm_or_si128(in_range(chars, '0', '9'), in_range(lower_case, 'a', 'z'));
+			} else {
+				auto stops = _mm_or_si128(_mm_cmpeq_epi8(chars, cr), _mm_cmpeq_epi8(chars, lf));
+				if constexpr (cls == NotQuote) {
+					stops = _mm_or_si128(stops, _mm_cmpeq_epi8(chars, quote));
+				}
+				members = _mm_cmpeq_epi8(stops, _mm_setzero_si128());
+			}
+
+			const auto non_members = ~_mm_movemask_epi8(members) & 0xffff;
+			if(non_members) {
+				return begin + std::countr_zero(unsigned(non_members));
+			}
+			begin += 16;
+		}
+	}
+#endif
+
+	return run_end_scalar<cls>(begin, end);
+}
+
+}
@@ -0,0 +1,440 @@
+#include "server.hpp"
+
+#include "thread_pool.hpp"
+#include "uef.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace Server {
+namespace {
+
+constexpr size_t RequestHeaderLength = 5;
+constexpr size_t ResponseHeaderLength = 5;
+constexpr uint8_t CompressFlag = 0x01;
+
+// Bounds the time for which a stalled client can occupy a worker.
+constexpr time_t SocketTimeout = 5;
+
+void put32(uint8_t *const destination, const uint32_t value) {
+	destination[0] = uint8_t(value >> 0);
+	destination[1] = uint8_t(value >> 8);
+	destination[2] = uint8_t(value >> 16);
+	destination[3] = uint8_t(value >> 24);
+}
+
+uint32_t get32(const uint8_t *const source) {
+	return uint32_t(source[0]) | (uint32_t(source[1]) << 8) | (uint32_t(source[2]) << 16) | (uint32_t(source[3]) << 24);
+}
+
+/// Reads exactly @c length bytes from @c fd.
+///
+/// @returns @c false if the input ended before any byte was read.
+/// @throws std::runtime_error if the input failed, or ended part way through.
+bool read_fully(const int fd, uint8_t *data, size_t length) {
+	const auto total = length;
+	while(length) {
+		const auto received = ::read(fd, data, length);
+		if(received < 0) {
+			if(errno == EINTR) continue;
+			throw std::runtime_error("Read failed");
+		}
+		if(!received) {
+			if(length == total) return false;
+			throw std::runtime_error("Truncated message");
+		}
+		data += received;
+		length -= size_t(received);
+	}
+	return true;
+}
+
+/// Writes all of @c vectors to @c fd, which may take several calls if the other end is slow.
+///
+/// @throws std::runtime_error if the output failed.
+void write_fully(const int fd, iovec *vectors, int count) {
+	while(count) {
+		const auto written = ::writev(fd, vectors, count);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			throw std::runtime_error("Write failed");
+		}
+
+		auto remaining = size_t(written);
+		while(count && remaining >= vectors->iov_len) {
+			remaining -= vectors->iov_len;
+			++vectors;
+			--count;
+		}
+		if(count) {
+			vectors->iov_base = static_cast<uint8_t *>(vectors->iov_base) + remaining;
+			vectors->iov_len -= remaining;
+		}
+	}
+}
+
+// MARK: - Requests and replies.
+
+struct Request {
+	std::string source;
+	bool compress = false;
+};
+
+/// @returns @c false if the input ended cleanly before a new request.
+/// @throws std::runtime_error if the request is malformed or too large.
+bool read_request(const int fd, Request &request) {
+	uint8_t header[RequestHeaderLength];
+	if(!read_fully(fd, header, sizeof(header))) {
+		return false;
+	}
+
+	const auto length = get32(header);
+	if(length > MaximumSourceLength) {
+		throw std::runtime_error("Request too large");
+	}
+	request.compress = header[4] & CompressFlag;
+	request.source.resize(length);
+	if(!read_fully(fd, reinterpret_cast<uint8_t *>(request.source.data()), length) && length) {
+		throw std::runtime_error("Truncated message");
+	}
+	return true;
+}
+
+struct Reply {
+	Reply(const Status status, std::vector<uint8_t> &&payload) : payload(std::move(payload)) {
+		header[0] = uint8_t(status);
+		put32(&header[1], uint32_t(this->payload.size()));
+	}
+
+	void send(const int fd) {
+		iovec vectors[] = {
+			{header, sizeof(header)},
+			{payload.data(), payload.size()},
+		};
+		write_fully(fd, vectors, 2);
+	}
+
+	uint8_t header[ResponseHeaderLength];
+	std::vector<uint8_t> payload;
+};
+
+Reply failure(const std::string &message) {
+	return Reply(Status::Failure, std::vector<uint8_t>(message.begin(), message.end()));
+}
+
+Reply respond(const Request &request) {
+	try {
+		return Reply(Status::Success, tokenise_to_uef(request.source, request.compress));
+	} catch(const Tokeniser::Error &error) {
+		std::vector<uint8_t> payload(5);
+		payload[0] = uint8_t(error.type);
+		put32(&payload[1], uint32_t(error.line_number));
+
+		const auto description = error.to_string();
+		payload.insert(payload.end(), description.begin(), description.end());
+		return Reply(Status::TokeniserError, std::move(payload));
+	} catch(const std::exception &error) {
+		return failure(error.what());
+	}
+}
+
+// MARK: - Socket connections.
+
+volatile sig_atomic_t stop_requested = 0;
+void request_stop(int) {
+	stop_requested = 1;
+}
+
+/// Collects connections that workers have finished with, to be returned to the poll loop.
+class Connections {
+public:
+	Connections() {
+		if(pipe2(wake_, O_CLOEXEC | O_NONBLOCK)) {
+			throw std::runtime_error("Unable to create pipe");
+		}
+	}
+
+	~Connections() {
+		for(const int fd: returned_) {
+			::close(fd);
+		}
+		::close(wake_[0]);
+		::close(wake_[1]);
+	}
+
+	/// The descriptor to poll for returned connections.
+	int wake() const {
+		return wake_[0];
+	}
+
+	void give_back(const int fd) {
+		{
+			std::lock_guard lock(mutex_);
+			returned_.push_back(fd);
+		}
+		const uint8_t byte = 0;
+		[[maybe_unused]] const auto written = ::write(wake_[1], &byte, 1);
+	}
+
+	/// Appends all returned connections to @c destination.
+	void take(std::vector<int> &destination) {
+		uint8_t bytes[64];
+		while(::read(wake_[0], bytes, sizeof(bytes)) > 0);
+
+		std::lock_guard lock(mutex_);
+		destination.insert(destination.end(), returned_.begin(), returned_.end());
+		returned_.clear();
+	}
+
+private:
+	int wake_[2];
+	std::mutex mutex_;
+	std::vector<int> returned_;
+};
+
+/// Answers a single request on @c fd, then returns it to @c connections or, if the client has
+/// gone or the request was unreadable, closes it.
+void serve_connection(const int fd, Connections &connections) {
+	try {
+		Request request;
+		if(read_request(fd, request)) {
+			respond(request).send(fd);
+			connections.give_back(fd);
+			return;
+		}
+	} catch(const std::exception &error) {
+		try {
+			failure(error.what()).send(fd);
+		} catch(const std::exception &) {}
+	}
+	::close(fd);
+}
+
+}
+
+void serve(const std::string &socket_path, const size_t threads) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if(socket_path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Socket path too long: " + socket_path);
+	}
+	memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+	// Replace a socket left behind by a previous run, but nothing else.
+	struct stat existing;
+	if(!lstat(socket_path.c_str(), &existing) && S_ISSOCK(existing.st_mode)) {
+		unlink(socket_path.c_str());
+	}
+
+	const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(
+		listener < 0 ||
+		bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) ||
+		listen(listener, SOMAXCONN)
+	) {
+		if(listener >= 0) ::close(listener);
+		throw std::runtime_error("Unable to listen on " + socket_path);
+	}
+
+	// Block the stop signals everywhere but in the poll below, so that workers
+	// inherit the block and the poll is reliably the thing interrupted.
+	signal(SIGPIPE, SIG_IGN);
+	struct sigaction action{};
+	action.sa_handler = request_stop;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	sigset_t stop_signals, previous, unblocked;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_signals, &previous);
+	unblocked = previous;
+	sigdelset(&unblocked, SIGINT);
+	sigdelset(&unblocked, SIGTERM);
+
+	Connections connections;
+	std::vector<int> idle;
+	{
+		ThreadPool pool(threads);
+		std::vector<pollfd> descriptors;
+		while(!stop_requested) {
+			descriptors.clear();
+			descriptors.push_back(pollfd{listener, POLLIN, 0});
+			descriptors.push_back(pollfd{connections.wake(), POLLIN, 0});
+			for(const int fd: idle) {
+				descriptors.push_back(pollfd{fd, POLLIN, 0});
+			}
+
+			if(ppoll(descriptors.data(), descriptors.size(), nullptr, &unblocked) < 0) {
+				continue;
+			}
+
+			// Hand connections with a request waiting, or that have closed, to the pool.
+			size_t still_idle = 0;
+			for(size_t c = 0; c < idle.size(); c++) {
+				if(descriptors[c + 2].revents) {
+					pool.submit([fd = idle[c], &connections] { serve_connection(fd, connections); });
+				} else {
+					idle[still_idle++] = idle[c];
+				}
+			}
+			idle.resize(still_idle);
+
+			if(descriptors[1].revents) {
+				connections.take(idle);
+			}
+
+			if(descriptors[0].revents) {
+				const int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+				if(client >= 0) {
+					const timeval timeout{SocketTimeout, 0};
+					setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+					setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+					idle.push_back(client);
+				}
+			}
+		}
+
+		// Leaving this scope completes all requests in progress.
+	}
+
+	for(const int fd: idle) {
+		::close(fd);
+	}
+	::close(listener);
+	unlink(socket_path.c_str());
+	pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+void serve(const int input, const int output, const size_t threads) {
+	signal(SIGPIPE, SIG_IGN);
+	ThreadPool pool(threads);
+
+	// Replies are queued in request order and written out by a separate thread as each
+	// completes; the queue length is capped so that a fast sender can't exhaust memory.
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::future<Reply>> replies;
+	const size_t limit = pool.size() * 2;
+	bool finished = false, output_failed = false;
+
+	std::thread writer([&] {
+		while(true) {
+			std::future<Reply> next;
+			{
+				std::unique_lock lock(mutex);
+				changed.wait(lock, [&] { return !replies.empty() || finished; });
+				if(replies.empty()) return;
+				next = std::move(replies.front());
+				replies.pop_front();
+			}
+			changed.notify_all();
+
+			try {
+				next.get().send(output);
+			} catch(const std::exception &) {
+				std::lock_guard lock(mutex);
+				output_failed = true;
+			}
+		}
+	});
+
+	while(true) {
+		Request request;
+		std::future<Reply> reply;
+		bool framing_lost = false;
+		try {
+			if(!read_request(input, request)) break;
+			reply = pool.submit([request = std::move(request)] { return respond(request); });
+		} catch(const std::exception &error) {
+			// There's no way to find the start of the next request.
+			std::promise<Reply> promise;
+			promise.set_value(failure(error.what()));
+			reply = promise.get_future();
+			framing_lost = true;
+		}
+
+		{
+			std::unique_lock lock(mutex);
+			changed.wait(lock, [&] { return replies.size() < limit || output_failed; });
+			if(output_failed) break;
+			replies.push_back(std::move(reply));
+		}
+		changed.notify_all();
+		if(framing_lost) break;
+	}
+
+	{
+		std::lock_guard lock(mutex);
+		finished = true;
+	}
+	changed.notify_all();
+	writer.join();
+}
+
+Response convert(const int fd, const std::string_view source, const bool compress) {
+	if(source.size() > MaximumSourceLength) {
+		throw std::runtime_error("Source too large");
+	}
+
+	uint8_t header[RequestHeaderLength];
+	put32(header, uint32_t(source.size()));
+	header[4] = compress ? CompressFlag : 0;
+	iovec vectors[] = {
+		{header, sizeof(header)},
+		{const_cast<char *>(source.data()), source.size()},
+	};
+	write_fully(fd, vectors, 2);
+
+	uint8_t response_header[ResponseHeaderLength];
+	if(!read_fully(fd, response_header, sizeof(response_header))) {
+		throw std::runtime_error("No response");
+	}
+	std::vector<uint8_t> payload(get32(&response_header[1]));
+	if(!read_fully(fd, payload.data(), payload.size()) && !payload.empty()) {
+		throw std::runtime_error("Truncated message");
+	}
+
+	Response response;
+	response.status = Status(response_header[0]);
+	switch(response.status) {
+		case Status::Success:
+			response.image = std::move(payload);
+		break;
+
+		case Status::TokeniserError:
+			if(payload.size() < 5) {
+				throw std::runtime_error("Malformed response");
+			}
+			response.error.type = Tokeniser::Error::Type(payload[0]);
+			response.error.line_number = int(get32(&payload[1]));
+			response.message.assign(payload.begin() + 5, payload.end());
+		break;
+
+		default:
+			response.message.assign(payload.begin(), payload.end());
+		break;
+	}
+	return response;
+}
+
+}
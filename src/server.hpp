@@ -0,0 +1,80 @@
+#pragma once
+
+#include "tokeniser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Implements a resident conversion server, so that clients which convert many programs
+	needn't pay for a process launch per conversion.
+
+	Requests and responses are framed identically whether they travel over a Unix domain
+	socket or stdin/stdout; all integers are little endian.
+
+	A request is:
+
+		uint32_t	length of source
+		uint8_t		flags; bit 0 requests gzip-compressed output
+		...			the BASIC source
+
+	A response is:
+
+		uint8_t		status; a value from Server::Status
+		uint32_t	length of payload
+		...			the payload
+
+	Upon success the payload is the UEF image. If tokenisation fails it is instead a
+	uint8_t Tokeniser::Error::Type and a uint32_t line number followed by a textual
+	description; upon any other failure it is just a textual description.
+
+	A socket client may send any number of requests over one connection, each being
+	answered before the next is read.
+*/
+
+namespace Server {
+
+enum class Status: uint8_t {
+	Success = 0,
+	TokeniserError = 1,
+	Failure = 2,
+};
+
+/// Requests larger than this are refused, and the connection closed.
+constexpr size_t MaximumSourceLength = 64 * 1024 * 1024;
+
+struct Response {
+	Status status = Status::Failure;
+
+	/// The UEF image, if @c status is @c Success.
+	std::vector<uint8_t> image;
+
+	/// The tokenisation failure, if @c status is @c TokeniserError.
+	Tokeniser::Error error{};
+
+	/// A description of the failure, if there was one.
+	std::string message;
+};
+
+/// Listens on a Unix domain socket at @c socket_path, replacing any existing socket there,
+/// and converts requests from any number of clients on a pool of @c threads workers,
+/// or one per hardware thread if @c threads is zero.
+///
+/// Returns upon SIGINT or SIGTERM, removing the socket.
+///
+/// @throws std::runtime_error if the socket can't be created.
+void serve(const std::string &socket_path, size_t threads);
+
+/// Reads requests from @c input and writes responses in the same order to @c output, converting
+/// up to @c threads requests concurrently, until @c input is exhausted.
+void serve(int input, int output, size_t threads);
+
+/// Sends a request for the conversion of @c source on @c fd and awaits the response.
+///
+/// @throws std::runtime_error if communication fails.
+Response convert(int fd, std::string_view source, bool compress = false);
+
+}
@@ -0,0 +1,294 @@
+#include "stats.hpp"
+
+#include "input.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace Stats {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds(const Clock::duration duration) {
+	return std::chrono::duration<double>(duration).count();
+}
+
+/// Collects the tokenised program in full.
+struct ProgramSink: public Tokeniser::Sink {
+	void append(const uint8_t *const begin, const uint8_t *const end) override {
+		program.insert(program.end(), begin, end);
+	}
+	std::vector<uint8_t> program;
+};
+
+/// Times CRC calculation.
+struct TimingBlockCache: public BlockCache {
+	CRC::ByteSwapped16 crc(uint16_t, const uint8_t *const begin, const uint8_t *const end) override {
+		const auto start = Clock::now();
+		const auto result = CRC::crc16(begin, end);
+		total += Clock::now() - start;
+		++blocks;
+		return result;
+	}
+
+	Clock::duration total{};
+	size_t blocks = 0;
+};
+
+/// Prints the "counters" member of a JSON report, with each event given in total and per byte.
+void print_counters_json(const Report &report) {
+	printf("\t\"counters\": {\n");
+	printf("\t\t\"available\": %s,\n", report.counted.empty() ? "false" : "true");
+	if(report.counted.empty()) {
+		printf("\t\t\"reason\": \"%s\"\n", report.counters_unavailable.c_str());
+	}
+	for(size_t c = 0; c < report.counted.size(); c++) {
+		const auto &phase = report.counted[c];
+		printf("\t\t\"%s\": {\"bytes\": %zu, \"seconds\": %.6f", phase.name, phase.bytes, phase.sample.seconds);
+		for(size_t event = 0; event < Counters::EventCount; event++) {
+			const auto name = Counters::name(Counters::Event(event));
+			if(!phase.sample.counted[event]) {
+				printf(", \"%s\": null, \"%s_per_byte\": null", name, name);
+				continue;
+			}
+			const auto count = phase.sample.counts[event];
+			printf(", \"%s\": %.0f, \"%s_per_byte\": %.4f", name, count, name, phase.bytes ? count / double(phase.bytes) : 0.0);
+		}
+		printf("}%s\n", c + 1 < report.counted.size() ? "," : "");
+	}
+	printf("\t},\n");
+}
+
+void print_counters(const Report &report) {
+	if(report.counted.empty()) {
+		printf("Counters unavailable, so timing only: %s\n", report.counters_unavailable.c_str());
+		return;
+	}
+
+	printf("Counters, per byte:\n");
+	printf("  %-10s", "");
+	for(size_t event = 0; event < Counters::EventCount; event++) {
+		printf(" %14s", Counters::name(Counters::Event(event)));
+	}
+	printf("\n");
+	for(const auto &phase: report.counted) {
+		printf("  %-10s", phase.name);
+		for(size_t event = 0; event < Counters::EventCount; event++) {
+			if(phase.sample.counted[event] && phase.bytes) {
+				printf(" %14.4f", phase.sample.counts[event] / double(phase.bytes));
+			} else {
+				printf(" %14s", "-");
+			}
+		}
+		printf("\n");
+	}
+}
+
+}
+
+double Report::conversion_seconds() const {
+	double total = 0.0;
+	for(const auto &phase: phases) {
+		if(std::string_view(phase.name) != "analysis") total += phase.seconds;
+	}
+	return total;
+}
+
+Report convert(
+	const std::string &input,
+	const std::string &output,
+	const bool compress,
+	ThreadPool *const pool,
+	Tokeniser::LineCache *const line_cache,
+	const TapeLayout &layout,
+	const Tokeniser::Dialect dialect,
+	const bool counters
+) {
+	Report report;
+	report.dialect = dialect;
+	report.counters = counters;
+
+	// Without any counters, fall back to timing alone.
+	std::optional<Counters::Group> group;
+	if(counters) {
+		group.emplace();
+		if(!group->available()) {
+			report.counters_unavailable = group->unavailable_reason();
+			group.reset();
+		}
+	}
+	const auto reading = [&] {
+		return group ? group->read() : Counters::Group::Reading();
+	};
+
+	// Touch every page so that the cost of reading a mapped file is counted here rather than
+	// during tokenisation.
+	auto start = Clock::now();
+	const auto source = input.empty() ? std::make_unique<InputBuffer>(stdin) : std::make_unique<InputBuffer>(input);
+	const auto view = source->view();
+	volatile char touched = 0;
+	for(size_t c = 0; c < view.size(); c += 4096) {
+		touched = touched + view[c];
+	}
+	report.bytes_in = view.size();
+	report.phases.push_back({"read", seconds(Clock::now() - start)});
+
+	auto events = reading();
+	start = Clock::now();
+	ProgramSink sink;
+	if(pool && !line_cache && !group) {
+		sink.program = Tokeniser::import(view, *pool, dialect);
+	} else {
+		sink.program.reserve(view.size());
+		Tokeniser::import(view, sink, line_cache, dialect);
+	}
+	const auto &program = sink.program;
+	report.phases.push_back({"tokenise", seconds(Clock::now() - start)});
+	if(group) {
+		report.counted.push_back({"tokenise", view.size(), group->since(events)});
+	}
+
+	// Block slicing is whatever remains of UEF construction once CRCs and output are discounted.
+	events = reading();
+	start = Clock::now();
+	Clock::duration output_time{};
+	TimingBlockCache crcs;
+	{
+		UEFWriter writer(output, compress);
+		writer.time_output(output_time);
+		writer.chunk(0x0000, "bas2uef v1.0");
+
+		UEFBlockStream blocks(writer, &crcs, layout);
+		blocks.append(program.data(), program.data() + program.size());
+		blocks.finish();
+		writer.close();
+	}
+	const auto construction = Clock::now() - start;
+	report.phases.push_back({"blocks", seconds(construction - crcs.total - output_time)});
+	report.phases.push_back({"crc", seconds(crcs.total)});
+	report.phases.push_back({"output", seconds(output_time)});
+	report.blocks = crcs.blocks;
+	if(group) {
+		const auto emission = group->since(events);
+
+		// Reading the counters around each block would cost about as much as its CRC, so CRCs are
+		// counted in a pass of their own over the same 256-byte blocks.
+		volatile uint16_t checksum = 0;
+		const auto crc = group->measure([&] {
+			for(size_t offset = 0; offset < program.size(); offset += 256) {
+				const auto end = std::min(program.size(), offset + 256);
+				checksum = checksum ^ uint16_t(CRC::crc16(program.data() + offset, program.data() + end));
+			}
+		});
+		report.counted.push_back({"crc", program.size(), crc});
+		report.counted.push_back({"uef", program.size(), emission});
+	}
+	report.bytes_out = std::filesystem::file_size(output);
+
+	start = Clock::now();
+	report.program = Tokeniser::analyse(program.data(), program.data() + program.size(), dialect);
+	report.phases.push_back({"analysis", seconds(Clock::now() - start)});
+
+	return report;
+}
+
+void print(const Report &report, const bool json) {
+	const auto &program = report.program;
+	const double tokenise_seconds = std::find_if(report.phases.begin(), report.phases.end(), [](const Phase &phase) {
+		return std::string_view(phase.name) == "tokenise";
+	})->seconds;
+	const double lines_per_second = tokenise_seconds > 0.0 ? double(program.lines) / tokenise_seconds : 0.0;
+
+	// List keywords by descending frequency, two-byte tokens alongside the rest.
+	struct Keyword {
+		uint8_t token;
+		std::optional<uint8_t> extension;
+		std::string_view name;
+		size_t count;
+	};
+	std::vector<Keyword> keywords;
+	for(size_t token = 0; token < program.tokens.size(); token++) {
+		if(program.tokens[token]) {
+			keywords.push_back({uint8_t(token), std::nullopt, Tokeniser::keyword(uint8_t(token), report.dialect), program.tokens[token]});
+		}
+	}
+	for(size_t prefix = 0; prefix < program.extended_tokens.size(); prefix++) {
+		for(size_t extension = 0; extension < program.extended_tokens[prefix].size(); extension++) {
+			const auto count = program.extended_tokens[prefix][extension];
+			if(!count) continue;
+			const auto token = uint8_t(0xc6 + prefix);
+			keywords.push_back({token, uint8_t(extension), Tokeniser::keyword(token, uint8_t(extension), report.dialect), count});
+		}
+	}
+	std::stable_sort(keywords.begin(), keywords.end(), [](const Keyword &lhs, const Keyword &rhs) {
+		return lhs.count > rhs.count;
+	});
+
+	if(json) {
+		printf("{\n");
+		printf("\t\"phases\": {\n");
+		for(size_t c = 0; c < report.phases.size(); c++) {
+			printf("\t\t\"%s\": %.6f%s\n", report.phases[c].name, report.phases[c].seconds, c + 1 < report.phases.size() ? "," : "");
+		}
+		printf("\t},\n");
+		if(report.counters) {
+			print_counters_json(report);
+		}
+		printf("\t\"conversion_seconds\": %.6f,\n", report.conversion_seconds());
+		printf("\t\"lines\": %zu,\n", program.lines);
+		printf("\t\"lines_per_second\": %.1f,\n", lines_per_second);
+		printf("\t\"bytes_in\": %zu,\n", report.bytes_in);
+		printf("\t\"bytes_out\": %zu,\n", report.bytes_out);
+		printf("\t\"blocks\": %zu,\n", report.blocks);
+		printf("\t\"untokenised_conditionals\": %zu,\n", program.untokenised_conditionals);
+		printf("\t\"keywords\": [\n");
+		for(size_t c = 0; c < keywords.size(); c++) {
+			const auto &keyword = keywords[c];
+			printf("\t\t{\"token\": %d, ", keyword.token);
+			if(keyword.extension) {
+				printf("\"extension\": %d, ", *keyword.extension);
+			}
+			printf("\"keyword\": \"%.*s\", \"count\": %zu}%s\n",
+				int(keyword.name.size()), keyword.name.data(), keyword.count, c + 1 < keywords.size() ? "," : "");
+		}
+		printf("\t]\n");
+		printf("}\n");
+		return;
+	}
+
+	printf("Phases:\n");
+	for(const auto &phase: report.phases) {
+		printf("  %-10s %10.3f ms\n", phase.name, phase.seconds * 1000.0);
+	}
+	printf("  %-10s %10.3f ms, excluding analysis\n", "total", report.conversion_seconds() * 1000.0);
+	if(report.counters) {
+		print_counters(report);
+	}
+	printf("Lines: %zu, tokenised at %.0f lines/s\n", program.lines, lines_per_second);
+	printf("Bytes in: %zu, bytes out: %zu\n", report.bytes_in, report.bytes_out);
+	printf("Blocks: %zu\n", report.blocks);
+	printf("Untokenised conditional keywords: %zu\n", program.untokenised_conditionals);
+	printf("Keywords:\n");
+	// Two-byte tokens are listed as both bytes, widening the column only if there are any.
+	const bool extended = std::any_of(keywords.begin(), keywords.end(), [](const Keyword &keyword) {
+		return keyword.extension.has_value();
+	});
+	for(const auto &keyword: keywords) {
+		char token[8];
+		if(keyword.extension) {
+			snprintf(token, sizeof(token), "&%02X&%02X", keyword.token, *keyword.extension);
+		} else {
+			snprintf(token, sizeof(token), "&%02X", keyword.token);
+		}
+		printf("  %-*s %-8.*s %zu\n", extended ? 6 : 3, token, int(keyword.name.size()), keyword.name.data(), keyword.count);
+	}
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "counters.hpp"
+#include "tokeniser.hpp"
+#include "uef.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+	Supports conversion with each phase timed separately, for the --stats option.
+
+	Ordinary conversion interleaves tokenisation, block slicing, CRC calculation and output;
+	here the program is tokenised in full before any blocks are formed, so that the first two
+	can be timed apart, and CRC calculation and output are timed from within block slicing by
+	way of the existing BlockCache and UEFWriter hooks. Ordinary conversion is unaffected.
+
+	Hardware counters, if requested, cover tokenisation, CRC calculation and UEF emission,
+	the last being the whole of block slicing, CRC calculation and output. CRCs are counted
+	in a separate pass over the program's blocks, as reading the counters around each block
+	would cost about as much as the CRC itself.
+*/
+
+namespace Stats {
+
+struct Phase {
+	const char *name;
+	double seconds = 0.0;
+};
+
+/// Hardware events counted during one phase of conversion.
+struct CountedPhase {
+	const char *name;
+
+	/// The amount of input to the phase: source text for tokenisation, the tokenised program otherwise.
+	size_t bytes = 0;
+	Counters::Sample sample;
+};
+
+struct Report {
+	/// Every phase, in the order performed. Analysis of the tokenised program, which
+	/// collects the keyword statistics, isn't part of conversion and is timed last.
+	std::vector<Phase> phases;
+
+	size_t bytes_in = 0;
+	size_t bytes_out = 0;
+	size_t blocks = 0;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+	Tokeniser::Statistics program;
+
+	/// Whether hardware counters were requested; if so then either @c counted holds a phase for
+	/// each of tokenisation, CRC calculation and UEF emission, or @c counters_unavailable
+	/// explains why the kernel didn't allow them.
+	bool counters = false;
+	std::vector<CountedPhase> counted;
+	std::string counters_unavailable;
+
+	/// @returns The total time taken by conversion, excluding analysis.
+	double conversion_seconds() const;
+};
+
+/// Converts the program in @c input, or on stdin if @c input is empty, to a UEF image in
+/// @c output with the same result as @c tokenise_to_uef, timing each phase.
+///
+/// @param pool If supplied, the threads on which to tokenise; ignored if @c line_cache is supplied
+/// or if @c counters is @c true, as counters follow only the calling thread.
+/// @param counters If @c true then hardware events are counted as well, where the kernel allows.
+/// @throws Tokeniser::Error if the input can't be tokenised; std::runtime_error if the input
+/// can't be read or the output can't be written.
+Report convert(
+	const std::string &input,
+	const std::string &output,
+	bool compress,
+	ThreadPool *pool = nullptr,
+	Tokeniser::LineCache *line_cache = nullptr,
+	const TapeLayout &layout = TapeLayout(),
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2,
+	bool counters = false);
+
+/// Prints @c report to stdout, as JSON if @c json is @c true or for people otherwise.
+void print(const Report &report, bool json);
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Implements a work-stealing thread pool.
+///
+/// Each worker owns a queue; tasks submitted from a worker go to the back of its own queue and
+/// are taken from there in LIFO order, while tasks submitted from elsewhere are dealt out in turn.
+/// A worker with an empty queue steals from the front of the others.
+class ThreadPool {
+public:
+	/// Starts @c threads workers, or one per hardware thread if @c threads is zero.
+	explicit ThreadPool(size_t threads = 0) {
+		if(!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+		for(size_t c = 0; c < threads; c++) {
+			queues_.push_back(std::make_unique<Queue>());
+		}
+		for(size_t c = 0; c < threads; c++) {
+			workers_.emplace_back([this, c] { run(c); });
+		}
+	}
+
+	/// Completes all outstanding tasks and then stops the workers.
+	~ThreadPool() {
+		{
+			std::lock_guard lock(wake_mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_all();
+		for(auto &worker: workers_) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator =(const ThreadPool &) = delete;
+
+	size_t size() const {
+		return workers_.size();
+	}
+
+	/// Schedules @c function for execution.
+	///
+	/// @returns A future that will hold the result of @c function, or whatever it throws.
+	template <typename FunctionT>
+	auto submit(FunctionT &&function) -> std::future<std::invoke_result_t<FunctionT>> {
+		using ResultT = std::invoke_result_t<FunctionT>;
+		auto task = std::make_shared<std::packaged_task<ResultT()>>(std::forward<FunctionT>(function));
+		auto result = task->get_future();
+
+		const auto index = worker_index_ != NoWorker && worker_pool_ == this ?
+			worker_index_ : next_queue_++ % queues_.size();
+		{
+			std::lock_guard lock(queues_[index]->mutex);
+			queues_[index]->tasks.emplace_back([task] { (*task)(); });
+		}
+		{
+			std::lock_guard lock(wake_mutex_);
+			++pending_;
+		}
+		wake_.notify_one();
+
+		return result;
+	}
+
+private:
+	using Task = std::function<void()>;
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	static constexpr size_t NoWorker = ~size_t(0);
+	static inline thread_local size_t worker_index_ = NoWorker;
+	static inline thread_local const ThreadPool *worker_pool_ = nullptr;
+
+	bool pop(const size_t index, Task &task) {
+		// Prefer the most recent addition to this worker's own queue.
+		{
+			auto &queue = *queues_[index];
+			std::lock_guard lock(queue.mutex);
+			if(!queue.tasks.empty()) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				return true;
+			}
+		}
+
+		// Otherwise steal the oldest task from elsewhere.
+		for(size_t offset = 1; offset < queues_.size(); offset++) {
+			auto &queue = *queues_[(index + offset) % queues_.size()];
+			std::lock_guard lock(queue.mutex);
+			if(!queue.tasks.empty()) {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run(const size_t index) {
+		worker_index_ = index;
+		worker_pool_ = this;
+
+		while(true) {
+			{
+				std::unique_lock lock(wake_mutex_);
+				wake_.wait(lock, [this] { return pending_ || stopping_; });
+				if(!pending_) return;
+				--pending_;
+			}
+
+			// Tasks are enqueued before pending_ is incremented, so every unit claimed from
+			// pending_ is backed by a task in some queue.
+			Task task;
+			while(!pop(index, task)) {
+				std::this_thread::yield();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<size_t> next_queue_ = 0;
+
+	std::mutex wake_mutex_;
+	std::condition_variable wake_;
+	size_t pending_ = 0;
+	bool stopping_ = false;
+};
@@ -1,460 +1,157 @@
 #include "tokeniser.hpp"
-#include "trie.hpp"
+#include "importer.hpp"
+#include "input.hpp"
+#include "thread_pool.hpp"
 
 #include <algorithm>
-#include <cctype>
 #include <cstdio>
-#include <functional>
+#include <future>
+#include <optional>
+#include <string_view>
 #include <vector>
-#include <string>
 
 /*
-	Implements parsing of BBC BASIC v2.
-
-	Heavily based on the descriptions provided by Mark Plumbley in
-	BASIC ROM User Guide, ISBN 0 947929 04 5, section 2.3.
+	Provides the entry points to tokenisation, which is implemented by Private::Importer.
 */
 
 namespace Tokeniser {
 namespace {
 
-enum Flags: uint8_t {
-	PseudoVariable = 0x40,
-	REM = 0x20,
-	LineNumber = 0x10,
-	FNProc = 0x08,
-	Start = 0x04,
-	Middle = 0x02,
-	Conditional = 0x01
-};
-struct Keyword {
-	uint8_t token = 0;
-	uint8_t flags = 0;
-};
-
-const Trie<char, Keyword> tokens = {
-	{"AND",			{0x80}},
-	{"DIV",			{0x81}},
-	{"EOR",			{0x82}},
-	{"MOD",			{0x83}},
-	{"OR",			{0x84}},
-	{"ERROR",		{0x85, Start}},
-	{"LINE",		{0x86}},
-	{"OFF",			{0x87}},
-	{"STEP",		{0x88}},
-	{"SPC",			{0x89}},
-	{"TAB(",		{0x8a}},
-	{"ELSE",		{0x8b, LineNumber | Start}},
-	{"THEN",		{0x8c, LineNumber | Start}},
-	{"OPENIN",		{0x8e}},
-	{"PTR",			{0x8f, PseudoVariable | Middle | Conditional}},
-	{"PAGE",		{0x90, PseudoVariable | Middle | Conditional}},
-	{"TIME",		{0x91, PseudoVariable | Middle | Conditional}},
-	{"LOMEM",		{0x92, PseudoVariable | Middle | Conditional}},
-	{"HIMEM",		{0x93, PseudoVariable | Middle | Conditional}},
-	{"ABS",			{0x94}},
-	{"ACS",			{0x95}},
-	{"ADVAL",		{0x96}},
-	{"ASC",			{0x97}},
-	{"ASN",			{0x98}},
-	{"ATN",			{0x99}},
-	{"BGET",		{0x9a, Conditional}},
-	{"COS",			{0x9b}},
-	{"COUNT",		{0x9c, Conditional}},
-	{"DEG",			{0x9d}},
-	{"ERL",			{0x9e, Conditional}},
-	{"ERR",			{0x9f, Conditional}},
-	{"EVAL",		{0xa0}},
-	{"EXP",			{0xa1}},
-	{"EXT",			{0xa2, Conditional}},
-	{"FALSE",		{0xa3, Conditional}},
-	{"FN",			{0xa4, FNProc}},
-	{"GET",			{0xa5}},
-	{"INKEY",		{0xa6}},
-	{"INSTR(",		{0xa7}},
-	{"INT",			{0xa8}},
-	{"LEN",			{0xa9}},
-	{"LN",			{0xaa}},
-	{"LOG",			{0xab}},
-	{"NOT",			{0xac}},
-	{"OPENUP",		{0xad}},
-	{"OPENOUT",		{0xae}},
-	{"PI",			{0xaf, Conditional}},
-	{"POINT(",		{0xb0}},
-	{"POS",			{0xb1, Conditional}},
-	{"RAD",			{0xb2}},
-	{"RND",			{0xb3, Conditional}},
-	{"SGN",			{0xb4}},
-	{"SIN",			{0xb5}},
-	{"SQR",			{0xb6}},
-	{"TAN",			{0xb7}},
-	{"TO",			{0xb8}},
-	{"TRUE",		{0xb9, Conditional}},
-	{"USR",			{0xba}},
-	{"VAL",			{0xbb}},
-	{"VPOS",		{0xbc, Conditional}},
-	{"CHR$",		{0xbd}},
-	{"GET$",		{0xbe}},
-	{"INKEY$",		{0xbf}},
-	{"LEFT$(",		{0xc0}},
-	{"MID$(",		{0xc1}},
-	{"RIGHT$(",		{0xc2}},
-	{"STR$",		{0xc3}},
-	{"STRING$(",	{0xc4}},
-	{"EOF",			{0xc5, Conditional}},
-	{"AUTO",		{0xc6, LineNumber}},
-	{"DELETE",		{0xc7, LineNumber}},
-	{"LOAD",		{0xc8, Middle}},
-	{"LIST",		{0xc9, LineNumber}},
-	{"NEW",			{0xca, Conditional}},
-	{"OLD",			{0xcb, Conditional}},
-	{"RENUMBER",	{0xcc, LineNumber}},
-	{"SAVE",		{0xcd, Middle}},
-	{"PTR",			{0xcf}},
-	{"PAGE",		{0xd0}},
-	{"TIME",		{0xd1}},
-	{"LOMEM",		{0xd2}},
-	{"HIMEM",		{0xd3}},
-	{"SOUND",		{0xd4, Middle}},
-	{"BPUT",		{0xd5, Middle | Conditional}},
-	{"CALL",		{0xd6, Middle}},
-	{"CHAIN",		{0xd7, Middle}},
-	{"CLEAR",		{0xd8, Conditional}},
-	{"CLOSE",		{0xd9, Middle | Conditional}},
-	{"CLG",			{0xda, Conditional}},
-	{"CLS",			{0xdb, Conditional}},
-	{"DATA",		{0xdc, REM}},
-	{"DEF",			{0xdd}},
-	{"DIM",			{0xde, Middle}},
-	{"DRAW",		{0xdf, Middle}},
-	{"END",			{0xe0, Conditional}},
-	{"ENDPROC",		{0xe1, Conditional}},
-	{"ENVELOPE",	{0xe2, Middle}},
-	{"ENVELOPE",	{0xe2, Middle}},
-	{"FOR",			{0xe3, Middle}},
-	{"GOSUB",		{0xe4, LineNumber | Middle}},
-	{"GOTO",		{0xe5, LineNumber | Middle}},
-	{"GCOL",		{0xe6, Middle}},
-	{"IF",			{0xe7, Middle}},
-	{"INPUT",		{0xe8, Middle}},
-	{"LET",			{0xe9, Start}},
-	{"LOCAL",		{0xea, Middle}},
-	{"MODE",		{0xeb, Middle}},
-	{"MOVE",		{0xec, Middle}},
-	{"NEXT",		{0xed, Middle}},
-	{"ON",			{0xee, Middle}},
-	{"VDU",			{0xef, Middle}},
-	{"PLOT",		{0xf0, Middle}},
-	{"PRINT",		{0xf1, Middle}},
-	{"PROC",		{0xf2, FNProc | Middle}},
-	{"READ",		{0xf3, Middle}},
-	{"REM",			{0xf4, REM}},
-	{"REPEAT",		{0xf5}},
-	{"REPORT",		{0xf6, Conditional}},
-	{"RESTORE",		{0xf7, LineNumber | Middle}},
-	{"RETURN",		{0xf8, Conditional}},
-	{"RUN",			{0xf9, Conditional}},
-	{"STOP",		{0xfa, Conditional}},
-	{"COLOUR",		{0xfb, Middle}},
-	{"TRACE",		{0xfc, LineNumber | Middle}},
-	{"UNTIL",		{0xfd, Middle}},
-	{"WIDTH",		{0xfe, Middle}},
-	{"OSCLI",		{0xff, Middle}},
-};
-
-struct Importer {
-	Importer(FILE *const input) : input_(input) {
-		result.reserve(32768);
+using Private::Importer;
+
+/// Calls @c function with the description of @c dialect from @c Dialects, so that it can
+/// specialise upon it.
+template <typename FunctionT>
+auto with_dialect(const Dialect dialect, const FunctionT &function) {
+	switch(dialect) {
+		default:
+		case Dialect::BASIC2:	return function(Dialects::BASIC2());
+		case Dialect::BASIC4:	return function(Dialects::BASIC4());
+		case Dialect::BASIC5:	return function(Dialects::BASIC5());
 	}
+}
 
-	std::vector<uint8_t> tokenise() {
-		// Outer loop for tokenising one line at a time.
-		while(!feof(input_)) {
-			// Get line number.
-			const auto line_number = read_line_number(false);
-			if(line_number < 0) break;
-
-			// Write start of line, including line number.
-			result.insert(result.end(), {
-				0x0d,
-				uint8_t(line_number >> 8),
-				uint8_t(line_number >> 0)
-			});
-
-			// Reserve a spot for line length.
-			const auto size_position = result.size();
-			result.push_back(0);
-
-			// Encode line.
-			tokenise_line();
-
-			// Set line length.
-			const auto line_length = 3 + result.size() - size_position;
-			if(line_length >= 255) throw_error(Error::Type::LineTooLong);
-			result[size_position] = uint8_t(line_length);
-		}
-
-		// Store program terminator.
-		result.insert(result.end(), {
-			0x0d, 0xff
-		});
-
-		return result;
+struct VectorSink: public Sink {
+	void append(const uint8_t *const begin, const uint8_t *const end) override {
+		result.insert(result.end(), begin, end);
 	}
+	std::vector<uint8_t> result;
+};
+}
 
-private:
-	void tokenise_line() {
-		bool statement_start = true;
-
-		while(!feof(input_)) {
-			// Check for a new token.
-			std::string input_text;
-			auto node = &tokens;
-
-			const decltype (tokens) *last_found = nullptr;
-			size_t last_found_depth = 0;
-			while(true) {
-				// Keep track of last node that represented a complete token.
-				if(node->value()) {
-					last_found = node;
-					last_found_depth = input_text.size();
-				}
-
-				// Keep a copy of characters encountered to get to the current state,
-				// in case a conditional token is found and isn't ultimately tokenised.
-				const auto ch = next();
-				input_text.push_back(ch);
-
-				// Search should find the longest token that matches
-				// so don't stop until a dead-end is found.
-				const auto next_node = node->find(ch);
-				if(!next_node) {
-					// Retreat to the last observed match, if any.
-					node = last_found;
-					replace(input_text.substr(last_found_depth));
-					input_text = input_text.substr(0, last_found_depth);
-					break;
-				}
-
-				// Keep searching.
-				node = next_node;
-			}
-
-			// If a token was found and is conditional, check whether to tokenise.
-			if(node && node->value()->flags & Flags::Conditional) {
-				const auto ch = next();
-				if(isalnum(ch)) {
-					// Don't treat as a token then. Recover the text of this token and then copy in
-					// as many alphanumerics as follow.
-					std::copy(input_text.begin(), input_text.end(), std::back_inserter(result));
-					copy_while(isalnum);
-					continue;
-				}
-				replace(ch);
-			}
-
-			if(node) {
-				const auto &keyword = *node->value();
-				result.push_back(keyword.token);
-
-				if(keyword.flags & Flags::FNProc) {
-					// Copy all alphanumerics (and underscores?)
-					copy_while([](const int ch) { return isalnum(ch) || ch == '_'; });
-				}
-
-				if(keyword.flags & Flags::LineNumber) {
-					// Means only that a line number *might* be next.
-					copy_while(isspace);
-					const auto ch = next();
-					replace(ch);
-					if(isdigit(ch)) {
-						tokenise_line_number();
-					}
-				}
-
-				if(keyword.flags & Flags::REM) {
-					// Copy rest of line without tokenisation.
-					copy_while([](int) { return true; });
-				}
-
-				if(statement_start && (keyword.flags & Flags::PseudoVariable)) {
-					// Adjust token; if it was at the start and is a pseudo-variable then it should
-					// be encoded as its function not its statement. Which is achieved by adding $40.
-					result.back() += 0x40;
-				}
-
-				statement_start &= !(keyword.flags & Flags::Middle);
-				statement_start |= keyword.flags & Flags::Start;
-				continue;
-			}
-
-			// If here: no token was found. So copy at least one character
-			// from the input and possibly more.
-			const auto ch = next();
-			if(ch == '\n') return;
-			result.push_back(ch);
-
-			// Treat any non-token as ending start-of-statement mode.
-			// E.g. this avoids the risk of `LET A = 10 * PI:PRINT` still thinking it's
-			// in start-of-statement mode when it reaches the asterisk and then copying
-			// the rest of the line verbatim rather than tokenising PI and PRINT.
-			const bool was_start = statement_start;
-			statement_start = false;
-			switch(ch) {
-				case ':':
-					// Go back into start mode after each colon.
-					statement_start = true;
-				break;
+void import(const std::string_view input, Sink &sink, LineCache *const cache, const Dialect dialect) {
+	with_dialect(dialect, [&](const auto description) {
+		Importer<decltype(description)>(input, sink, cache).tokenise();
+	});
+}
 
-				case '*':
-					// If a * is encountered while in start mode, blindly copy from it to
-					// the end of the line.
-					if(was_start) {
-						copy_while([](int) { return true; });
-					}
-				break;
+std::vector<uint8_t> import(const std::string_view input, const Dialect dialect) {
+	VectorSink sink;
+	sink.result.reserve(32768);
+	import(input, sink, nullptr, dialect);
+	return std::move(sink.result);
+}
 
-				case '"':
-					// Copy an entire string.
-					if(copy_while([](const int ch) { return ch != '"'; }) != ExitReason::Predicate) {
-						throw_error(Error::Type::BadStringLiteral);
-					}
-					// Copy the closing quotation mark.
-					result.push_back(next());
-				break;
+std::vector<Error> diagnose(const std::string_view input, Sink &sink, const Dialect dialect) {
+	std::vector<Error> errors;
+	with_dialect(dialect, [&](const auto description) {
+		Importer<decltype(description)>(input, sink, nullptr, true, &errors).tokenise();
+	});
+	return errors;
+}
 
-				case '&':
-					// Copy an entire hex number.
-					copy_while([](const int ch) {
-						return
-							(ch >= '0' && ch <= '9') ||
-							(ch >= 'A' && ch <= 'F');
-					});
-				break;
+Diagnosis diagnose(const std::string_view input, const Dialect dialect) {
+	VectorSink sink;
+	sink.result.reserve(32768);
+	auto errors = diagnose(input, sink, dialect);
+	return Diagnosis{std::move(sink.result), std::move(errors)};
+}
 
-				default:
-					// If this is a variable name or number, copy it all.
-					if(isalnum(ch)) {
-						copy_while(isalnum);
-					}
-				break;
-			}
-		}
+std::vector<uint8_t> import(const std::string_view input, ThreadPool &pool, const Dialect dialect) {
+	// Inputs too small to be worth dividing are just tokenised directly.
+	constexpr size_t MinimumChunkSize = 64 * 1024;
+	const size_t chunk_count = std::min(pool.size() * 4, input.size() / MinimumChunkSize);
+	if(chunk_count < 2) {
+		return import(input, dialect);
 	}
 
-	int read_line_number(const bool retain_whitespace) {
-		// Consume whitespace, possibly copying it.
-		if(retain_whitespace) {
-			copy_while(isspace);
-		} else {
-			consume(isspace, [](char) {});
-		}
-
-		// Allow an empty final line.
-		if(feof(input_) && !retain_whitespace) {
-			return -1;
-		}
-
-		// Perform validity check.
-		const auto ch = next();
-		if(!isdigit(ch)) {
-			throw_error(Error::Type::BadLineNumber);
-		}
-		replace(ch);
-
-		// Obtain line number, but throw it goes out of bounds.
-		int line_number = 0;
-		consume(isdigit, [&](const char num) {
-			line_number = (line_number * 10) + (num - '0');
-			if(line_number > 32767) {
-				throw_error(Error::Type::BadLineNumber);
-			}
-		});
-		return line_number;
+	// Divide the input into chunks, each beginning just after a newline. Tokenisation picks up
+	// at each newline in the same state regardless of what came before, so each chunk tokenises
+	// exactly as it would have serially.
+	std::vector<size_t> boundaries{0};
+	for(size_t c = 1; c < chunk_count; c++) {
+		const auto target = std::max(boundaries.back(), c * input.size() / chunk_count);
+		const auto newline = input.find('\n', target);
+		if(newline == std::string_view::npos) break;
+		if(newline + 1 > boundaries.back()) boundaries.push_back(newline + 1);
 	}
+	boundaries.push_back(input.size());
+	const auto chunks = boundaries.size() - 1;
 
-	void tokenise_line_number() {
-		// $8d is the token for a line number; the three subsequent bytes all have
-		// 01 as their top two bits and some other portion of the original bits beneath.
-		// Bit 6 of both bytes of the target line number is inverted.
-
-		const int number = read_line_number(true) ^ 0b0100'0000'0100'0000;
-		const auto high = uint8_t(number >> 8);
-		const auto low = uint8_t(number);
-
-		result.push_back(0x8d);
-		result.push_back(0b0100'0000 | ((low & 0b1100'0000) >> 2) | ((high & 0b1100'0000) >> 4));
-		result.push_back(0b0100'0000 | (low & 0b0011'1111));
-		result.push_back(0b0100'0000 | (high & 0b0011'1111));
-	}
+	// Tokenise each chunk into a buffer of its own.
+	struct Chunk {
+		VectorSink sink;
+		std::optional<Error> error;
+	};
+	std::vector<Chunk> outputs(chunks);
+	const auto tokenise = [&](const size_t index) {
+		auto &chunk = outputs[index];
+		chunk.sink.result.reserve(boundaries[index + 1] - boundaries[index]);
+		try {
+			with_dialect(dialect, [&](const auto description) {
+				Importer<decltype(description)>(
+					input.substr(boundaries[index], boundaries[index + 1] - boundaries[index]),
+					chunk.sink,
+					nullptr,
+					index == chunks - 1
+				).tokenise();
+			});
+		} catch(const Error &error) {
+			chunk.error = error;
+		}
+	};
 
-	void replace(const std::string &n) {
-		for(const auto c: n) source_line_ -= c == '\n';
-		next_.insert(next_.end(), n.rbegin(), n.rend());
+	std::vector<std::future<void>> tasks;
+	for(size_t c = 0; c < chunks; c++) {
+		tasks.push_back(pool.submit([&tokenise, c] { tokenise(c); }));
 	}
-
-	void replace(const char n) {
-		source_line_ -= n == '\n';
-		next_.push_back(n);
+	for(auto &task: tasks) {
+		task.get();
 	}
 
-	char next() {
-		if(!next_.empty()) {
-			const auto n = next_.back();
-			next_.pop_back();
-			source_line_ += n == '\n';
-			return n;
+	// The first error in input order is the one that the serial path would have thrown; its
+	// line number needs offsetting by the number of lines that precede its chunk.
+	for(size_t c = 0; c < chunks; c++) {
+		if(outputs[c].error) {
+			auto error = *outputs[c].error;
+			error.line_number += int(std::count(input.begin(), input.begin() + ptrdiff_t(boundaries[c]), '\n'));
+			throw error;
 		}
-
-		// Read a character from the file, ignoring \r and
-		// keeping track of the current line.
-		int next = 0;
-		do {
-			next = fgetc(input_);
-		} while(next == '\r');
-		if(feof(input_)) return 0;
-
-		source_line_ += next == '\n';
-		return static_cast<char>(next);
 	}
 
-	void throw_error(Error::Type type) const {
-		throw Error{type, source_line_};
+	// Place each chunk's output at its prefix-summed offset, copying concurrently. This second copy
+	// of the output remains because no chunk's size is known until it has been tokenised, and
+	// tokens can occupy more bytes than their source, e.g. line numbers after GOTO, so chunks
+	// can't be tokenised straight into place without a pass to size them first.
+	std::vector<size_t> offsets(chunks + 1, 0);
+	for(size_t c = 0; c < chunks; c++) {
+		offsets[c + 1] = offsets[c] + outputs[c].sink.result.size();
 	}
+	std::vector<uint8_t> result(offsets.back());
 
-	enum class ExitReason {
-		EndOfLine,
-		EndOfFile,
-		Predicate,
-	};
-	ExitReason consume(const std::function<int(int)> &predicate, const std::function<void(char)> &consumer) {
-		while(true) {
-			char ch = next();
-			if(feof(input_)) return ExitReason::EndOfFile;
-			if(ch == '\n') {
-				replace(ch);
-				return ExitReason::EndOfLine;
-			}
-			if(!predicate(ch)) {
-				replace(ch);
-				return ExitReason::Predicate;
-			}
-			consumer(ch);
-		}
+	tasks.clear();
+	for(size_t c = 0; c < chunks; c++) {
+		tasks.push_back(pool.submit([&, c] {
+			std::copy(outputs[c].sink.result.begin(), outputs[c].sink.result.end(), result.begin() + ptrdiff_t(offsets[c]));
+		}));
 	}
-
-	ExitReason copy_while(const std::function<int(int)> &predicate) {
-		return consume(predicate, [&](char ch) { result.push_back(ch);});
+	for(auto &task: tasks) {
+		task.get();
 	}
-
-	std::vector<uint8_t> result;
-	FILE *input_;
-	std::string next_;
-	int source_line_ = 1;
-};
+	return result;
 }
 
 std::vector<uint8_t> import(FILE *const input) {
-	return Importer(input).tokenise();
-}
+	return import(InputBuffer(input).view());
+}
 }
@@ -1,11 +1,27 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <string>
-#include <vector>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
 
 namespace Tokeniser {
 
+/// The versions of BBC BASIC whose keywords can be tokenised.
+enum class Dialect {
+	/// BASIC 2, of the BBC Micro and Electron.
+	BASIC2,
+	/// BASIC IV, of the Master 128: adds EDIT.
+	BASIC4,
+	/// BASIC V, of RISC OS: adds structured statements such as CASE and WHILE, and two-byte tokens.
+	BASIC5,
+};
+
 struct Error {
 	enum class Type {
 		NoLineNumber,
@@ -30,9 +46,115 @@ struct Error {
 	}
 };
 
+/// Receives tokenised output as it is produced.
+struct Sink {
+	constexpr virtual ~Sink() = default;
+
+	/// Receives the next portion of output: either a single complete line or, finally, the program terminator.
+	virtual void append(const uint8_t *begin, const uint8_t *end) = 0;
+};
+
+/// Allows the tokenised forms of lines to be reused from an earlier tokenisation.
+///
+/// Each line is tokenised independently of those around it, so the tokenised form of a line that
+/// ends in a newline depends only on its own text: everything after its line number, up to but
+/// excluding the newline.
+struct LineCache {
+	virtual ~LineCache() = default;
+
+	/// Appends the tokenised form of @c line to @c destination if it is known.
+	///
+	/// @returns @c true if @c destination was appended to; @c false otherwise.
+	virtual bool find(std::string_view line, std::vector<uint8_t> &destination) = 0;
+
+	/// Records that @c line tokenises to the bytes from @c begin to @c end.
+	virtual void store(std::string_view line, const uint8_t *begin, const uint8_t *end) = 0;
+};
+
+/// Tokenises the textual BASIC program found in @c source, supplying the result to @c sink one line at a time.
+///
+/// @param source The complete text of a BBC BASIC program.
+/// @param sink The recipient of tokenised output.
+/// @param cache If supplied, a source of lines previously tokenised and a store for those newly tokenised.
+/// @param dialect The version of BASIC whose keywords to recognise.
+/// @throws An instance of @c Error if any problem is encountered; @c sink will already have received all lines prior to the error.
+void import(std::string_view source, Sink &sink, LineCache *cache = nullptr, Dialect dialect = Dialect::BASIC2);
+
+/// Returns a tokenised version of the textual BASIC program found in @c source.
+///
+/// @param source The complete text of a BBC BASIC program.
+/// @param dialect The version of BASIC whose keywords to recognise.
+/// @throws An instance of @c Error if any problem is encountered.
+std::vector<uint8_t> import(std::string_view source, Dialect dialect = Dialect::BASIC2);
+
+/// Returns a tokenised version of the textual BASIC program found in @c source, tokenising
+/// separate runs of lines concurrently on @c pool.
+///
+/// Results, including any error, are identical to those of the serial @c import. Each run is
+/// tokenised into a buffer of its own and then copied into the result, also concurrently.
+///
+/// @param source The complete text of a BBC BASIC program.
+/// @param pool The threads to use.
+/// @param dialect The version of BASIC whose keywords to recognise.
+/// @throws An instance of @c Error if any problem is encountered.
+std::vector<uint8_t> import(std::string_view source, ThreadPool &pool, Dialect dialect = Dialect::BASIC2);
+
+/// Tokenises as per the @c Sink form of @c import but, rather than stopping at the first error,
+/// records it and resumes at the start of the following line. Lines with errors are omitted
+/// from the output; all others reach @c sink as usual, followed by the program terminator.
+///
+/// @returns Every error encountered, in input order.
+std::vector<Error> diagnose(std::string_view source, Sink &sink, Dialect dialect = Dialect::BASIC2);
+
+/// The outcome of @c diagnose when collecting output in memory.
+struct Diagnosis {
+	std::vector<uint8_t> program;
+	std::vector<Error> errors;
+};
+
+/// Tokenises as per the @c Sink form of @c diagnose, returning the partial program alongside all errors.
+Diagnosis diagnose(std::string_view source, Dialect dialect = Dialect::BASIC2);
+
+/// Returns the text of the tokenised program from @c begin to @c end, such that importing
+/// that text reproduces the same tokenised program. This holds for any program that was
+/// tokenised from text in which bytes above $7f appear only in strings, REMs, DATA or star commands,
+/// using the same @c dialect.
+///
+/// @throws std::runtime_error if the tokenised program is malformed.
+std::string detokenise(const uint8_t *begin, const uint8_t *end, Dialect dialect = Dialect::BASIC2);
+
+/// Describes the content of a tokenised program.
+struct Statistics {
+	size_t lines = 0;
+
+	/// The number of occurrences of each keyword token, other than those of two bytes.
+	std::array<size_t, 256> tokens{};
+
+	/// The number of occurrences of each two-byte token, indexed by its first byte less $c6 and
+	/// then by its second.
+	std::array<std::array<size_t, 256>, 3> extended_tokens{};
+
+	/// The number of conditional keywords, such as @c PI or @c TIME, that were left as text
+	/// because an alphanumeric followed them.
+	size_t untokenised_conditionals = 0;
+};
+
+/// Walks the tokenised program from @c begin to @c end as @c detokenise does, without producing text.
+///
+/// @throws std::runtime_error if the tokenised program is malformed.
+Statistics analyse(const uint8_t *begin, const uint8_t *end, Dialect dialect = Dialect::BASIC2);
+
+/// @returns The keyword that @c token stands for in @c dialect, or an empty string if it is not
+/// a keyword token or is the first byte of a two-byte token.
+std::string_view keyword(uint8_t token, Dialect dialect = Dialect::BASIC2);
+
+/// @returns The keyword that the two-byte token @c prefix, @c extension stands for in @c dialect,
+/// or an empty string if there is no such token.
+std::string_view keyword(uint8_t prefix, uint8_t extension, Dialect dialect = Dialect::BASIC2);
+
 /// Returns a tokenised version of the textual BASIC program found in the input stream.
 ///
-/// @param source A stream of text describing a BBC BASIC program.
+/// @param source A stream of text describing a BBC BASIC program; it is read in full before tokenisation begins.
 /// @throws An instance of @c Error if any problem is encountered.
 std::vector<uint8_t> import(FILE *source);
 
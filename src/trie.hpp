@@ -1,44 +1,115 @@
 #pragma once
 
-#include <initializer_list>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
-#include <unordered_map>
-#include <utility>
 
-/// Implements a fairly-vanilla retrieval tree.
+/// Describes the storage required by a @c Trie in order to hold a particular set of keys.
+struct TrieShape {
+	/// The number of states, including the dead state.
+	size_t states = 1;
+	/// The number of character classes, including the class of all bytes that appear in no key.
+	size_t classes = 1;
+};
+
+/// @returns The shape of @c Trie needed to hold @c values, a range of pairs of NUL-terminated keys and values.
+template <typename RangeT>
+constexpr TrieShape trie_shape(const RangeT &values) {
+	const auto length = [](const char *key) {
+		size_t result = 0;
+		while(key[result]) ++result;
+		return result;
+	};
+
+	// Count one state per distinct prefix, plus the dead state and the root.
+	TrieShape shape{2, 1};
+	for(auto it = std::begin(values); it != std::end(values); ++it) {
+		const auto key = it->first;
+		const auto key_length = length(key);
+		for(size_t prefix = 1; prefix <= key_length; prefix++) {
+			bool is_new = true;
+			for(auto earlier = std::begin(values); earlier != it && is_new; ++earlier) {
+				const auto other = earlier->first;
+				if(length(other) < prefix) continue;
+
+				size_t c = 0;
+				while(c < prefix && other[c] == key[c]) ++c;
+				is_new = c != prefix;
+			}
+			shape.states += is_new;
+		}
+	}
+
+	// Count one class per distinct byte.
+	for(int byte = 1; byte < 256; byte++) {
+		bool used = false;
+		for(auto it = std::begin(values); it != std::end(values) && !used; ++it) {
+			for(auto key = it->first; *key && !used; ++key) {
+				used = uint8_t(*key) == byte;
+			}
+		}
+		shape.classes += used;
+	}
+
+	return shape;
+}
+
+/// Implements a retrieval tree as a flat deterministic automaton, which can be fully built at compile time.
+///
+/// Each state holds a dense row of transitions, indexed by character class, alongside its value.
+/// State 0 is a dead state from which there are no transitions; lookups start from @c Root.
 ///
-/// @c NodeKeyT the type that is used to index the tree.
-/// @c ValueT the type stored at nodes which complete a value.
-template <typename NodeKeyT, typename ValueT>
+/// @c ValueT the type stored at states which complete a value.
+/// @c shape the storage required, as given by @c trie_shape for the values that will be supplied.
+template <typename ValueT, TrieShape shape>
 struct Trie {
-	Trie() = default;
-	constexpr Trie(std::initializer_list<std::pair<const NodeKeyT *, ValueT>> values) noexcept {
+	using State = uint16_t;
+	static_assert(shape.states <= 65536);
+
+	static constexpr State NoState = 0;
+	static constexpr State Root = 1;
+
+	/// Constructs a trie holding @c values, a range of pairs of NUL-terminated keys and values.
+	/// If a key appears more than once then the final value supplied is retained.
+	template <typename RangeT>
+	constexpr Trie(const RangeT &values) noexcept {
+		uint8_t next_class = 1;
 		for(const auto &value: values) {
-			insert(value.first, value.second);
+			for(auto key = value.first; *key; ++key) {
+				auto &char_class = classes_[uint8_t(*key)];
+				if(!char_class) char_class = next_class++;
+			}
+		}
+
+		size_t next_state = Root + 1;
+		for(const auto &value: values) {
+			State state = Root;
+			for(auto key = value.first; *key; ++key) {
+				auto &target = nodes_[state].next[classes_[uint8_t(*key)]];
+				if(!target) target = State(next_state++);
+				state = target;
+			}
+			nodes_[state].value = value.second;
 		}
 	}
 
-	/// @returns This node's child corresponding to @c key if one exists; @c nullptr otherwise.
-	const Trie *find(const NodeKeyT key) const {
-		const auto it = children_.find(key);
-		if(it == children_.end()) return nullptr;
-		return &it->second;
+	/// @returns The state reached by following @c key from @c state; @c NoState if there is no such transition.
+	constexpr State find(const State state, const char key) const {
+		return nodes_[state].next[classes_[uint8_t(key)]];
 	}
 
-	/// @returns The value stored at this node if one exists; @c std::nullopt otherwise.
-	const std::optional<ValueT> &value() const {
-		return value_;
+	/// @returns The value stored at @c state if one exists; @c std::nullopt otherwise.
+	constexpr const std::optional<ValueT> &value(const State state) const {
+		return nodes_[state].value;
 	}
 
 private:
-	constexpr void insert(const NodeKeyT *key, const ValueT &value) {
-		if(*key) {
-			children_[*key].insert(key + 1, value);
-		} else {
-			value_ = value;
-		}
-	}
+	struct Node {
+		std::array<State, shape.classes> next{};
+		std::optional<ValueT> value;
+	};
 
-	std::unordered_map<NodeKeyT, Trie> children_;
-	std::optional<ValueT> value_;
+	std::array<uint8_t, 256> classes_{};
+	std::array<Node, shape.states> nodes_{};
 };
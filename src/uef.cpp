@@ -0,0 +1,687 @@
+#include "uef.hpp"
+
+#include "input.hpp"
+#include "thread_pool.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <stdexcept>
+
+//
+// MARK: - UEFWriter.
+//
+
+struct UEFWriter::Compressor {
+	Compressor() {
+		// A window size of 15 plus 16 requests a gzip wrapper.
+		if(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			throw std::runtime_error("Unable to initialise compression");
+		}
+	}
+
+	~Compressor() {
+		deflateEnd(&stream);
+	}
+
+	/// @returns The compressed form of @c data, which remains valid until the next call.
+	const std::vector<uint8_t> &compress(const uint8_t *const data, const size_t length, const bool is_final) {
+		output.resize(deflateBound(&stream, uLong(length)));
+		stream.next_in = const_cast<Bytef *>(data);
+		stream.avail_in = uInt(length);
+
+		size_t produced = 0;
+		while(true) {
+			stream.next_out = output.data() + produced;
+			stream.avail_out = uInt(output.size() - produced);
+			const auto result = deflate(&stream, is_final ? Z_FINISH : Z_NO_FLUSH);
+			produced = output.size() - stream.avail_out;
+
+			if(result == Z_STREAM_END || (!is_final && !stream.avail_in && stream.avail_out)) break;
+			if(result != Z_OK && result != Z_BUF_ERROR) {
+				throw std::runtime_error("Compression failed");
+			}
+			if(!stream.avail_out) output.resize(output.size() * 2);
+		}
+
+		output.resize(produced);
+		return output;
+	}
+
+	z_stream stream{};
+	std::vector<uint8_t> output;
+};
+
+UEFWriter::UEFWriter(const std::string &file_name, const bool compress) : file_name_(file_name) {
+	if(compress) {
+		compressor_ = std::make_unique<Compressor>();
+	}
+	buffer_.reserve(65536);
+
+	// Write header.
+	static constexpr char header[] = "UEF File!";
+	append(std::begin(header), std::end(header));
+	append(10);
+	append(0);
+}
+
+UEFWriter::~UEFWriter() {
+	if(closed_) return;
+
+	// Don't leave an incomplete image behind.
+	if(file_ >= 0) {
+		::close(file_);
+		unlink(file_name_.c_str());
+	}
+}
+
+void UEFWriter::begin_chunk(const uint16_t id, const uint32_t length) {
+	const uint8_t header[] = {
+		uint8_t(id >> 0), uint8_t(id >> 8),
+		uint8_t(length >> 0), uint8_t(length >> 8), uint8_t(length >> 16), uint8_t(length >> 24),
+	};
+	append(std::begin(header), std::end(header));
+}
+
+void UEFWriter::commit(const size_t offset) {
+	committed_ = offset;
+
+	const auto length = committed_ - written_;
+	if(length >= FlushThreshold && !file_name_.empty()) {
+		write(buffer_.data(), length, false);
+		buffer_.erase(buffer_.begin(), buffer_.begin() + ptrdiff_t(length));
+		written_ = committed_;
+	}
+}
+
+void UEFWriter::close() {
+	if(file_name_.empty()) {
+		closed_ = true;
+		if(compressor_) {
+			const auto &compressed = compressor_->compress(buffer_.data(), buffer_.size(), true);
+			buffer_.assign(compressed.begin(), compressed.end());
+		}
+		return;
+	}
+
+	write(buffer_.data(), buffer_.size(), true);
+	written_ += buffer_.size();
+	buffer_.clear();
+
+	closed_ = true;
+	if(::close(file_)) {
+		unlink(file_name_.c_str());
+		throw std::runtime_error("Unable to complete output: " + file_name_);
+	}
+}
+
+std::vector<uint8_t> UEFWriter::take() {
+	return std::move(buffer_);
+}
+
+void UEFWriter::write(const uint8_t *data, size_t length, const bool is_final) {
+	const auto start = output_time_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+	if(file_ < 0) {
+		file_ = open(file_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if(file_ < 0) {
+			throw std::runtime_error("Unable to open for output: " + file_name_);
+		}
+	}
+
+	if(compressor_) {
+		const auto &compressed = compressor_->compress(data, length, is_final);
+		data = compressed.data();
+		length = compressed.size();
+	}
+
+	while(length) {
+		const auto written = ::write(file_, data, length);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			throw std::runtime_error("Unable to write output: " + file_name_);
+		}
+		data += written;
+		length -= size_t(written);
+	}
+
+	if(output_time_) {
+		*output_time_ += std::chrono::steady_clock::now() - start;
+	}
+}
+
+//
+// MARK: - UEFBlockStream.
+//
+
+namespace {
+
+// Each block chunk begins with a six-byte chunk header, a synchronisation byte, the block
+// header and the two-byte header CRC; it ends with a two-byte data CRC. The block header is the
+// NUL-terminated file name followed by 17 bytes of addresses, block number, length and flags.
+constexpr size_t ChunkHeaderLength = 6;
+constexpr size_t MaximumNameLength = 10;
+
+size_t block_header_length(const CassetteFile &file) {
+	return file.name.size() + 1 + 17;
+}
+
+size_t block_prefix_length(const CassetteFile &file) {
+	return ChunkHeaderLength + 1 + block_header_length(file) + 2;
+}
+
+void validate(const CassetteFile &file) {
+	if(
+		file.name.empty() || file.name.size() > MaximumNameLength ||
+		std::any_of(file.name.begin(), file.name.end(), [](const char ch) { return ch <= ' ' || ch > '~'; })
+	) {
+		throw std::runtime_error("Invalid cassette file name: " + file.name);
+	}
+}
+
+}
+
+UEFBlockStream::UEFBlockStream(
+	UEFWriter &writer,
+	BlockCache *const cache,
+	const TapeLayout &layout,
+	const CassetteFile &file
+) : writer_(writer), cache_(cache), layout_(layout), file_(file) {
+	validate(file_);
+	if(layout_.base_frequency) {
+		const auto frequency = std::bit_cast<uint32_t>(layout_.base_frequency);
+		const uint8_t contents[] = {
+			uint8_t(frequency >> 0), uint8_t(frequency >> 8), uint8_t(frequency >> 16), uint8_t(frequency >> 24),
+		};
+		writer_.chunk(0x0113, contents);
+	}
+	write_leader();
+}
+
+void UEFBlockStream::begin_file(const CassetteFile &file) {
+	validate(file);
+	finish();
+
+	// Files are separated by the same gap as blocks, and each is led by a full carrier tone.
+	if(layout_.gap > 0.0f) {
+		const auto gap = std::bit_cast<uint32_t>(layout_.gap);
+		const uint8_t contents[] = {uint8_t(gap >> 0), uint8_t(gap >> 8), uint8_t(gap >> 16), uint8_t(gap >> 24)};
+		writer_.chunk(0x0116, contents);
+	}
+	write_leader();
+
+	file_ = file;
+	block_number_ = 0;
+}
+
+void UEFBlockStream::write_leader() {
+	// Write high tone with a dummy byte.
+	const uint8_t high_tone[] = {
+		uint8_t(layout_.leader_cycles >> 0), uint8_t(layout_.leader_cycles >> 8),
+		uint8_t(layout_.leader_cycles >> 0), uint8_t(layout_.leader_cycles >> 8),
+	};
+	writer_.chunk(0x0111, high_tone);
+}
+
+void UEFBlockStream::append(const uint8_t *begin, const uint8_t *const end) {
+	while(begin != end) {
+		// A full block is known not to be the last only once there's data beyond it.
+		if(block_open_ && block_length_ == BlockSize) {
+			close_block(false);
+		}
+		if(!block_open_) {
+			open_block();
+		}
+
+		const auto length = std::min(size_t(end - begin), BlockSize - block_length_);
+		writer_.append(begin, begin + length);
+		block_length_ += length;
+		begin += length;
+	}
+}
+
+void UEFBlockStream::finish() {
+	if(block_open_) {
+		close_block(true);
+	}
+}
+
+void UEFBlockStream::open_block() {
+	// Blocks after the first may be separated by a gap; each is preceded by a short carrier tone.
+	if(block_number_ && layout_.gap > 0.0f) {
+		const auto gap = std::bit_cast<uint32_t>(layout_.gap);
+		const uint8_t contents[] = {uint8_t(gap >> 0), uint8_t(gap >> 8), uint8_t(gap >> 16), uint8_t(gap >> 24)};
+		writer_.chunk(0x0116, contents);
+	}
+	const uint8_t carrier[] = {uint8_t(layout_.carrier_cycles >> 0), uint8_t(layout_.carrier_cycles >> 8)};
+	writer_.chunk(0x0110, carrier);
+
+	// Leave space for the chunk and block headers, to be completed when the block is.
+	block_offset_ = writer_.size();
+	block_length_ = 0;
+	block_open_ = true;
+	for(size_t c = 0; c < block_prefix_length(file_); c++) {
+		writer_.append(0);
+	}
+}
+
+void UEFBlockStream::close_block(const bool is_last) {
+	const auto prefix_length = block_prefix_length(file_);
+	const auto data = writer_.at(block_offset_ + prefix_length);
+	const auto data_crc = cache_ ?
+		cache_->crc(block_number_, data, data + block_length_) :
+		CRC::crc16(data, data + block_length_);
+	writer_.append(data_crc.high());
+	writer_.append(data_crc.low());
+
+	const auto chunk_length = uint32_t(writer_.size() - block_offset_ - ChunkHeaderLength);
+	const uint8_t prefix[] = {
+		0x00, 0x01,														// Chunk ID.
+		uint8_t(chunk_length >> 0), uint8_t(chunk_length >> 8),			// Chunk length.
+		uint8_t(chunk_length >> 16), uint8_t(chunk_length >> 24),
+		0x2a,															// Synchronisation byte.
+	};
+	const uint8_t fields[] = {
+		uint8_t(file_.load_address >> 0), uint8_t(file_.load_address >> 8),					// Load address.
+		uint8_t(file_.load_address >> 16), uint8_t(file_.load_address >> 24),
+		uint8_t(file_.execution_address >> 0), uint8_t(file_.execution_address >> 8),			// Execution address.
+		uint8_t(file_.execution_address >> 16), uint8_t(file_.execution_address >> 24),
+		uint8_t(block_number_ >> 0), uint8_t(block_number_ >> 8),								// Block number.
+		uint8_t(block_length_ >> 0), uint8_t(block_length_ >> 8),								// Block length.
+		uint8_t(is_last ? 0x80 : 0x00),															// Block flag.
+		0x00, 0x00, 0x00, 0x00,																	// Four unused bytes.
+	};
+
+	// The header, from file name to unused bytes, is assembled in place so that its CRC can be taken.
+	const auto destination = writer_.at(block_offset_);
+	const auto header = destination + sizeof(prefix);
+	memcpy(destination, prefix, sizeof(prefix));
+	memcpy(header, file_.name.data(), file_.name.size());
+	header[file_.name.size()] = 0x00;
+	memcpy(header + file_.name.size() + 1, fields, sizeof(fields));
+
+	const auto header_crc = CRC::crc16(header, header + block_header_length(file_));
+	destination[prefix_length - 2] = header_crc.high();
+	destination[prefix_length - 1] = header_crc.low();
+
+	writer_.commit(writer_.size());
+	block_open_ = false;
+	++block_number_;
+}
+
+//
+// MARK: - UEFReader.
+//
+
+namespace {
+
+constexpr char Signature[] = "UEF File!";
+constexpr size_t ImageHeaderLength = sizeof(Signature) + 2;
+
+/// Reads fields sequentially from a byte range, failing if the range is exhausted.
+class Reader {
+public:
+	Reader(const std::span<const uint8_t> source) : cursor_(source.data()), end_(source.data() + source.size()) {}
+
+	std::span<const uint8_t> bytes(const size_t length, const char *const what) {
+		if(remaining() < length) {
+			throw std::runtime_error(std::string("Truncated ") + what);
+		}
+		const auto result = std::span<const uint8_t>(cursor_, length);
+		cursor_ += length;
+		return result;
+	}
+
+	template <typename IntT>
+	IntT integer(const char *const what) {
+		const auto source = bytes(sizeof(IntT), what);
+		IntT result = 0;
+		for(size_t c = 0; c < sizeof(IntT); c++) {
+			result |= IntT(source[c]) << (c * 8);
+		}
+		return result;
+	}
+
+	float real(const char *const what) {
+		return std::bit_cast<float>(integer<uint32_t>(what));
+	}
+
+	/// @returns A big-endian CRC, as recorded on tape.
+	uint16_t crc(const char *const what) {
+		const auto source = bytes(2, what);
+		return uint16_t((source[0] << 8) | source[1]);
+	}
+
+	size_t remaining() const {
+		return size_t(end_ - cursor_);
+	}
+
+	const uint8_t *position() const {
+		return cursor_;
+	}
+
+private:
+	const uint8_t *cursor_;
+	const uint8_t *const end_;
+};
+
+/// @returns A description of the first CRC failure in @c block, if any.
+std::optional<std::string> check(const UEFReader::Block &block) {
+	if(uint16_t(CRC::crc16(block.header.begin(), block.header.end())) != block.header_crc) {
+		return "Bad header CRC in block " + std::to_string(block.number) + " of " + std::string(block.name);
+	}
+	if(!block.data.empty() && uint16_t(CRC::crc16(block.data.begin(), block.data.end())) != block.data_crc) {
+		return "Bad data CRC in block " + std::to_string(block.number) + " of " + std::string(block.name);
+	}
+	return std::nullopt;
+}
+
+}
+
+UEFReader::UEFReader(const std::string &file_name) : file_(std::make_unique<InputBuffer>(file_name)) {
+	const auto view = file_->view();
+	image_ = std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(view.data()), view.size());
+	decompress();
+	parse();
+}
+
+UEFReader::UEFReader(std::vector<uint8_t> image) : buffer_(std::move(image)) {
+	image_ = buffer_;
+	decompress();
+	parse();
+}
+
+UEFReader::~UEFReader() = default;
+
+void UEFReader::decompress() {
+	if(image_.size() < 2 || image_[0] != 0x1f || image_[1] != 0x8b) {
+		return;
+	}
+
+	// A window size of 15 plus 32 accepts either a gzip or a zlib wrapper.
+	z_stream stream{};
+	if(inflateInit2(&stream, 15 + 32) != Z_OK) {
+		throw std::runtime_error("Unable to initialise decompression");
+	}
+	stream.next_in = const_cast<Bytef *>(image_.data());
+	stream.avail_in = uInt(image_.size());
+
+	// UEF images typically compress by a factor of three or so.
+	std::vector<uint8_t> output(image_.size() * 4);
+	size_t produced = 0;
+	while(true) {
+		stream.next_out = output.data() + produced;
+		stream.avail_out = uInt(output.size() - produced);
+		const auto result = inflate(&stream, Z_NO_FLUSH);
+		produced = output.size() - stream.avail_out;
+
+		if(result == Z_STREAM_END) break;
+		if((result != Z_OK && result != Z_BUF_ERROR) || (!stream.avail_in && stream.avail_out)) {
+			inflateEnd(&stream);
+			throw std::runtime_error("Bad compressed image");
+		}
+		if(!stream.avail_out) output.resize(output.size() * 2);
+	}
+	inflateEnd(&stream);
+
+	output.resize(produced);
+	buffer_ = std::move(output);
+	image_ = buffer_;
+	file_.reset();
+}
+
+void UEFReader::parse() {
+	Reader image(image_);
+	const auto header = image.bytes(ImageHeaderLength, "image header");
+	if(memcmp(header.data(), Signature, sizeof(Signature))) {
+		throw std::runtime_error("Not a UEF image");
+	}
+
+	// Carrier is at twice the base frequency. At 1200 baud each bit is a cycle of the base
+	// frequency, at 300 baud four; each byte is ten bits including start and stop bits.
+	double base_frequency = 1200.0;
+	const auto add_cycles = [&](const double cycles) {
+		load_time_.seconds_at_1200_baud += cycles / (2.0 * base_frequency);
+		load_time_.seconds_at_300_baud += cycles / (2.0 * base_frequency);
+	};
+	const auto add_seconds = [&](const double seconds) {
+		load_time_.seconds_at_1200_baud += seconds;
+		load_time_.seconds_at_300_baud += seconds;
+	};
+	const auto add_bytes = [&](const size_t bytes) {
+		load_time_.seconds_at_1200_baud += double(bytes) * 10.0 / base_frequency;
+		load_time_.seconds_at_300_baud += double(bytes) * 40.0 / base_frequency;
+	};
+
+	while(image.remaining()) {
+		const auto id = image.integer<uint16_t>("chunk header");
+		const auto length = image.integer<uint32_t>("chunk header");
+		const auto contents = image.bytes(length, "chunk");
+		chunks_.push_back(Chunk{id, contents});
+		Reader chunk(contents);
+
+		switch(id) {
+			default: break;
+
+			case 0x0110:
+				if(length != 2) throw std::runtime_error("Bad carrier tone chunk");
+				add_cycles(chunk.integer<uint16_t>("carrier tone chunk"));
+			break;
+
+			case 0x0111:
+				if(length != 4) throw std::runtime_error("Bad carrier tone chunk");
+				add_cycles(chunk.integer<uint16_t>("carrier tone chunk"));
+				add_cycles(chunk.integer<uint16_t>("carrier tone chunk"));
+				add_bytes(1);
+			break;
+
+			case 0x0112:
+				// An integer gap is measured in cycles of carrier.
+				if(length != 2) throw std::runtime_error("Bad gap chunk");
+				add_cycles(chunk.integer<uint16_t>("gap chunk"));
+			break;
+
+			case 0x0113:
+				if(length != 4) throw std::runtime_error("Bad base frequency chunk");
+				base_frequency = chunk.real("base frequency chunk");
+				if(!(base_frequency > 0.0)) throw std::runtime_error("Bad base frequency chunk");
+			break;
+
+			case 0x0116:
+				if(length != 4) throw std::runtime_error("Bad gap chunk");
+				add_seconds(chunk.real("gap chunk"));
+			break;
+
+			case 0x0100: {
+				if(chunk.bytes(1, "block")[0] != 0x2a) {
+					throw std::runtime_error("Missing block synchronisation byte");
+				}
+
+				// The file name is between one and ten characters, terminated by a NUL.
+				Block block;
+				const auto header_start = chunk.position();
+				const auto name_length = size_t(
+					std::find(header_start, header_start + std::min(chunk.remaining(), size_t(11)), 0) - header_start
+				);
+				if(!name_length || name_length == 11 || name_length == chunk.remaining()) {
+					throw std::runtime_error("Bad block file name");
+				}
+				block.name = std::string_view(reinterpret_cast<const char *>(header_start), name_length);
+				chunk.bytes(name_length + 1, "block header");
+
+				block.load_address = chunk.integer<uint32_t>("block header");
+				block.execution_address = chunk.integer<uint32_t>("block header");
+				block.number = chunk.integer<uint16_t>("block header");
+				const auto data_length = chunk.integer<uint16_t>("block header");
+				block.flags = chunk.integer<uint8_t>("block header");
+				chunk.bytes(4, "block header");
+				block.header = std::span<const uint8_t>(header_start, chunk.position());
+				block.header_crc = chunk.crc("block header");
+
+				if(data_length) {
+					block.data = chunk.bytes(data_length, "block");
+					block.data_crc = chunk.crc("block");
+				}
+				if(chunk.remaining()) {
+					throw std::runtime_error("Unexpected data after block " + std::to_string(block.number));
+				}
+				blocks_.push_back(block);
+				add_bytes(length);
+			} break;
+		}
+	}
+}
+
+void UEFReader::verify(ThreadPool *const pool) const {
+	// Blocks are small, so are divided between workers only in large numbers.
+	constexpr size_t MinimumRangeSize = 256;
+	const size_t range_count = pool ? std::min(pool->size() * 4, blocks_.size() / MinimumRangeSize) : 0;
+	if(range_count < 2) {
+		for(const auto &block: blocks_) {
+			if(const auto error = check(block)) {
+				throw std::runtime_error(*error);
+			}
+		}
+		return;
+	}
+
+	std::vector<std::future<std::optional<std::string>>> ranges;
+	for(size_t c = 0; c < range_count; c++) {
+		const auto begin = blocks_.begin() + ptrdiff_t(c * blocks_.size() / range_count);
+		const auto end = blocks_.begin() + ptrdiff_t((c + 1) * blocks_.size() / range_count);
+		ranges.push_back(pool->submit([begin, end] () -> std::optional<std::string> {
+			for(auto block = begin; block != end; ++block) {
+				if(auto error = check(*block)) {
+					return error;
+				}
+			}
+			return std::nullopt;
+		}));
+	}
+
+	// Report the first failure in tape order.
+	std::optional<std::string> error;
+	for(auto &range: ranges) {
+		auto result = range.get();
+		if(!error) error = std::move(result);
+	}
+	if(error) {
+		throw std::runtime_error(*error);
+	}
+}
+
+std::vector<UEFReader::File> UEFReader::files() const {
+	std::vector<File> files;
+	bool in_file = false;
+	for(const auto &block: blocks_) {
+		if(!in_file) {
+			if(block.number) {
+				throw std::runtime_error("Missing block 0 of " + std::string(block.name));
+			}
+			auto &file = files.emplace_back();
+			file.name = block.name;
+			file.load_address = block.load_address;
+			file.execution_address = block.execution_address;
+			in_file = true;
+		}
+
+		auto &file = files.back();
+		if(block.name != file.name || block.number != file.data.size() / UEFBlockStream::BlockSize) {
+			throw std::runtime_error("Block " + std::to_string(block.number) + " of " + std::string(block.name) + " is out of sequence");
+		}
+		if(!block.is_last() && block.data.size() != UEFBlockStream::BlockSize) {
+			throw std::runtime_error("Short block " + std::to_string(block.number) + " of " + file.name);
+		}
+
+		file.data.insert(file.data.end(), block.data.begin(), block.data.end());
+		in_file = !block.is_last();
+	}
+
+	if(in_file) {
+		throw std::runtime_error("Missing final block of " + files.back().name);
+	}
+	return files;
+}
+
+//
+// MARK: - Whole-file conversion.
+//
+
+void write_uef(
+	const std::string &file_name,
+	const std::vector<uint8_t> &program,
+	const bool compress,
+	const TapeLayout &layout
+) {
+	UEFWriter writer(file_name, compress);
+	writer.chunk(0x0000, "bas2uef v1.0");
+
+	UEFBlockStream blocks(writer, nullptr, layout);
+	blocks.append(program.data(), program.data() + program.size());
+	blocks.finish();
+	writer.close();
+}
+
+void tokenise_to_uef(
+	const std::string &file_name,
+	const std::string_view source,
+	const bool compress,
+	Tokeniser::LineCache *const line_cache,
+	BlockCache *const block_cache,
+	const TapeLayout &layout,
+	const Tokeniser::Dialect dialect
+) {
+	UEFWriter writer(file_name, compress);
+	writer.chunk(0x0000, "bas2uef v1.0");
+
+	UEFBlockStream blocks(writer, block_cache, layout);
+	Tokeniser::import(source, blocks, line_cache, dialect);
+	blocks.finish();
+	writer.close();
+}
+
+std::vector<Tokeniser::Error> diagnose_to_uef(
+	const std::string &file_name,
+	const std::string_view source,
+	const bool compress,
+	const TapeLayout &layout,
+	const Tokeniser::Dialect dialect
+) {
+	UEFWriter writer(file_name, compress);
+	writer.chunk(0x0000, "bas2uef v1.0");
+
+	UEFBlockStream blocks(writer, nullptr, layout);
+	auto errors = Tokeniser::diagnose(source, blocks, dialect);
+	blocks.finish();
+	writer.close();
+	return errors;
+}
+
+std::vector<uint8_t> tokenise_to_uef(const std::string_view source, const bool compress) {
+	UEFWriter writer("", compress);
+	writer.chunk(0x0000, "bas2uef v1.0");
+
+	UEFBlockStream blocks(writer);
+	Tokeniser::import(source, blocks);
+	blocks.finish();
+	writer.close();
+	return writer.take();
+}
+
+std::vector<uint8_t> write_uef(const std::vector<uint8_t> &program, const TapeLayout &layout) {
+	UEFWriter writer("", false);
+	writer.chunk(0x0000, "bas2uef v1.0");
+
+	UEFBlockStream blocks(writer, nullptr, layout);
+	blocks.append(program.data(), program.data() + program.size());
+	blocks.finish();
+	writer.close();
+	return writer.take();
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include "CRC.hpp"
+#include "tokeniser.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class InputBuffer;
+
+/// Assembles a UEF image in a single contiguous buffer, with each chunk's length written up front,
+/// and writes it out in one system call upon @c close.
+///
+/// To bound memory use, committed data is also written out early once more than @c FlushThreshold
+/// bytes of it have accumulated. Nothing is created on disk before then; if the writer is destroyed
+/// without being closed then any partial file is removed.
+///
+/// Alternatively the image can be kept in memory in its entirety, to be collected via @c take.
+class UEFWriter {
+public:
+	static constexpr size_t FlushThreshold = 1024 * 1024;
+
+	/// @param file_name The file to write to or, if empty, none; the image will be kept in memory.
+	/// @param compress If @c true then the file is written gzip-compressed, which emulators accept.
+	UEFWriter(const std::string &file_name, bool compress = false);
+	~UEFWriter();
+
+	/// Writes out all remaining data and closes the file.
+	///
+	/// @throws std::runtime_error if the file can't be opened or written.
+	void close();
+
+	/// @returns The complete image, in its final form, of a writer that was closed without a file name.
+	std::vector<uint8_t> take();
+
+	/// Appends the header of a chunk with ID @c id and @c length bytes of contents, which
+	/// the caller must then supply.
+	void begin_chunk(uint16_t id, uint32_t length);
+
+	/// Appends a complete chunk.
+	template <typename CollectionT>
+	void chunk(const uint16_t id, const CollectionT &contents) {
+		begin_chunk(id, uint32_t(std::size(contents)));
+		append(std::begin(contents), std::end(contents));
+	}
+
+	template <typename IteratorT>
+	void append(const IteratorT begin, const IteratorT end) {
+		buffer_.insert(buffer_.end(), begin, end);
+	}
+	void append(const uint8_t value) {
+		buffer_.push_back(value);
+	}
+
+	/// @returns The offset of the end of the image so far.
+	size_t size() const {
+		return written_ + buffer_.size();
+	}
+
+	/// @returns A pointer to the byte at @c offset, which must not yet have been committed; it remains
+	/// valid only until the next append.
+	uint8_t *at(const size_t offset) {
+		return &buffer_[offset - written_];
+	}
+
+	/// Indicates that everything before @c offset is final, and may be written out.
+	void commit(size_t offset);
+
+	/// Adds to @c total all time subsequently spent compressing and writing to the file.
+	void time_output(std::chrono::steady_clock::duration &total) {
+		output_time_ = &total;
+	}
+
+private:
+	void write(const uint8_t *data, size_t length, bool is_final);
+
+	std::string file_name_;
+	int file_ = -1;
+	bool closed_ = false;
+
+	std::vector<uint8_t> buffer_;
+	size_t written_ = 0;
+	size_t committed_ = 0;
+
+	struct Compressor;
+	std::unique_ptr<Compressor> compressor_;
+
+	std::chrono::steady_clock::duration *output_time_ = nullptr;
+};
+
+/// Supplies the CRC of each block in place of the usual calculation, such as to time it.
+struct BlockCache {
+	virtual ~BlockCache() = default;
+
+	/// @returns The CRC of the bytes from @c begin to @c end, which form block @c block_number.
+	virtual CRC::ByteSwapped16 crc(uint16_t block_number, const uint8_t *begin, const uint8_t *end) = 0;
+};
+
+/// Describes the carrier tones and gaps that surround blocks on tape. Durations are in cycles of
+/// carrier, which is at twice the base frequency of 1200Hz unless @c base_frequency says otherwise.
+struct TapeLayout {
+	/// The carrier either side of the dummy byte that leads the tape, written as chunk $0111.
+	uint16_t leader_cycles = 1500;
+
+	/// The carrier before each block, written as chunk $0110.
+	uint16_t carrier_cycles = 600;
+
+	/// Seconds of silence between blocks, written as chunk $0116; none if zero.
+	float gap = 0.0f;
+
+	/// If nonzero, a base frequency in Hz other than 1200, written as chunk $0113 at the start of
+	/// the tape. Emulators that honour it will load correspondingly faster; real machines can't.
+	float base_frequency = 0.0f;
+
+	/// @returns A layout with the least carrier that the MOS cassette filing system will reliably
+	/// lock onto: a quarter of a second of leader and a twentieth between blocks. The MOS does
+	/// nothing between blocks that needs longer, as each is copied into place as it arrives.
+	static constexpr TapeLayout fast() {
+		TapeLayout layout;
+		layout.leader_cycles = 600;
+		layout.carrier_cycles = 120;
+		return layout;
+	}
+};
+
+/// Describes a file on cassette: its name and the addresses used by *LOAD and *RUN.
+struct CassetteFile {
+	/// Between one and ten printable characters.
+	std::string name = "BASIC";
+
+	/// The defaults are those given by SAVE in BASIC: load at PAGE's usual value of &1900,
+	/// and execute BASIC's entry point at &8023.
+	uint32_t load_address = 0x1900;
+	uint32_t execution_address = 0x8023;
+};
+
+/// Divides a tokenised program into cassette filing system blocks as it arrives, placing
+/// each directly into a @c UEFWriter's image.
+///
+/// Each block's header is filled in once the block is complete, and a full block is held
+/// open until it is known whether more data follows, so that the final block can be flagged
+/// as such. Blocks are committed to the writer as soon as they're complete.
+class UEFBlockStream: public Tokeniser::Sink {
+public:
+	static constexpr size_t BlockSize = 256;
+
+	/// Writes the leading carrier tone to @c writer; blocks will follow.
+	///
+	/// @param cache If supplied, the source of all block data CRCs.
+	/// @param layout The tones and gaps to place around blocks.
+	/// @param file The name and addresses to give the file.
+	/// @throws std::runtime_error if @c file has an invalid name.
+	UEFBlockStream(
+		UEFWriter &writer,
+		BlockCache *cache = nullptr,
+		const TapeLayout &layout = TapeLayout(),
+		const CassetteFile &file = CassetteFile());
+
+	void append(const uint8_t *begin, const uint8_t *end) override;
+
+	/// Completes the final block of the current file, if it has any.
+	void finish();
+
+	/// Completes the current file and writes the carrier tone that leads another; data
+	/// appended subsequently belongs to @c file. Any block cache is consulted by block
+	/// number within the new file.
+	///
+	/// @throws std::runtime_error if @c file has an invalid name.
+	void begin_file(const CassetteFile &file);
+
+private:
+	void write_leader();
+	void open_block();
+	void close_block(bool is_last);
+
+	UEFWriter &writer_;
+	BlockCache *const cache_;
+	const TapeLayout layout_;
+	CassetteFile file_;
+	uint16_t block_number_ = 0;
+
+	bool block_open_ = false;
+	size_t block_offset_ = 0;
+	size_t block_length_ = 0;
+};
+
+/// Writes @c program, a tokenised BASIC program, to @c file_name as a UEF image of a cassette
+/// holding a single file named BASIC.
+///
+/// @throws std::runtime_error if the file can't be opened or written.
+void write_uef(
+	const std::string &file_name,
+	const std::vector<uint8_t> &program,
+	bool compress = false,
+	const TapeLayout &layout = TapeLayout());
+
+/// Tokenises the BASIC program in @c source and writes it to @c file_name as per @c write_uef,
+/// building blocks as tokenisation proceeds.
+///
+/// @param line_cache If supplied, allows lines to be reused from an earlier tokenisation.
+/// @param block_cache If supplied, provides the CRC of each block.
+/// @param dialect The version of BASIC whose keywords to recognise.
+/// @throws Tokeniser::Error if @c source can't be tokenised, in which case no file is left behind;
+/// std::runtime_error if the file can't be opened or written.
+void tokenise_to_uef(
+	const std::string &file_name,
+	std::string_view source,
+	bool compress = false,
+	Tokeniser::LineCache *line_cache = nullptr,
+	BlockCache *block_cache = nullptr,
+	const TapeLayout &layout = TapeLayout(),
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2);
+
+/// Tokenises the BASIC program in @c source and writes it to @c file_name as per @c tokenise_to_uef,
+/// except that lines with errors are omitted as per @c Tokeniser::diagnose rather than ending conversion.
+///
+/// @returns Every error encountered, in input order.
+/// @throws std::runtime_error if the file can't be opened or written.
+std::vector<Tokeniser::Error> diagnose_to_uef(
+	const std::string &file_name,
+	std::string_view source,
+	bool compress = false,
+	const TapeLayout &layout = TapeLayout(),
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2);
+
+/// Tokenises the BASIC program in @c source and returns the UEF image that @c tokenise_to_uef would write.
+///
+/// @throws Tokeniser::Error if @c source can't be tokenised.
+std::vector<uint8_t> tokenise_to_uef(std::string_view source, bool compress = false);
+
+/// @returns The UEF image that @c write_uef would write for @c program, uncompressed.
+std::vector<uint8_t> write_uef(const std::vector<uint8_t> &program, const TapeLayout &layout = TapeLayout());
+
+/// Parses a UEF image of a cassette into the cassette filing system blocks that it holds, as found
+/// in chunks $0100, each preceded by optional carrier tone in chunks $0110 and $0111. Other chunks
+/// are skipped. gzip-compressed images are decompressed first; others are used in place.
+///
+/// Each $0100 chunk is expected to hold exactly one block, as written by @c UEFBlockStream.
+class UEFReader {
+public:
+	struct Block {
+		std::string_view name;
+		uint32_t load_address = 0;
+		uint32_t execution_address = 0;
+		uint16_t number = 0;
+		uint8_t flags = 0;
+
+		/// The block header, from file name to the unused bytes, and the CRC recorded for it.
+		std::span<const uint8_t> header;
+		uint16_t header_crc = 0;
+
+		/// The block's contents and the CRC recorded for them, which is absent if there are none.
+		std::span<const uint8_t> data;
+		uint16_t data_crc = 0;
+
+		bool is_last() const {
+			return flags & 0x80;
+		}
+	};
+
+	/// Any chunk of the image, in its original form.
+	struct Chunk {
+		uint16_t id = 0;
+		std::span<const uint8_t> contents;
+	};
+
+	/// The time a tape takes to play, from its first chunk to its last.
+	struct LoadTime {
+		double seconds_at_1200_baud = 0.0;
+		double seconds_at_300_baud = 0.0;
+	};
+
+	struct File {
+		std::string name;
+		uint32_t load_address = 0;
+		uint32_t execution_address = 0;
+		std::vector<uint8_t> data;
+	};
+
+	/// Opens and parses the image at @c file_name.
+	///
+	/// @throws std::runtime_error if the file can't be read or isn't a well-formed image.
+	explicit UEFReader(const std::string &file_name);
+
+	/// Parses @c image, which may be gzip-compressed.
+	///
+	/// @throws std::runtime_error if @c image isn't well formed.
+	explicit UEFReader(std::vector<uint8_t> image);
+
+	~UEFReader();
+
+	const std::vector<Block> &blocks() const {
+		return blocks_;
+	}
+
+	/// @returns Every chunk in the image, in order, including those that aren't otherwise interpreted.
+	const std::vector<Chunk> &chunks() const {
+		return chunks_;
+	}
+
+	/// @returns The time the tape takes to play, counting carrier, gaps and data, at each of the
+	/// cassette filing system's data rates. Base frequency changes in chunk $0113 are honoured;
+	/// data rate changes in chunk $0117 are not, the tape being timed at each rate throughout.
+	LoadTime load_time() const {
+		return load_time_;
+	}
+
+	/// Checks the header and data CRCs of every block, dividing blocks between the workers of
+	/// @c pool if one is supplied.
+	///
+	/// @throws std::runtime_error identifying the first block with a bad CRC.
+	void verify(ThreadPool *pool = nullptr) const;
+
+	/// @returns Every file on the tape, in order, each assembled from its blocks.
+	/// @throws std::runtime_error if any file's blocks are out of sequence or incomplete.
+	std::vector<File> files() const;
+
+private:
+	void decompress();
+	void parse();
+
+	std::unique_ptr<InputBuffer> file_;
+	std::vector<uint8_t> buffer_;
+	std::span<const uint8_t> image_;
+	std::vector<Block> blocks_;
+	std::vector<Chunk> chunks_;
+	LoadTime load_time_;
+};
@@ -0,0 +1,285 @@
+#include "watch.hpp"
+
+#include "batch.hpp"
+#include "input.hpp"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+/*
+	Directories rather than files are watched, as many editors save by writing a new file and
+	renaming it over the old, which would silently end a watch on the file itself.
+
+	Any write to a source postpones its conversion; a completed save, i.e. a close after writing
+	or a rename into place, makes it due once the debounce period has passed without further
+	writes. Latency is measured from the last of those events.
+*/
+
+namespace Watch {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile sig_atomic_t stop_requested = 0;
+void request_stop(int) {
+	stop_requested = 1;
+}
+
+/// @returns The form of @c path used to match events to sources.
+std::string key(const std::filesystem::path &path) {
+	return path.lexically_normal().string();
+}
+
+/// @returns The directory holding the file with key @c file, in the form used for watches.
+std::string directory_of(const std::string &file) {
+	const auto directory = std::filesystem::path(file).parent_path().string();
+	return directory.empty() ? "." : directory;
+}
+
+struct Source {
+	std::string input;
+	std::string output;
+
+	/// Whether a completed save awaits conversion.
+	bool pending = false;
+	Clock::time_point last_event;
+};
+
+/// Converts @c source to its output via a temporary file, renamed into place only once complete.
+///
+/// @throws Tokeniser::Error or std::runtime_error if conversion fails, in which case the output is untouched.
+void convert(const Source &source, const Options &options) {
+	const auto temporary = source.output + ".tmp";
+	{
+		// Read rather than map the source, as an editor that rewrites it in place mid-conversion
+		// would truncate a mapping beneath the tokeniser, raising SIGBUS and ending the watch.
+		const std::unique_ptr<FILE, decltype(&fclose)> file(fopen(source.input.c_str(), "rb"), &fclose);
+		if(!file) {
+			throw std::runtime_error("Couldn't open " + source.input);
+		}
+		const InputBuffer input(file.get());
+		tokenise_to_uef(temporary, input.view(), options.compress, nullptr, nullptr, options.layout, options.dialect);
+	}
+	if(rename(temporary.c_str(), source.output.c_str())) {
+		remove(temporary.c_str());
+		throw std::runtime_error("Unable to replace " + source.output);
+	}
+}
+
+/// Converts @c source and logs the outcome; if @c saved is supplied then latency is reported from then.
+void convert_and_log(const Source &source, const Options &options, const Clock::time_point *const saved = nullptr) {
+	const auto start = Clock::now();
+	try {
+		convert(source, options);
+	} catch(const Tokeniser::Error &error) {
+		std::cout << "ERROR: " << source.input << ": " << error.to_string() << std::endl;
+		return;
+	} catch(const std::exception &error) {
+		std::cout << "ERROR: " << source.input << ": " << error.what() << std::endl;
+		return;
+	}
+
+	const auto end = Clock::now();
+	const auto milliseconds = [](const Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	};
+	std::cout << "Converted " << source.input << " to " << source.output << " in " << milliseconds(end - start) << "ms";
+	if(saved) {
+		std::cout << "; " << milliseconds(end - *saved) << "ms after saving";
+	}
+	std::cout << std::endl;
+}
+
+class Watcher {
+public:
+	Watcher(const std::vector<std::string> &inputs, const Options &options) : inputs_(inputs), options_(options) {
+		fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(fd_ < 0) {
+			throw std::runtime_error("Unable to initialise inotify");
+		}
+
+		for(const auto &input: inputs_) {
+			if(!input.empty() && input[0] != '@' && std::filesystem::is_directory(input)) {
+				input_directories_.insert(directory_of(key(std::filesystem::path(input) / "_")));
+			}
+		}
+		collect();
+	}
+
+	~Watcher() {
+		::close(fd_);
+	}
+
+	/// Converts all sources, then reconverts them as they're saved until a stop is requested.
+	void run(const sigset_t &unblocked) {
+		for(const auto &[name, source]: sources_) {
+			convert_and_log(source, options_);
+		}
+		std::cout << "Watching " << sources_.size() << " sources" << std::endl;
+
+		while(!stop_requested) {
+			// Sleep until an event arrives or, if a conversion is due, until it is.
+			timespec timeout;
+			timespec *timeout_pointer = nullptr;
+			if(const auto due = next_due()) {
+				const auto wait = std::max(Clock::duration::zero(), *due - Clock::now());
+				const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+				timeout = timespec{time_t(nanoseconds / 1'000'000'000), long(nanoseconds % 1'000'000'000)};
+				timeout_pointer = &timeout;
+			}
+
+			pollfd descriptor{fd_, POLLIN, 0};
+			if(ppoll(&descriptor, 1, timeout_pointer, &unblocked) < 0) {
+				continue;
+			}
+			if(descriptor.revents) {
+				read_events();
+			}
+
+			const auto now = Clock::now();
+			for(auto &[name, source]: sources_) {
+				if(source.pending && now - source.last_event >= options_.debounce) {
+					source.pending = false;
+					convert_and_log(source, options_, &source.last_event);
+				}
+			}
+		}
+	}
+
+private:
+	/// Expands the inputs, adding any sources not already known and watching their directories.
+	///
+	/// @returns The keys of the sources added.
+	std::vector<std::string> collect() {
+		std::vector<std::string> added;
+		for(const auto &job: Batch::collect(inputs_, options_.output_directory)) {
+			const auto name = key(job.input);
+			if(sources_.contains(name)) continue;
+			sources_.emplace(name, Source{job.input, job.output});
+			added.push_back(name);
+
+			add_watch(directory_of(name));
+		}
+
+		// Input directories are watched even while they hold no sources, for new ones.
+		for(const auto &directory: input_directories_) {
+			add_watch(directory);
+		}
+		return added;
+	}
+
+	void add_watch(const std::string &directory) {
+		if(watched_.contains(directory)) return;
+
+		const int wd = inotify_add_watch(fd_, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO);
+		if(wd < 0) {
+			throw std::runtime_error("Unable to watch " + directory);
+		}
+		directories_[wd] = directory;
+		watched_.insert(directory);
+	}
+
+	void read_events() {
+		alignas(inotify_event) char buffer[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+		const auto now = Clock::now();
+		bool recollect = false;
+
+		while(true) {
+			const auto length = ::read(fd_, buffer, sizeof(buffer));
+			if(length <= 0) {
+				if(length < 0 && errno == EINTR) continue;
+				break;
+			}
+
+			for(ssize_t offset = 0; offset < length;) {
+				const auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+				offset += ssize_t(sizeof(inotify_event) + event->len);
+
+				const auto directory = directories_.find(event->wd);
+				if(!event->len || directory == directories_.end()) continue;
+
+				const auto path = std::filesystem::path(directory->second) / event->name;
+				const auto source = sources_.find(key(path));
+				const bool saved = event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO);
+				if(source == sources_.end()) {
+					recollect |= saved && path.extension() == ".bas" && input_directories_.contains(directory->second);
+					continue;
+				}
+
+				source->second.last_event = now;
+				source->second.pending |= saved;
+			}
+		}
+
+		if(recollect) {
+			for(const auto &name: collect()) {
+				auto &source = sources_.at(name);
+				source.pending = true;
+				source.last_event = now;
+			}
+		}
+	}
+
+	/// @returns When the earliest pending conversion is due, if any is.
+	std::optional<Clock::time_point> next_due() const {
+		std::optional<Clock::time_point> due;
+		for(const auto &[name, source]: sources_) {
+			if(source.pending && (!due || source.last_event + options_.debounce < *due)) {
+				due = source.last_event + options_.debounce;
+			}
+		}
+		return due;
+	}
+
+	const std::vector<std::string> &inputs_;
+	const Options &options_;
+	int fd_ = -1;
+
+	std::map<std::string, Source> sources_;
+	std::unordered_set<std::string> input_directories_;
+	std::unordered_set<std::string> watched_;
+	std::unordered_map<int, std::string> directories_;
+};
+
+}
+
+void watch(const std::vector<std::string> &inputs, const Options &options) {
+	Watcher watcher(inputs, options);
+
+	// Block the stop signals other than within the poll, so that it is reliably what's interrupted.
+	struct sigaction action{};
+	action.sa_handler = request_stop;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	sigset_t stop_signals, previous, unblocked;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_signals, &previous);
+	unblocked = previous;
+	sigdelset(&unblocked, SIGINT);
+	sigdelset(&unblocked, SIGTERM);
+
+	watcher.run(unblocked);
+	pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+}
+
+}
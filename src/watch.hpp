@@ -0,0 +1,40 @@
+#pragma once
+
+#include "uef.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/// Keeps UEF images up to date with their sources as those are edited, for a development loop
+/// of save, then reload in an emulator.
+namespace Watch {
+
+struct Options {
+	/// As per @c Batch::collect.
+	std::string output_directory;
+
+	bool compress = false;
+	TapeLayout layout;
+	Tokeniser::Dialect dialect = Tokeniser::Dialect::BASIC2;
+
+	/// How long a saved file must go without further changes before it is reconverted, so that a
+	/// burst of writes produces a single conversion.
+	std::chrono::microseconds debounce{200};
+};
+
+/// Converts every input, expanded as per @c Batch::collect, and then watches them via inotify,
+/// reconverting each source as it is saved. A .bas file newly saved into a directory that is
+/// an input is picked up as well.
+///
+/// Each output is replaced atomically, by writing a temporary file alongside it and renaming that
+/// into place, so that a reader never sees a partial image. A source that fails to convert leaves
+/// its existing output untouched. Every conversion is logged with its latency from the save that
+/// prompted it to the output being in place.
+///
+/// Runs until SIGINT or SIGTERM.
+///
+/// @throws std::runtime_error if inotify is unavailable or an input can't be watched.
+void watch(const std::vector<std::string> &inputs, const Options &options = Options());
+
+}